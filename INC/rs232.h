@@ -37,6 +37,12 @@ extern "C" {
 #include <stdio.h>
 #include <string.h>
 
+/* max. number of buffers in one RS232_SendBufv() call */
+#define RS232_MAX_IOV  16
+
+/* max. length of a device name, see RS232_SetComportName() */
+#define RS232_NAME_SIZE  64
+
 
 
 #if defined(__linux__) || defined(__FreeBSD__)
@@ -50,6 +56,9 @@ extern "C" {
 #include <limits.h>
 #include <sys/file.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <stdlib.h>
 
 #else
 
@@ -57,10 +66,84 @@ extern "C" {
 
 #endif
 
+
+/*
+one opened port, it owns its descriptor and settings, so independent
+ports can be used from several threads, the port must not be shared
+by two threads without a lock
+*/
+typedef struct rs232_port_s
+{
+  char name[RS232_NAME_SIZE];       /* device path, e.g. "/dev/ttyUSB0" or "\\.\COM3" */
+#if defined(__linux__) || defined(__FreeBSD__)
+  int fd;                           /* -1 if the port is closed */
+  int pty_slave;                    /* slave kept open by RS232_PortOpenPty(), -1 otherwise */
+  struct termios old_settings;      /* restored by RS232_PortClose() */
+#else
+  HANDLE handle;                    /* INVALID_HANDLE_VALUE if the port is closed */
+#endif
+} rs232_port_t;
+
+/* error counters of the UART driver, see RS232_PortGetCounters() */
+typedef struct rs232_counters_s
+{
+  unsigned int rx;                  /* received characters */
+  unsigned int tx;                  /* transmitted characters */
+  unsigned int frame;               /* framing errors, e.g. a wrong baudrate */
+  unsigned int overrun;             /* FIFO of the UART overrun, the driver was late */
+  unsigned int parity;              /* parity errors */
+  unsigned int brk;                 /* break conditions */
+  unsigned int buf_overrun;         /* input buffer of the driver overflowed */
+} rs232_counters_t;
+
+int RS232_PortOpen(rs232_port_t *, const char *, int, const char *, int);
+int RS232_PortOpenPty(rs232_port_t *, int, const char *, int, char *, int);
+int RS232_PortSetReadBatching(rs232_port_t *, int, int);
+int RS232_PortSetBaudrate(rs232_port_t *, int);
+int RS232_PortGetBaudrate(rs232_port_t *);
+int RS232_PortGetCounters(rs232_port_t *, rs232_counters_t *);
+int RS232_PortPoll(rs232_port_t *, unsigned char *, int);
+int RS232_PortWait(rs232_port_t *, int);
+int RS232_PortWaitWritable(rs232_port_t *, int);
+int RS232_PortGetOutQueue(rs232_port_t *);
+int RS232_PortGetInQueue(rs232_port_t *);
+int RS232_PortDrain(rs232_port_t *);
+int RS232_PortSendByte(rs232_port_t *, unsigned char);
+int RS232_PortSendBuf(rs232_port_t *, unsigned char *, int);
+int RS232_PortSendBufv(rs232_port_t *, unsigned char **, const int *, int);
+void RS232_PortClose(rs232_port_t *);
+int RS232_PortIsDCDEnabled(rs232_port_t *);
+int RS232_PortIsRINGEnabled(rs232_port_t *);
+int RS232_PortIsCTSEnabled(rs232_port_t *);
+int RS232_PortIsDSREnabled(rs232_port_t *);
+void RS232_PortEnableDTR(rs232_port_t *);
+void RS232_PortDisableDTR(rs232_port_t *);
+void RS232_PortEnableRTS(rs232_port_t *);
+void RS232_PortDisableRTS(rs232_port_t *);
+void RS232_PortFlushRX(rs232_port_t *);
+void RS232_PortFlushTX(rs232_port_t *);
+void RS232_PortFlushRXTX(rs232_port_t *);
+
+/* the functions below address the ports by a number, see RS232_GetPort() */
+rs232_port_t *RS232_GetPort(int);
 int RS232_OpenComport(int, int, const char *, int);
+int RS232_OpenComportBatched(int, int, const char *, int, int, int);
+int RS232_OpenPty(int, int, const char *, int, char *, int);
+int RS232_OpenPtyPair(int, int, int, const char *, int);
+int RS232_SetComportName(int, const char *);
+int RS232_SetReadBatching(int, int, int);
+int RS232_SetBaudrate(int, int);
+int RS232_GetBaudrate(int);
+int RS232_GetCounters(int, rs232_counters_t *);
 int RS232_PollComport(int, unsigned char *, int);
+int RS232_WaitComport(int, int);
+int RS232_WaitComportWritable(int, int);
+int RS232_GetOutQueue(int);
+int RS232_GetInQueue(int);
+int RS232_DrainComport(int);
 int RS232_SendByte(int, unsigned char);
 int RS232_SendBuf(int, unsigned char *, int);
+int RS232_SendBufv(int, unsigned char **, const int *, int);
 void RS232_CloseComport(int);
 void RS232_cputs(int, const char *);
 int RS232_IsDCDEnabled(int);
@@ -172,6 +172,36 @@ struct salt_io_channel_s {
     salt_io_state_t state;                              /**< I/O channel state. */
 };
 
+/**
+ * @brief Health of the link under a salt channel.
+ *
+ * Filled by the I/O implementation (e.g. from the error counters of the UART),
+ * salt itself does not use it. A frame which fails the authentication gives
+ * only SALT_ERR_DECRYPTION, the counters tell if the line lost or damaged
+ * bytes. The counters run since the link was opened.
+ */
+typedef struct salt_io_stats_s {
+    uint32_t    rx_chars;                               /**< Characters received by the driver. */
+    uint32_t    tx_chars;                               /**< Characters sent by the driver. */
+    uint32_t    overruns;                               /**< Overruns of the receive FIFO of the UART. */
+    uint32_t    buf_overruns;                           /**< Overflows of the input buffer of the driver. */
+    uint32_t    frame_errors;                           /**< Framing errors, e.g. a different baudrate. */
+    uint32_t    parity_errors;                          /**< Parity errors. */
+    uint32_t    breaks;                                 /**< Break conditions. */
+    uint32_t    dropped_frames;                         /**< Damaged frames dropped by the framing of the link. */
+    uint32_t    damaged_chunks;                         /**< Chunks of the ARQ dropped for a wrong CRC. */
+    uint32_t    retransmits;                            /**< Chunks sent again by the ARQ. */
+    uint32_t    fec_corrected;                          /**< Damaged bytes corrected by the FEC. */
+    uint32_t    fec_uncorrectable;                      /**< Codewords of the FEC with too many damaged bytes. */
+    uint32_t    bond_ports;                             /**< Bonded ports which did not fail, 0 without a bond. */
+    uint32_t    bond_lost;                              /**< Stripes lost with a failed port of the bond. */
+    uint32_t    uring_calls;                            /**< io_uring_enter() calls, 0 without io_uring. */
+    uint32_t    uring_completions;                      /**< Completions of the io_uring. */
+    int32_t     rx_queue;                               /**< Bytes in the input queue of the link, -1 if unknown. */
+    int32_t     tx_queue;                               /**< Bytes in the output queue of the link, -1 if unknown. */
+    uint8_t     counters_valid;                         /**< 0 if the link has no counters (pty, socket). */
+} salt_io_stats_t;
+
 
 /**
  * @brief Function for dependency injection to make salt channel protected against
@@ -241,6 +271,8 @@ typedef struct salt_channel_s {
 
     uint8_t     *hdshk_buffer;                          /**< Handshake buffer, used only during handshake. */
     uint32_t    hdshk_buffer_size;                      /**< Handshake buffer size >= SALT_HNDSHK_BUFFER_SIZE. */
+
+    salt_io_stats_t     io_stats;                       /**< Health of the link, filled by the I/O implementation. */
 } salt_channel_t;
 
 /**
@@ -304,6 +336,25 @@ salt_ret_t salt_set_context(salt_channel_t *p_channel,
                             void *p_write_context,
                             void *p_read_context);
 
+/* I/O readiness a pending channel waits for, see salt_get_io_interest(). */
+#define SALT_IO_WANT_READ       0x01U
+#define SALT_IO_WANT_WRITE      0x02U
+
+/**
+ * @brief Reports which I/O readiness the channel waits for.
+ *
+ * When a function of the channel returned SALT_PENDING, the read or write
+ * channel is in the middle of a transfer. An event loop waits until the
+ * context of that channel (see \ref salt_set_context) is readable or
+ * writable and calls the same function again.
+ *
+ * @param p_channel     Pointer to channel handle.
+ *
+ * @return Combination of SALT_IO_WANT_READ and SALT_IO_WANT_WRITE,
+ *         0 if no transfer is pending or p_channel was a NULL pointer.
+ */
+uint8_t salt_get_io_interest(salt_channel_t *p_channel);
+
 /**
  * @brief Initiates to add information about supported protocols to host.
  *
@@ -32,6 +32,9 @@
 */
 #include "salt.h"
 
+/* clock_t for measurement of the transfer */
+#include <time.h>
+
 /**
  * Function for dependency injection to make the salt-channel
  * available for reliable I/O channel. 
@@ -63,6 +66,9 @@
  */
 #include "salti_util.h"
 
+/* LZ compression of the sent blocks */
+#include "salt_lz.h"
+
 /** 
 * Delay attack protection, 
 * threshold for differense in milliseconds. 
@@ -92,6 +98,222 @@
  */
 #define PROTOCOL_BUFFER       128	
 
+/* 
+ * Baud rates offered after the handshake, the highest first, the peers 
+ * switch to the highest one of both lists which passes the probe. A rate
+ * without a Bxxxx constant (1843200) is set by termios2 on Linux.
+ */
+#define SALT_BAUDRATES          4000000, 3000000, 2500000, 2000000, 1843200, \
+                                1500000, 1000000, 921600, 460800, 230400, 115200
+
+/* Size of the probe sent with the new baudrate */
+#define SALT_BAUD_PROBE_SIZE    256
+
+/* Deadline of the probe in milliseconds, the echo is waited twice as long */
+#define SALT_BAUD_PROBE_TIMEOUT 300
+
+/* Time for the peer to switch its port in milliseconds */
+#define SALT_BAUD_SETTLE        50
+
+/* Buffers of the receive pool, see salt_buffer_pool_init(), at most 32 */
+#define SALT_RX_POOL_COUNT      32
+
+/* Payload ranges of one block written by one pwritev() */
+#define SALT_WRITE_IOV          64
+
+/* Payload ranges of the queued blocks joined into one pwritev() by the writer */
+#define SALT_WRITER_IOV         1024
+
+/* Blocks sent without a confirmation, the receiver may advertise less */
+#define SALT_WINDOW_BLOCKS      8
+
+/* The receiver confirms every n-th block and the last one */
+#define SALT_ACK_EVERY          4
+
+/* Bytes of the SHA-512 kept as the digest of a block and as the id of a file */
+#define SALT_DIGEST_SIZE        16
+
+/* Most received blocks committed to the journal by one fdatasync() */
+#define SALT_JOURNAL_BATCH      1024
+
+/* Default budget of the received data between two fdatasync(), see salt_journal_set_budget() */
+#define SALT_SYNC_BYTES         (1024 * 1024)
+#define SALT_SYNC_MS            1000
+
+/* 
+ * Missing ranges in the answer to a resume, more are sent as one range.
+ * The answer with 64-bit offsets must fit in STATIC_ARRAY.
+ */
+#define SALT_RESUME_RANGES      16
+
+/* Longest wait of the client for the answer to the resume in ms (the server checks its journal) */
+#define SALT_REPLY_TIMEOUT      30000
+
+/* Bytes of the sent file held in memory by one buffer of salt_file_source_t */
+#define SALT_SOURCE_WINDOW      (1024 * 1024)
+
+/* Bytes of the beginning and of the end of the sent file in its id */
+#define SALT_SOURCE_ID_EDGE     (64 * 1024)
+
+/* 
+ * Header of a block with the compression (client -z): method[1] size[4],
+ * the size is the bytes of the file in the block (little endian).
+ */
+#define SALT_BLOCK_HEADER_SIZE  5
+#define SALT_BLOCK_RAW          0
+#define SALT_BLOCK_LZ           1
+
+/* A block with more bits per byte (salt_lz_entropy()) is sent raw without a try */
+#define SALT_LZ_ENTROPY_MAX     7.5
+
+/*
+ * Pool of page aligned buffers of the same size. A block is read into
+ * a buffer of the pool, decrypted in place and its payloads are written
+ * to the file from there, so no copy of the block is made. The pool is
+ * not locked, with the thread of salt_writer_t it is used under the lock
+ * of the writer.
+ */
+typedef struct salt_buffer_pool_s
+{
+    uint8_t     *p_memory;      /**< One allocation for all buffers. */
+    uint32_t    buffer_size;    /**< Size of one buffer, a multiple of the page. */
+    uint32_t    count;          /**< Number of buffers, at most 32. */
+    uint32_t    free_mask;      /**< Bit i is set if the buffer i is free. */
+} salt_buffer_pool_t;
+
+
+/*
+ * Sliding window of the blocks. The sender has at most credit blocks
+ * sent behind the last confirmed one, the receiver confirms the blocks
+ * by "ACK <blocks> <credit>" with the count of all received blocks and 
+ * the credit for the next ones, the free buffers of its pool. With the
+ * credit 0 the sender waits for the next ACK, which the receiver sends
+ * when the disk frees a buffer.
+ */
+typedef struct salt_window_s
+{
+    uint32_t    blocks;         /**< Blocks sent (sender) or received (receiver). */
+    uint32_t    acked;          /**< Blocks confirmed by the last ACK. */
+    uint32_t    credit;         /**< Blocks which may follow the confirmed ones. */
+} salt_window_t;
+
+/*
+ * Source of the sent file with a constant memory, whatever the size of 
+ * the file. The file is mapped read-only (MADV_SEQUENTIAL) and the pages 
+ * behind the sent blocks are released, or it is read into two buffers
+ * of SALT_SOURCE_WINDOW bytes: the blocks are sent from one while the next
+ * part of the file is read into the other, by the io_uring or by the 
+ * kernel readahead (posix_fadvise()).
+ */
+typedef struct salt_file_source_s
+{
+    int         fd;
+    uint64_t    size;                       /**< Size of the file. */
+    uint32_t    window;                     /**< Bytes of a buffer, a multiple of the block. */
+    uint8_t     *p_map;                     /**< Mapping of the file, NULL with the buffers. */
+    uint64_t    released;                   /**< Pages of the mapping before it are released. */
+    salt_buffer_pool_t pool;                /**< Memory of the two buffers. */
+    uint8_t     *p_buffers[2];
+    uint64_t    offsets[2];                 /**< Offset of the buffer in the file. */
+    uint32_t    lengths[2];                 /**< Bytes in the buffer, 0 if it is empty. */
+    int         current;                    /**< Buffer of the sent blocks. */
+    int         reading;                    /**< 1 if the other buffer is read by the io_uring. */
+    salt_io_uring_t *p_uring;
+} salt_file_source_t;
+
+/*
+ * Compression of the sent blocks, see salt_compressor_init(). A block is
+ * compressed by salt_lz_compress() unless its sample looks random, 
+ * a block which does not get smaller is sent raw behind the header.
+ */
+typedef struct salt_compressor_s
+{
+    salt_lz_t   lz;
+    uint8_t     *p_block;                   /**< Header and the block to be sent. */
+    uint32_t    blocks;                     /**< Sent blocks. */
+    uint32_t    compressed;                 /**< Blocks sent compressed. */
+    uint64_t    raw_bytes;                  /**< Bytes of the file in the sent blocks. */
+    uint64_t    sent_bytes;                 /**< Bytes of the sent blocks with the headers. */
+} salt_compressor_t;
+
+/*
+ * Record of a block in the journal, the CRC32C of the record tells
+ * a complete record from a torn one written during a crash.
+ */
+typedef struct salt_journal_record_s
+{
+    uint32_t    block;                      /**< Index of the block in the file, a file has less than 2^32 blocks. */
+    uint32_t    size;                       /**< Payload bytes of the block. */
+    uint8_t     digest[SALT_DIGEST_SIZE];   /**< SHA-512 of the payload. */
+    uint32_t    crc;                        /**< CRC32C of the fields above. */
+} salt_journal_record_t;
+
+/*
+ * Journal of the received blocks, see salt_journal_open(). The written
+ * blocks are committed in batches: the data is synced first, then their
+ * records are appended and synced, so a committed block is on the disk.
+ * A batch is committed after sync_bytes of data or after sync_ms 
+ * milliseconds of its first block.
+ */
+typedef struct salt_journal_s
+{
+    int         fd;                         /**< Journal file. */
+    int         data_fd;                    /**< File of the received data. */
+    char        name[STATIC_ARRAY];         /**< Name of the journal, removed after the transfer. */
+    uint64_t    file_size;
+    uint32_t    block_size;
+    uint32_t    blocks;                     /**< Blocks of the file. */
+    uint32_t    length;                     /**< Bytes of the complete records and the header. */
+    uint8_t     *p_done;                    /**< 1 for a committed block. */
+    uint32_t    pending;                    /**< Written blocks waiting for the commit. */
+    uint64_t    pending_bytes;              /**< Data of the pending blocks. */
+    uint64_t    sync_bytes;
+    uint32_t    sync_ms;
+    double      pending_since;              /**< Time of the first pending block, see wall_time_seconds(). */
+    int         failed;                     /**< 1 after a failed commit, no record is added then. */
+    salt_journal_record_t batch[SALT_JOURNAL_BATCH];
+    salt_journal_record_t queued[32];       /**< Blocks whose writes are in the io_uring, by pool buffer. */
+} salt_journal_t;
+
+/* A decrypted block in the queue of the writer */
+typedef struct salt_writer_job_s
+{
+    uint8_t     *p_buffer;                  /**< Buffer of the pool, it returns after the write. */
+    uint8_t     *p_ranges[SALT_WRITE_IOV];  /**< Payloads of the block in the buffer. */
+    uint32_t    sizes[SALT_WRITE_IOV];
+    int         count;
+    uint64_t    offset;                     /**< Offset of the first payload in the file. */
+    salt_journal_record_t record;           /**< Record of the block, size 0 without it. */
+} salt_writer_job_t;
+
+/*
+ * Writer of the received file, see salt_writer_start(). The protocol
+ * thread queues the decrypted buffers and continues with the next frame,
+ * the thread of the writer joins the queued blocks which follow each 
+ * other into one pwritev(), journals them and returns their buffers to 
+ * the pool, so a slow disk does not stop the reception. With the io_uring
+ * of the link the writes go to the ring instead, on windows they are 
+ * written at once.
+ */
+typedef struct salt_writer_s
+{
+    int         fd;                         /**< File of the received data. */
+    salt_buffer_pool_t *p_pool;
+    salt_journal_t *p_journal;              /**< NULL without the journal. */
+    salt_io_uring_t *p_uring;               /**< Ring of the link, NULL without it. */
+    salt_writer_job_t jobs[32];             /**< Queue, a job holds a buffer of the pool. */
+    uint32_t    head;                       /**< Jobs queued by the protocol thread. */
+    uint32_t    tail;                       /**< Jobs written by the thread. */
+    int         running;                    /**< 1 if the thread writes the jobs. */
+    int         stop;                       /**< Set by salt_writer_finish(). */
+    int         failed;                     /**< 1 if a write or the journal failed. */
+#if !defined(_WIN32)
+    pthread_t   thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;                   /**< A job was queued or written. */
+#endif
+} salt_writer_t;
+
 
 /* =========================== FUNCTIONS ===================== */
 
@@ -105,25 +327,346 @@
 uint32_t sleep_miliseconds_win_linux(int sleep_miliseconds);
 
 /*
- * Function for creating / loading input file. 
+ * Wall-clock time for measurement of the transfer, 
+ * clock() gives only the CPU time of the process.
+ *
+ * @return  time in seconds
+ */
+double wall_time_seconds(void);
+
+/*
+ * Prints the summary of the transfer: wall-clock time, 
+ * CPU time and CPU time spent per transferred megabyte.
+ *
+ * @par size:           number of transferred bytes
+ * @par cpu_start:      clock() at the start of the transfer
+ * @par cpu_end:        clock() at the end of the transfer
+ * @par wall_elapsed:   wall-clock time of the transfer in seconds
+ */
+void salt_print_transfer_summary(uint64_t size,
+                                 clock_t cpu_start,
+                                 clock_t cpu_end,
+                                 double wall_elapsed);
+
+/*
+ * Prints the health of the link under the channel (salt_io_update_stats()):
+ * the error counters of the UART and the queued bytes. Called when a read
+ * fails, so a damaged frame can be told from a lost or a forged one.
+ *
+ * @par p_channel:      pointer to salt_channel_t structure
+ */
+void salt_print_line_stats(salt_channel_t *p_channel);
+
+/*
+ * Allocates count page aligned buffers of at least size bytes.
+ *
+ * @par p_pool:         pool to initialize
+ * @par size:           size of one buffer, it is rounded up to the page
+ * @par count:          number of buffers, 1 to 32
+ *
+ * @return 0            in case success
+ * @return -1           if the memory can not be allocated
+ */
+int salt_buffer_pool_init(salt_buffer_pool_t *p_pool, uint32_t size, uint32_t count);
+
+/*
+ * Takes a free buffer of the pool.
+ *
+ * @return  pointer to the buffer, NULL if all buffers are used
+ */
+uint8_t *salt_buffer_pool_get(salt_buffer_pool_t *p_pool);
+
+/*
+ * Returns the buffer taken by salt_buffer_pool_get() to the pool.
+ */
+void salt_buffer_pool_put(salt_buffer_pool_t *p_pool, uint8_t *p_buffer);
+
+/*
+ * Frees the memory of the pool.
+ */
+void salt_buffer_pool_free(salt_buffer_pool_t *p_pool);
+
+/*
+ * Sets the window before the first block, no block is confirmed and 
+ * the credit is SALT_WINDOW_BLOCKS.
+ */
+void salt_window_init(salt_window_t *p_window);
+
+/*
+ * Opens (creates) the output file for the received data. The data
+ * is written by pwritev() without the buffer of stdio. The file is not 
+ * truncated, salt_journal_open() keeps the blocks of a resumed transfer.
+ *
+ * @return  descriptor of the file, -1 in case of error
+ */
+int salt_open_output(const char *file);
+
+/*
+ * Allocates the blocks of the whole output up front (posix_fallocate()), 
+ * the file does not fragment and fdatasync() has no allocation to write.
+ *
+ * @return 0 in case success, -1 if there is not enough space
+ */
+int salt_preallocate_output(int fd, uint64_t size);
+
+/*
+ * Opens the journal of the output file data_fd. If the journal belongs to
+ * the same file (id, size and block size), the digests of its committed
+ * blocks are checked against the data on the disk and the transfer 
+ * continues with the rest. Otherwise the output and the journal start
+ * empty.
+ *
+ * @par p_id:           id of the file from the sender, SALT_DIGEST_SIZE bytes
+ *
+ * @return  number of the committed blocks, -1 in case of error
+ */
+int salt_journal_open(salt_journal_t *p_journal, 
+                      const char *file,
+                      int data_fd,
+                      uint64_t file_size, 
+                      uint32_t block_size,
+                      const uint8_t *p_id);
+
+/*
+ * Sets the budget of the batch: it is committed after sync_bytes of
+ * the written data or sync_ms after its first block, whichever comes 
+ * first, at most SALT_JOURNAL_BATCH blocks. salt_journal_open() sets 
+ * SALT_SYNC_BYTES and SALT_SYNC_MS.
+ */
+void salt_journal_set_budget(salt_journal_t *p_journal, uint64_t sync_bytes, uint32_t sync_ms);
+
+/*
+ * Adds the written block to the batch, the batch over its budget is 
+ * committed.
  *
- * @return  pointer to the stream(file)
+ * @return 0 in case success, -1 in case of error (also after any failed commit)
  */
-uint8_t *loading_file(char *file, 
-                      uint32_t *file_size, 
-                      int my_file);
+int salt_journal_add(salt_journal_t *p_journal, const salt_journal_record_t *p_record);
+
+/*
+ * Commits the written blocks: fdatasync() of the data and of their records.
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+int salt_journal_commit(salt_journal_t *p_journal);
+
+/*
+ * Byte ranges [begin, end) of the blocks which are not committed, at most
+ * max_ranges, the last one reaches the end of the file if there are more.
+ *
+ * @return  number of the ranges in p_ranges (2 numbers each)
+ */
+uint32_t salt_journal_missing(salt_journal_t *p_journal, uint64_t *p_ranges, uint32_t max_ranges);
+
+/*
+ * Commits the rest and closes the journal, the journal of a complete 
+ * file is removed.
+ */
+void salt_journal_close(salt_journal_t *p_journal, int complete);
+
+/*
+ * The writes of the buffer finished: its block goes to the journal (if 
+ * any) and the buffer returns to the pool.
+ *
+ * @return 0 in case success, -1 if the journal can not be written
+ */
+int salt_buffer_written(salt_buffer_pool_t *p_pool, salt_journal_t *p_journal, uint8_t *p_buffer);
+
+/*
+ * Starts the writer of the received file. Without p_uring (Linux) its 
+ * thread writes the blocks and owns the journal until salt_writer_finish().
+ *
+ * @par fd:             file of the received data (salt_open_output())
+ * @par p_pool:         pool of the receive buffers
+ * @par p_journal:      journal of the written blocks, NULL without it
+ * @par p_uring:        ring of the link whose writes are used, NULL without it
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+int salt_writer_start(salt_writer_t *p_writer, 
+                      int fd, 
+                      salt_buffer_pool_t *p_pool,
+                      salt_journal_t *p_journal,
+                      salt_io_uring_t *p_uring);
+
+/*
+ * A free buffer of the pool for the next block, it waits for the writes
+ * only if every buffer is queued.
+ *
+ * @return  pointer to the buffer, NULL if a write failed
+ */
+uint8_t *salt_writer_buffer(salt_writer_t *p_writer);
+
+/*
+ * Queues the payloads of the block in the buffer from the offset of the
+ * file, the buffer belongs to the writer after the call.
+ *
+ * @par p_record:       record of the block for the journal, NULL without it
+ * @par queued:         1 if the previous payloads of the buffer are in the ring
+ *
+ * @return 0 in case success, -1 if a write failed
+ */
+int salt_writer_submit(salt_writer_t *p_writer,
+                       uint8_t *p_buffer,
+                       uint8_t **pp_data,
+                       const uint32_t *p_sizes,
+                       int count,
+                       uint64_t offset,
+                       const salt_journal_record_t *p_record,
+                       int queued);
+
+/*
+ * Free buffers of the pool, the blocks which the receiver takes without
+ * waiting for the disk.
+ */
+uint32_t salt_writer_free(salt_writer_t *p_writer);
+
+/*
+ * Waits until count buffers of the pool are free, the writes of the 
+ * queued blocks finish meanwhile.
+ *
+ * @return  number of the free buffers, 0 if a write failed
+ */
+uint32_t salt_writer_wait_free(salt_writer_t *p_writer, uint32_t count);
+
+/*
+ * Waits for the queued writes, stops the thread and commits the journal.
+ *
+ * @return 0 in case success, -1 if a write or the journal failed
+ */
+int salt_writer_finish(salt_writer_t *p_writer);
+
+/*
+ * Opens the file as a source of the blocks. It is mapped, with p_uring 
+ * (or if it can not be mapped) it is read into the buffers.
+ *
+ * @par block_size:     size of the sent blocks, a block is never split
+ *                      between the buffers
+ * @par p_uring:        reads the buffers by the io_uring, NULL by read()
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+int salt_source_open(salt_file_source_t *p_source, 
+                     const char *file, 
+                     uint32_t block_size,
+                     salt_io_uring_t *p_uring);
+
+/*
+ * Bytes [offset, offset + size) of the file, a block of the file or 
+ * less. The pointer is valid until the next call.
+ *
+ * @return  pointer to the bytes, NULL in case of error
+ */
+const uint8_t *salt_source_get(salt_file_source_t *p_source, uint64_t offset, uint32_t size);
+
+/*
+ * Id of the file to be resumed: hex of the first SALT_DIGEST_SIZE bytes 
+ * of the SHA-512 of its size, modification time, inode and device and of
+ * its first and last SALT_SOURCE_ID_EDGE bytes, p_id has 
+ * 2 * SALT_DIGEST_SIZE + 1 chars. The file is not read as a whole, a
+ * changed file has a new time. The blocks sent again are checked by
+ * their digests in the journal of the receiver.
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+int salt_source_id(salt_file_source_t *p_source, char *p_id);
+
+/*
+ * Closes the file and releases the mapping or the buffers.
+ */
+void salt_source_close(salt_file_source_t *p_source);
+
+/*
+ * Allocates the block of the compressor, the header and block_size bytes.
+ *
+ * @return 0 in case success, -1 if the memory can not be allocated
+ */
+int salt_compressor_init(salt_compressor_t *p_compressor, uint32_t block_size);
+
+/*
+ * Frees the block of the compressor.
+ */
+void salt_compressor_free(salt_compressor_t *p_compressor);
+
+/*
+ * Sender side of a resume: sends "FILE <id>" (with " LZ" if the blocks
+ * are compressed) and reads the answer "RESUME <count> <begin> <end> ..." 
+ * with the byte ranges the receiver misses.
+ *
+ * @par p_id:           id of the file, see salt_source_id()
+ * @par compression:    1 if the blocks have the header of the compression
+ *
+ * @return  number of the ranges in p_ranges, -1 in case of error
+ */
+int salt_resume_client(salt_channel_t *p_channel,
+                       const char *p_id,
+                       uint64_t *p_ranges,
+                       uint32_t max_ranges,
+                       int compression);
+
+/*
+ * Receiver side of a resume: reads "FILE <id>", opens the journal of the
+ * output (salt_journal_open()) and answers with the missing ranges.
+ *
+ * @par p_compression:  1 if the sender compresses the blocks
+ *
+ * @return  number of the ranges in p_ranges, -1 in case of error
+ */
+int salt_resume_server(salt_channel_t *p_channel,
+                       salt_journal_t *p_journal,
+                       const char *file,
+                       int data_fd,
+                       uint64_t file_size,
+                       uint32_t block_size,
+                       uint64_t *p_ranges,
+                       uint32_t max_ranges,
+                       int *p_compression);
+
+/*
+ * Closes the file opened by salt_open_output().
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+int salt_close_output(int fd);
+
+/*
+ * Function for creating / loading input file. The file is not read 
+ * into the memory, it is opened as the source of the blocks.
+ *
+ * @par block_size:     size of the sent blocks
+ * @par p_source:       source of the file, see salt_source_open()
+ * @par p_uring:        reads the file by the io_uring ahead of the sent
+ *                      blocks, NULL maps it
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+int loading_file(char *file, 
+                 uint64_t *file_size, 
+                 int my_file,
+                 uint32_t block_size,
+                 salt_file_source_t *p_source,
+                 salt_io_uring_t *p_uring);
 
 /* 
  * Function for buffer preparation, data too, 
  * encryption and data sending (in Salt channel) for client and server.
  *
+ * Up to the credit of the receiver (SALT_WINDOW_BLOCKS) blocks are sent 
+ * without waiting, the confirmations which arrived meanwhile are read 
+ * between the blocks, see salt_window_t.
+ *
  * @par p_channel:       pointer to salt_channel_t structure
  * @par p_buffer:        buffer for encryption
  * @par size_buffer:     size of buffer
  * @par file_size:       size of data what we want encrypt and send
  * @par block_size:      size of block 
- * @par p_input:         input data 
+ * @par p_source:        source of the blocks, see salt_source_open()
  * @par p_msg:           pointer to salt_msg_t structure
+ * @par p_ranges:        byte ranges [begin, end) to be sent, the blocks
+ *                       the receiver misses (salt_resume_client())
+ * @par range_count:     number of the ranges
+ * @par p_compressor:    compresses the blocks, NULL sends them as they are,
+ *                       p_buffer has SALT_BLOCK_HEADER_SIZE bytes more
  *
  * @return SALT_SUCCESS          in case success
  * @return SALT_ERROR
@@ -132,32 +675,49 @@ uint8_t *loading_file(char *file,
 uint32_t salt_encrypt_and_send(salt_channel_t *p_channel,
                                uint8_t *p_buffer,
                                uint32_t size_buffer,
-                               uint32_t file_size,
+                               uint64_t file_size,
                                uint32_t block_size,
-                               uint8_t *p_input,
-                               salt_msg_t *p_msg);
+                               salt_file_source_t *p_source,
+                               salt_msg_t *p_msg,
+                               const uint64_t *p_ranges,
+                               uint32_t range_count,
+                               salt_compressor_t *p_compressor);
 
 /* 
  * Function for data receiving, decryption, verify and
  * read them (in Salt channel) for server.
  *
+ * The block is received into a buffer of the pool and decrypted 
+ * there, the payloads are queued to the writer at their offset in the
+ * file (salt_writer_submit()), the buffer returns to the pool when they 
+ * are written. A compressed block is decoded into a second buffer of the
+ * pool and the received one returns at once, so the memory stays the pool.
+ *
+ * The block is confirmed to the sender by an ACK every SALT_ACK_EVERY 
+ * blocks (sooner if the credit is lower) and after the last block.
+ *
  * @par p_channel:       pointer to salt_channel_t structure
- * @par p_buffer:        buffer for encryption
- * @par size_buffer:     size of buffer
+ * @par p_writer:        writer of the file (salt_writer_start()), the size
+ *                       of the buffers of its pool must be block size + 
+ *                       SALT_READ_OVRHD_SIZE (+ SALT_BLOCK_HEADER_SIZE
+ *                       with the compression)
  * @par p_msg:           pointer to salt_msg_t structure
- * @par *p_coppy_buffer  buffer, where is data copy
- * @par *p_decrypt_size  decrypt size of decryption data
- * @par *fp		 file, where is decrypted data stored 
+ * @par *p_decrypt_size  decrypt size of decryption data, it is the 
+ *                       offset of the next payload in the file
+ * @par expected_size    size of the whole file, the last block is confirmed
+ * @par p_window         confirmed blocks, initialized by salt_window_init()
+ * @par compression      1 if the blocks have the header of the compression
  *
  * @return 1         in case success
+ * @return 0         if the data can not be written
  */
 uint32_t salt_read_and_decrypt_server(salt_channel_t *p_channel,
-                                        uint8_t *p_buffer,
-                                        uint32_t size_buffer,
+                                        salt_writer_t *p_writer,
                                         salt_msg_t *p_msg,
-                                        uint8_t *p_coppy_buffer,
-                                        uint32_t *p_decrypt_size,
-                                        FILE *fp);
+                                        uint64_t *p_decrypt_size,
+                                        uint64_t expected_size,
+                                        salt_window_t *p_window,
+                                        int compression);
 
 /* 
  * Function for Salt channel protocol deployment for the client 
@@ -166,7 +726,7 @@ uint32_t salt_read_and_decrypt_server(salt_channel_t *p_channel,
  * @par p_client_channel:       pointer to salt_channel_t structure
  * @par write_impl:             write implementation 
  * @par read_impl:              read implementation 
- * @par p_cport_nr:             number of port
+ * @par p_io_ctx:               context of the port (salt_io_ctx_t)
  * @par p_time_impl             time implementation
  * @par treshold                value for threshold
  *
@@ -177,7 +737,7 @@ uint32_t salt_read_and_decrypt_server(salt_channel_t *p_channel,
 salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_channel, 
                                     salt_io_impl write_impl,
                                     salt_io_impl read_impl,
-                                    int *p_cport_nr,
+                                    salt_io_ctx_t *p_io_ctx,
                                     salt_time_t *p_time_impl,
                                     uint32_t treshold); 
 
@@ -189,7 +749,7 @@ salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_channel,
  * @par p_protocols:            version of protocol
  * @par write_impl:             write implementation 
  * @par read_impl:              read implementation 
- * @par p_cport_nr:             number of port
+ * @par p_io_ctx:               context of the port (salt_io_ctx_t)
  * @par p_time_impl             time implementation
  * @par p_signature             array with signature
  * @par treshold                value for threshold
@@ -202,7 +762,7 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
                                     salt_protocols_t *p_protocols, 
                                     salt_io_impl write_impl,
                                     salt_io_impl read_impl,
-                                    int *p_cport_nr,
+                                    salt_io_ctx_t *p_io_ctx,
                                     salt_time_t *p_time_impl,
                                     const uint8_t *p_signature,
                                     uint32_t treshold); 
@@ -240,7 +800,7 @@ uint32_t salt_read_small_messages(salt_channel_t *p_channel,
                                  uint8_t *p_buffer,
                                  uint32_t buffer_size,
                                  salt_msg_t *p_msg,
-                                 uint32_t *p_expceted_size,
+                                 uint64_t *p_expceted_size,
                                  uint32_t read_convert_size);
 
 /* 
@@ -252,7 +812,44 @@ uint32_t salt_read_small_messages(salt_channel_t *p_channel,
  * @return 1          		in case success
  */
 uint32_t salt_convert_size_and_send(salt_channel_t *p_channel,
-                                    uint32_t convert_size);  
+                                    uint64_t convert_size);  
+
+/* 
+ * Negotiates a higher baudrate after the handshake, the client side.
+ * The offer (SALT_BAUDRATES above the current rate) is answered by the
+ * rates of both ports. For each of them from the highest, both peers switch,
+ * the client sends a probe which the server echoes, both switch back
+ * and the client sends the result. The first rate which passes is used,
+ * the current rate stays if none passes. A link which is not a port 
+ * (socket, ring) is skipped, the server skips it the same way.
+ *
+ * @par p_channel:       pointer to salt_channel_t structure after the handshake
+ * @par p_io_ctx:        context of the port (salt_io_ctx_t)
+ * @par baudrate:        current baudrate
+ * @par mode:            mode of the port, e.g. "8N1"
+ *
+ * @return the baudrate used from now on
+ */
+int salt_baudrate_upshift_client(salt_channel_t *p_channel,
+                                 salt_io_ctx_t *p_io_ctx,
+                                 int baudrate,
+                                 const char *mode);
+
+/* 
+ * Negotiates a higher baudrate after the handshake, the server side,
+ * see salt_baudrate_upshift_client().
+ *
+ * @par p_channel:       pointer to salt_channel_t structure after the handshake
+ * @par p_io_ctx:        context of the port (salt_io_ctx_t)
+ * @par baudrate:        current baudrate
+ * @par mode:            mode of the port, e.g. "8N1"
+ *
+ * @return the baudrate used from now on
+ */
+int salt_baudrate_upshift_server(salt_channel_t *p_channel,
+                                 salt_io_ctx_t *p_io_ctx,
+                                 int baudrate,
+                                 const char *mode);
 
 
 #endif
@@ -15,6 +15,562 @@
 #define SALT_IO_H
 
 #include "salt.h"
+#include "rs232.h"
+#include "salt_io_transport.h"
+
+/* Default deadline of one my_read() call in milliseconds */
+#define SALT_IO_READ_TIMEOUT        1000
+
+/* Bytes which may wait in the TX queue of the driver before my_write() waits */
+#define SALT_IO_TX_QUEUE_LIMIT      4096
+
+/* 
+ * Profile of the reads opened by salt_io_open_port(): a read returns after 
+ * the requested bytes (at most 255) or 100 ms after the last received byte,
+ * i.e. the 4 size bytes in one read and the package in chunks of 255 bytes.
+ */
+#define SALT_IO_READ_VMIN           255
+#define SALT_IO_READ_VTIME          1
+
+/* 
+ * Size of the read-ahead buffer. Everything the port has is read into it,
+ * the size bytes, the package and the rest (the next frame) are then 
+ * served from the memory. Larger packages are read directly.
+ */
+#define SALT_IO_RX_BUFFER_SIZE      8192
+
+/* 
+ * Coalescing of the small frames opened by salt_io_open_port(): the frames
+ * are staged until SALT_IO_TX_COALESCE_BYTES are collected or the oldest 
+ * one waits SALT_IO_TX_COALESCE_LATENCY microseconds, then they are written
+ * by one writev(). SALT_IO_TX_STAGE_SIZE is the maximum of the budget.
+ */
+#define SALT_IO_TX_STAGE_SIZE       1024
+#define SALT_IO_TX_COALESCE_BYTES   512
+#define SALT_IO_TX_COALESCE_LATENCY 2000
+
+/*
+ * Framing of the frames on the link, see salt_io_set_framing(). 
+ * SALT_IO_FRAMING_COBS stuffs the zero bytes out of each frame (COBS) 
+ * and ends it with a zero, a damaged frame is dropped and the reader 
+ * continues with the next one. SALT_IO_FRAME_SIZE is the maximum of 
+ * one framed frame (the size bytes included).
+ */
+#define SALT_IO_FRAMING_NONE        0
+#define SALT_IO_FRAMING_COBS        1
+#define SALT_IO_FRAME_SIZE          16384
+#define SALT_IO_COBS_SIZE           (SALT_IO_FRAME_SIZE + SALT_IO_FRAME_SIZE / 254 + 2)
+
+/*
+ * Context of the link passed to my_write() / my_read()
+ * with salt_set_context().
+ */
+typedef struct salt_io_ctx_s {
+    const salt_io_transport_t *p_transport; /**< Operations of the link. */
+    rs232_port_t *p_port;           /**< RS-232 port (serial transport). */
+    rs232_port_t port;              /**< Port owned by the context, see salt_io_open_device(). */
+    int         fd;                 /**< Connected socket (socket transport). */
+    salt_io_ring_t *p_rx_ring;      /**< Received bytes (shared-memory transport). */
+    salt_io_ring_t *p_tx_ring;      /**< Sent bytes (shared-memory transport). */
+    salt_io_thread_t *p_thread;     /**< I/O thread owning the link (thread transport). */
+    salt_io_arq_t *p_arq;           /**< ARQ owning the link (ARQ transport). */
+    salt_io_fec_t *p_fec;           /**< FEC owning the link (FEC transport). */
+    salt_io_bond_t *p_bond;         /**< Ports bonded into the link (bond transport). */
+    salt_io_uring_t *p_uring;       /**< io_uring owning the link (io_uring transport). */
+    int32_t     read_timeout;       /**< Deadline of my_read() in ms, < 0 waits forever. */
+    int         non_blocking;       /**< 1 if my_write() / my_read() never wait. */
+    int         read_batching;      /**< 1 if the reads block in the kernel (VMIN > 0). */
+
+    /* Pacing of the transmitter (token bucket refilled at the line rate) */
+    uint32_t    line_rate;          /**< Characters per second on the line, 0 = not paced. */
+    uint32_t    tx_queue_limit;     /**< Capacity of the bucket, max bytes queued in the driver. */
+    double      tx_tokens;          /**< Bytes which can be queued now. */
+    uint64_t    tx_refill_us;       /**< Time of the last refill in microseconds. */
+
+    /* Read-ahead buffer, bytes received from the port but not read by salt yet */
+    uint8_t     rx_buffer[SALT_IO_RX_BUFFER_SIZE];
+    uint32_t    rx_begin;           /**< Index of the first unread byte. */
+    uint32_t    rx_end;             /**< Index behind the last received byte. */
+
+    /* Small frames waiting to be written together */
+    uint8_t     tx_stage[SALT_IO_TX_STAGE_SIZE];
+    uint32_t    tx_staged;          /**< Bytes in tx_stage. */
+    uint64_t    tx_staged_us;       /**< Time when the oldest staged frame was written. */
+    uint32_t    tx_coalesce_bytes;  /**< Byte budget of the stage, 0 = no coalescing. */
+    uint32_t    tx_coalesce_us;     /**< Latency budget of the oldest frame in microseconds. */
+
+    /* COBS framing (SALT_IO_FRAMING_COBS) */
+    int         framing;            /**< SALT_IO_FRAMING_NONE or SALT_IO_FRAMING_COBS. */
+    uint8_t     tx_frame[SALT_IO_COBS_SIZE];
+    uint32_t    tx_frame_len;       /**< Bytes of the encoded frame, 0 = no frame is being sent. */
+    uint32_t    tx_frame_sent;      /**< Bytes of the encoded frame which left. */
+    uint8_t     rx_frame[SALT_IO_FRAME_SIZE];
+    salt_io_cobs_t rx_cobs;         /**< Decoder of rx_frame, rx_cobs.len bytes decoded. */
+    uint32_t    rx_frame_begin;     /**< Bytes of the complete frame read by salt. */
+    int         rx_frame_ready;     /**< 1 if rx_frame holds a complete frame. */
+    uint32_t    frames_dropped;     /**< Damaged frames dropped by the reader. */
+
+    /* Emulated noise of the serial transport, see salt_io_set_error_rate() */
+    uint32_t    error_threshold;    /**< A sent bit is flipped if the next random number is below it. */
+    uint32_t    error_seed;         /**< State of the xorshift generator. */
+} salt_io_ctx_t;
+
+/*
+ * Initializes the context of the port with default values,
+ * the transport is the RS-232 port p_port.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par p_port:         opened RS-232 port, NULL for the port owned by the context
+ */
+void salt_io_ctx_init(salt_io_ctx_t *p_ctx, rs232_port_t *p_port);
+
+/*
+ * Opens the RS-232 port with the batching of the reads in the kernel
+ * (SALT_IO_READ_VMIN / SALT_IO_READ_VTIME) and initializes the context
+ * of the port together with the pacing (salt_io_set_line()).
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par cport_nr:       number of RS-232 port, see RS232_GetPort()
+ * @par baudrate:       baudrate, e.g. 115200
+ * @par mode:           mode of the port, e.g. "8N1"
+ * @par flowctrl:       1 enables RTS/CTS flow control
+ *
+ * @return 0            in case success
+ * @return 1            the port can not be opened
+ */
+int salt_io_open_port(salt_io_ctx_t *p_ctx, 
+                      int cport_nr, 
+                      int baudrate, 
+                      const char *mode, 
+                      int flowctrl);
+
+/*
+ * Same as salt_io_open_port(), but the device is given by its path and 
+ * the port is owned by the context. Each channel has its own port state,
+ * so many channels can run in the threads of one process.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par p_device:       path of the device, e.g. /dev/ttyUSB0 or \\.\COM3
+ * @par baudrate:       baudrate, e.g. 115200
+ * @par mode:           mode of the port, e.g. "8N1"
+ * @par flowctrl:       1 enables RTS/CTS flow control
+ *
+ * @return 0            in case success
+ * @return 1            the port can not be opened
+ */
+int salt_io_open_device(salt_io_ctx_t *p_ctx, 
+                        const char *p_device, 
+                        int baudrate, 
+                        const char *mode, 
+                        int flowctrl);
+
+/*
+ * Same as salt_io_open_device(), but the port is the master side of a new
+ * pseudo terminal (Linux). The peer opens the slave side p_slave_name
+ * (e.g. /dev/pts/3) as a normal device with salt_io_open_device(), 
+ * so the client and the server run on one machine without serial ports.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par baudrate:       baudrate, e.g. 115200, the pacing simulates this line
+ * @par mode:           mode of the port, e.g. "8N1"
+ * @par p_slave_name:   buffer for the name of the slave side
+ * @par size:           size of p_slave_name
+ *
+ * @return 0            in case success
+ * @return 1            the pseudo terminal can not be created
+ */
+int salt_io_open_pty(salt_io_ctx_t *p_ctx, 
+                     int baudrate, 
+                     const char *mode, 
+                     char *p_slave_name,
+                     int size);
+
+/*
+ * Same as salt_io_open_port(), but the link is an AF_UNIX socket (Linux).
+ * The server listens on p_path and accepts one client, the client 
+ * connects to it. my_write() is not paced, the frames are coalesced.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par p_path:         path of the socket, e.g. /tmp/salt.sock
+ * @par listen_flag:    1 for the server, 0 for the client
+ *
+ * @return 0            in case success
+ * @return 1            the socket can not be opened or connected
+ */
+int salt_io_open_unix(salt_io_ctx_t *p_ctx, const char *p_path, int listen_flag);
+
+/*
+ * Same as salt_io_open_unix(), but the link is a TCP connection
+ * on the loopback 127.0.0.1 (Nagle algorithm is disabled).
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par port:           TCP port
+ * @par listen_flag:    1 for the server, 0 for the client
+ *
+ * @return 0            in case success
+ * @return 1            the socket can not be opened or connected
+ */
+int salt_io_open_tcp(salt_io_ctx_t *p_ctx, uint16_t port, int listen_flag);
+
+/*
+ * Connects two contexts by the shared-memory rings in p_shm, e.g. the client
+ * and the server running in two threads of one process. Each context must
+ * be used by one thread only, p_shm must live until both are closed.
+ *
+ * @par p_ctx_a:        pointer to salt_io_ctx_t structure of one end
+ * @par p_ctx_b:        pointer to salt_io_ctx_t structure of the other end
+ * @par p_shm:          pointer to salt_io_shm_t structure
+ */
+void salt_io_open_shm_pair(salt_io_ctx_t *p_ctx_a, 
+                           salt_io_ctx_t *p_ctx_b, 
+                           salt_io_shm_t *p_shm);
+
+/*
+ * Bonds the opened links of count contexts (e.g. RS-232 ports opened by
+ * salt_io_open_device()) into one link of p_ctx, the peer bonds the other
+ * ends of the cables in the same order. The frames are cut into stripes,
+ * each one goes through one port, in turn (SALT_IO_BOND_ROUND_ROBIN) or
+ * through the port with the shortest output queue (SALT_IO_BOND_QUEUE_DEPTH,
+ * a slow or stalled port gets less). The receiver puts the stripes in order
+ * for salt. p_ctx is paced by the sum of the line rates of the ports.
+ *
+ * A port which fails (an error, a hangup, a damaged header) is left out, 
+ * the stripes lost with it are skipped by the receiver when every other 
+ * port delivered a later stripe. The ARQ started above the bond sends them
+ * again, without it salt sees the gap and closes the session. A port can
+ * have its own FEC (salt_io_start_fec() before the bonding).
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure of the bonded link
+ * @par p_bond:         pointer to salt_io_bond_t structure, lives until salt_io_close()
+ * @par p_ports:        array of count contexts with opened links, they live 
+ *                      until salt_io_close() of p_ctx, which closes them
+ * @par count:          number of the ports, 1 to SALT_IO_BOND_MAX
+ * @par mode:           SALT_IO_BOND_ROUND_ROBIN or SALT_IO_BOND_QUEUE_DEPTH
+ *
+ * @return 0            in case success
+ * @return 1            wrong count or mode
+ */
+int salt_io_open_bond(salt_io_ctx_t *p_ctx, 
+                      salt_io_bond_t *p_bond, 
+                      salt_io_ctx_t *p_ports, 
+                      int count, 
+                      int mode);
+
+/*
+ * Moves the opened link of the context into a new I/O thread (Linux).
+ * my_write() only copies the frame into the ring of the thread and returns,
+ * so the next frame is encrypted while the previous one is on the wire, 
+ * and the received bytes wait in the other ring for my_read(). The thread 
+ * waits for the line itself, my_write() is not paced and not coalesced.
+ * salt_io_close() sends the rest, stops the thread and closes the link.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure with an opened link
+ * @par p_thread:       pointer to salt_io_thread_t structure, lives until salt_io_close()
+ *
+ * @return 0            in case success
+ * @return 1            the thread can not be started
+ */
+int salt_io_start_thread(salt_io_ctx_t *p_ctx, salt_io_thread_t *p_thread);
+
+/*
+ * Creates the io_uring of a transfer (Linux). It can own the link 
+ * (salt_io_start_uring()) and read the file of the sender ahead 
+ * (salt_io_uring_read_file()) or write the file of the receiver 
+ * (salt_io_uring_write_file()) in the same ring.
+ *
+ * @par p_uring:        pointer to salt_io_uring_t structure
+ *
+ * @return 0            in case success
+ * @return 1            io_uring is not supported
+ */
+int salt_io_uring_init(salt_io_uring_t *p_uring);
+
+/*
+ * Releases the ring, the link owned by it is closed by salt_io_close().
+ */
+void salt_io_uring_exit(salt_io_uring_t *p_uring);
+
+/*
+ * Moves the opened link with a descriptor (port, pseudo terminal, socket)
+ * into the io_uring, before the ARQ and the FEC. One read of the link 
+ * waits in the ring all the time, my_write() appends to the buffer of the
+ * ring and the write is submitted with the next call, the completions are
+ * reaped in bulk. The noise of salt_io_set_error_rate() is not 
+ * emulated under it.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure with an opened link
+ * @par p_uring:        ring of salt_io_uring_init(), lives until salt_io_close()
+ *
+ * @return 0            in case success
+ * @return 1            the link has no descriptor or another layer runs already
+ */
+int salt_io_start_uring(salt_io_ctx_t *p_ctx, salt_io_uring_t *p_uring);
+
+/*
+ * Reads size bytes of the file from the offset, in reads of 
+ * SALT_IO_URING_FILE_CHUNK bytes submitted together. Without p_owner 
+ * it returns after the reads, with p_owner it returns at once and the 
+ * buffer is filled when p_owner is returned by salt_io_uring_file_done().
+ *
+ * @return 0            in case success
+ * @return -1           the file is shorter or can not be read
+ */
+int salt_io_uring_read_file(salt_io_uring_t *p_uring, int fd, uint8_t *p_buffer, uint32_t size,
+                            uint64_t offset, void *p_owner);
+
+/*
+ * Submits the writes of count ranges one after another from the offset
+ * of the file and returns, the ranges must not change until p_owner is 
+ * returned by salt_io_uring_file_done().
+ *
+ * @par last:           0 if more writes of p_owner follow in the next call,
+ *                      p_owner is returned only after a call with last 1
+ *                      (count may be 0)
+ *
+ * @return 0            in case success
+ * @return -1           a write of the file failed
+ */
+int salt_io_uring_write_file(salt_io_uring_t *p_uring, int fd, uint8_t **pp_data, 
+                             const uint32_t *p_sizes, int count, uint64_t offset, void *p_owner, 
+                             int last);
+
+/*
+ * Returns an owner of salt_io_uring_write_file() or salt_io_uring_read_file()
+ * whose writes or reads finished, NULL if there is none. With wait it 
+ * waits for the operations in flight. Each owner is returned once for 
+ * all of its submitted operations.
+ */
+void *salt_io_uring_file_done(salt_io_uring_t *p_uring, int wait);
+
+/*
+ * Puts a selective-repeat ARQ between my_write() / my_read() and the opened
+ * link (also above the I/O thread), both peers must start it before the 
+ * handshake. The bytes are sent in chunks with a sequence number and CRC32C
+ * (framed by COBS), the receiver acknowledges them cumulatively with a SACK
+ * bitmap and only the damaged or lost chunks are sent again, so a bit error
+ * on the cable does not reach salt and does not close the session.
+ * The ARQ runs in the calls of my_write() / my_read(), salt_io_drain() 
+ * waits until the peer acknowledged every chunk. The baudrate of the port
+ * can not be changed under the ARQ.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure with an opened link
+ * @par p_arq:          pointer to salt_io_arq_t structure, lives until salt_io_close()
+ *
+ * @return 0            in case success
+ * @return 1            the ARQ runs already or the written frames can not be sent
+ */
+int salt_io_start_arq(salt_io_ctx_t *p_ctx, salt_io_arq_t *p_arq);
+
+/*
+ * Puts a Reed-Solomon FEC between my_write() / my_read() and the opened 
+ * link (also above the I/O thread, under the ARQ), both peers must start
+ * it with the same parity before the handshake. Each codeword of 255 bytes
+ * carries 255 - parity - 1 bytes of the frames, up to parity / 2 damaged 
+ * bytes of it are corrected in place before salt sees the frame, so a 
+ * steady bit error rate costs no round trip. The FEC runs in the calls of
+ * my_write() / my_read(), the baudrate of the port can not be changed
+ * under it.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure with an opened link
+ * @par p_fec:          pointer to salt_io_fec_t structure, lives until salt_io_close()
+ * @par parity:         even number of parity bytes, SALT_IO_FEC_PARITY_MIN to 
+ *                      SALT_IO_FEC_PARITY_MAX, e.g. SALT_IO_FEC_PARITY
+ *
+ * @return 0            in case success
+ * @return 1            wrong parity, the FEC or the ARQ runs already or the 
+ *                      written frames can not be sent
+ */
+int salt_io_start_fec(salt_io_ctx_t *p_ctx, salt_io_fec_t *p_fec, uint32_t parity);
+
+/*
+ * Emulates a noisy line for the tests of the FEC and the ARQ (e.g. over 
+ * a pseudo terminal): the serial transport flips each sent bit with the
+ * probability ber. The bits are flipped in a copy, the frames of the 
+ * caller stay unchanged.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par ber:            bit error rate, e.g. 0.0001, 0 switches it off
+ */
+void salt_io_set_error_rate(salt_io_ctx_t *p_ctx, double ber);
+
+/*
+ * Closes the link of the context (the port, the socket or the ring).
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ */
+void salt_io_close(salt_io_ctx_t *p_ctx);
+
+/*
+ * Sets how long my_read() waits in poll() for the data,
+ * after that time it returns SALT_PENDING.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par timeout:        deadline in milliseconds, < 0 waits forever
+ */
+void salt_io_set_read_timeout(salt_io_ctx_t *p_ctx, int32_t timeout);
+
+/*
+ * Switches my_write() and my_read() to the non-blocking mode. They never
+ * wait for the link then: my_read() returns SALT_PENDING when nothing
+ * has been received, my_write() sends what the link takes now and returns
+ * SALT_PENDING with the rest. The channel is driven by an event loop, see
+ * salt_io_poll_channel(). Blocking mode is the default.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par non_blocking:   1 non-blocking, 0 blocking mode
+ */
+void salt_io_set_non_blocking(salt_io_ctx_t *p_ctx, int non_blocking);
+
+/*
+ * Reports what the channel (its context set by salt_set_context()) waits 
+ * for after a salt function returned SALT_PENDING: the descriptor for 
+ * poll() / epoll and SALT_IO_WANT_READ / SALT_IO_WANT_WRITE. The staged 
+ * frames (see salt_io_set_coalescing()) need the write readiness too.
+ * A write can succeed with its frame still staged, so the loop keeps
+ * calling salt_io_flush() while SALT_IO_WANT_WRITE is reported.
+ *
+ * @par p_channel:      pointer to salt_channel_t structure
+ * @par p_interest:     readiness the channel waits for, 0 if nothing is pending
+ *
+ * @return descriptor   of the link
+ * @return -1           the link can not be polled (shared memory, windows),
+ *                      use salt_io_wait_channel()
+ */
+int salt_io_poll_channel(salt_channel_t *p_channel, uint8_t *p_interest);
+
+/*
+ * Reads the health of the link: the error counters of the UART driver
+ * (TIOCGICOUNT) and the bytes in the input / output queue of the link.
+ * Under the I/O thread, the FEC and the ARQ the port at the bottom is read,
+ * the counters and the queues of bonded ports are summed. A pseudo
+ * terminal or a socket has no counters, they are zero then.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par p_stats:        filled statistics
+ *
+ * @return 1            the counters are valid
+ * @return 0            the link has no counters, only the queues are filled
+ */
+int salt_io_get_stats(salt_io_ctx_t *p_ctx, salt_io_stats_t *p_stats);
+
+/*
+ * Refreshes p_channel->io_stats from the link of the channel (its context
+ * set by salt_set_context()), e.g. when a read failed with SALT_ERROR.
+ *
+ * @par p_channel:      pointer to salt_channel_t structure
+ *
+ * @return pointer      to p_channel->io_stats
+ */
+salt_io_stats_t *salt_io_update_stats(salt_channel_t *p_channel);
+
+/*
+ * Waits until the link of the channel is ready for what the channel
+ * waits for (salt_io_poll_channel()), for one channel without an event loop.
+ * Frames staged by my_write() are written when their latency budget 
+ * expires during the wait (see salt_io_set_coalescing()).
+ *
+ * @par p_channel:      pointer to salt_channel_t structure
+ * @par timeout_ms:     deadline in milliseconds, < 0 waits forever
+ *
+ * @return 1            the link is ready or nothing is pending
+ * @return 0            the deadline expired
+ * @return -1           in case of an error
+ */
+int salt_io_wait_channel(salt_channel_t *p_channel, int timeout_ms);
+
+/*
+ * Sets the line parameters used for pacing of my_write(). One character
+ * takes start bit + data bits + parity bit + stop bits on the line,
+ * e.g. 10 bits for "8N1". The real depth of the TX queue (TIOCOUTQ) is
+ * used when the driver reports it, the token bucket otherwise.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par baudrate:       baudrate of the port, 0 disables the pacing
+ * @par mode:           mode of the port, e.g. "8N1"
+ *
+ * @return 0            in case success
+ * @return -1           invalid mode
+ */
+int salt_io_set_line(salt_io_ctx_t *p_ctx, int baudrate, const char *mode);
+
+/*
+ * Changes the baudrate of the opened RS-232 port (also under the I/O 
+ * thread) and its pacing. The written frames leave with the old rate first.
+ * Any rate can be used on Linux (termios2), the pacing follows the rate
+ * which the driver really set.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par baudrate:       new baudrate, e.g. 921600
+ * @par mode:           mode of the port, e.g. "8N1"
+ *
+ * @return 0            in case success
+ * @return -1           the link is not a port or the port refused the rate
+ */
+int salt_io_set_baudrate(salt_io_ctx_t *p_ctx, int baudrate, const char *mode);
+
+/*
+ * Drops the received bytes which were not read yet, e.g. the garbage
+ * received while the peers changed the baudrate.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ */
+void salt_io_discard_input(salt_io_ctx_t *p_ctx);
+
+/*
+ * Selects the framing of the frames on the link, both peers must use 
+ * the same one before the handshake. With SALT_IO_FRAMING_COBS a frame
+ * whose size bytes do not match its length (a byte was lost or damaged)
+ * is dropped and counted, the reader continues with the next frame 
+ * instead of reading a garbage length. The staged frames leave first.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par framing:        SALT_IO_FRAMING_NONE or SALT_IO_FRAMING_COBS
+ *
+ * @return 0            in case success
+ * @return -1           unknown framing or the staged frames can not be written
+ */
+int salt_io_set_framing(salt_io_ctx_t *p_ctx, int framing);
+
+/*
+ * Sets the budgets of the coalescing in my_write(). A frame which fits 
+ * behind the staged frames into max_bytes is only staged, the stage is 
+ * written when it is full, when the oldest frame is older than latency_us 
+ * (checked by the next my_write() and by salt_io_wait_channel(), which
+ * waits for reading at most until then), by salt_io_flush() and before 
+ * my_read() waits for data. latency_us is not a timer: a caller which 
+ * stops writing and neither reads nor waits calls salt_io_flush().
+ * The frames already staged are flushed first.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ * @par max_bytes:      byte budget (max. SALT_IO_TX_STAGE_SIZE), 0 disables it
+ * @par latency_us:     latency budget in microseconds
+ *
+ * @return 0            in case success
+ * @return -1           the staged frames can not be written
+ */
+int salt_io_set_coalescing(salt_io_ctx_t *p_ctx, uint32_t max_bytes, uint32_t latency_us);
+
+/*
+ * Writes the staged frames to the port now. In the non-blocking mode 
+ * only the bytes which the link takes now, the rest stays staged.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ *
+ * @return 0            in case success
+ * @return -1           in case of an error
+ */
+int salt_io_flush(salt_io_ctx_t *p_ctx);
+
+/*
+ * Writes the staged frames (salt_io_flush()) and blocks until all 
+ * the bytes written by my_write() left the UART (tcdrain) or the link.
+ *
+ * @par p_ctx:          pointer to salt_io_ctx_t structure
+ *
+ * @return 0            in case success
+ * @return -1           in case of an error
+ */
+int salt_io_drain(salt_io_ctx_t *p_ctx);
 
 salt_ret_t my_write(salt_io_channel_t *p_wchannel);
 salt_ret_t my_read(salt_io_channel_t *p_rchannel);
@@ -0,0 +1,429 @@
+/*
+ * Transports of the salt I/O
+ *
+ * The links which can carry the frames written by my_write() and read
+ * by my_read(): RS-232 port (or pseudo terminal), AF_UNIX socket,
+ * TCP socket on the loopback and a shared-memory ring in one process.
+ * The transport is selected at run time by the function which opens
+ * the context (salt_io_open_port(), salt_io_open_unix(), ...).
+ *
+ * Windows/Linux (the sockets only on Linux)
+ *
+ * KEMT FEI TUKE, Diploma thesis
+ */
+
+#ifndef SALT_IO_TRANSPORT_H
+#define SALT_IO_TRANSPORT_H
+
+#include <stdint.h>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+/* Size of one direction of the shared-memory ring, power of 2 */
+#define SALT_IO_RING_SIZE           16384
+
+/*
+ * Selective-repeat ARQ under salt_io, see salt_io_start_arq(). The bytes
+ * are sent in chunks of at most SALT_IO_ARQ_CHUNK bytes with a sequence
+ * number and CRC32C, at most SALT_IO_ARQ_WINDOW chunks are not acknowledged
+ * (32 is the width of the SACK bitmap). A chunk is sent again after the 
+ * retransmission timeout (between SALT_IO_ARQ_RTO_MIN and SALT_IO_ARQ_RTO_MAX
+ * milliseconds, measured from the round trips) or when a later chunk was
+ * acknowledged. The timeout runs only when the link sent everything queued
+ * before the chunk, a repetition waits at most SALT_IO_ARQ_RTO_MAX, so a 
+ * message is late by far less than the TRESHOLD of salt (3000 ms).
+ * The receiver repeats its acknowledgement every SALT_IO_ARQ_ACK_REPEAT
+ * milliseconds for SALT_IO_ARQ_RTO_MAX after the last chunk (a lost one).
+ * A chunk not acknowledged in SALT_IO_ARQ_DEAD_MS after its first sending
+ * means a dead link, it is longer than the pauses of the peer without 
+ * my_read() / my_write() (writing of the file, encryption).
+ */
+#define SALT_IO_ARQ_CHUNK           256
+#define SALT_IO_ARQ_WINDOW          32
+#define SALT_IO_ARQ_RTO_INIT        500
+#define SALT_IO_ARQ_RTO_MIN         20
+#define SALT_IO_ARQ_RTO_MAX         500
+#define SALT_IO_ARQ_ACK_REPEAT      50
+#define SALT_IO_ARQ_DEAD_MS         10000
+
+/* Chunk on the wire: type[1] seq[2] data[n] crc32c[4], framed by COBS */
+#define SALT_IO_ARQ_HEADER_SIZE     3
+#define SALT_IO_ARQ_CRC_SIZE        4
+#define SALT_IO_ARQ_FRAME_SIZE      (SALT_IO_ARQ_HEADER_SIZE + SALT_IO_ARQ_CHUNK + SALT_IO_ARQ_CRC_SIZE)
+
+/* Encoded chunks and acknowledgements waiting for the link */
+#define SALT_IO_ARQ_WIRE_SIZE       4096
+
+/*
+ * Reed-Solomon FEC under salt_io, see salt_io_start_fec(). The bytes are
+ * sent in codewords of SALT_IO_FEC_N bytes over GF(2^8): count[1] data[k - 1]
+ * parity[p] with k = SALT_IO_FEC_N - p (masked by a fixed pseudo-random 
+ * sequence), the receiver corrects up to p / 2 damaged bytes of each codeword. A codeword with more errors is dropped,
+ * after two of them in a row the receiver searches the start of the next 
+ * codeword byte by byte (a byte lost by an overrun shifts the stream).
+ */
+#define SALT_IO_FEC_N               255
+#define SALT_IO_FEC_PARITY          32
+#define SALT_IO_FEC_PARITY_MIN      8
+#define SALT_IO_FEC_PARITY_MAX      64
+
+/* Codewords waiting for the link, decoded bytes waiting for my_read() */
+#define SALT_IO_FEC_WIRE_SIZE       (16 * SALT_IO_FEC_N)
+#define SALT_IO_FEC_READY_SIZE      (16 * SALT_IO_FEC_N)
+
+/*
+ * Bonding of several ports under salt_io, see salt_io_open_bond(). The bytes
+ * are cut into stripes of at most SALT_IO_BOND_STRIPE bytes with a sequence
+ * number, each stripe goes through one port (SALT_IO_BOND_ROUND_ROBIN in 
+ * turn, SALT_IO_BOND_QUEUE_DEPTH the port with the shortest output queue).
+ * The receiver puts them in order in a window of SALT_IO_BOND_WINDOW stripes.
+ */
+#define SALT_IO_BOND_MAX            4
+#define SALT_IO_BOND_STRIPE         256
+#define SALT_IO_BOND_WINDOW         64
+#define SALT_IO_BOND_ROUND_ROBIN    0
+#define SALT_IO_BOND_QUEUE_DEPTH    1
+
+/* Stripe on the wire: seq[2] size[2] data[size] */
+#define SALT_IO_BOND_HEADER_SIZE    4
+
+/* Stripes waiting for one port */
+#define SALT_IO_BOND_WIRE_SIZE      (8 * (SALT_IO_BOND_HEADER_SIZE + SALT_IO_BOND_STRIPE))
+
+/*
+ * io_uring engine (Linux), see salt_io_uring_init() and salt_io_start_uring().
+ * The reads and writes of the link and of the files go through one ring of
+ * SALT_IO_URING_ENTRIES submissions, the kernel waits for the link itself
+ * (older kernels get a poll linked before the read / write). At most SALT_IO_URING_FILE_OPS reads or
+ * writes of the files (SALT_IO_URING_FILE_CHUNK bytes each) are in flight, for at most
+ * SALT_IO_URING_FILE_OPS owners not returned by salt_io_uring_file_done().
+ */
+#define SALT_IO_URING_ENTRIES       64
+#define SALT_IO_URING_FILE_OPS      32
+#define SALT_IO_URING_FILE_CHUNK    65536
+
+/* Bytes of one read of the link, bytes waiting for one write of the link */
+#define SALT_IO_URING_RX_SIZE       4096
+#define SALT_IO_URING_WIRE_SIZE     16384
+
+struct salt_io_ctx_s;
+
+/*
+ * Operations of one transport. All of them get the context of the link,
+ * the return values follow the RS232_* functions.
+ */
+typedef struct salt_io_transport_s {
+    const char *name;
+
+    /* Writes the buffers in order, returns the bytes written, 0 if it would block, -1 on error */
+    int  (*send)(struct salt_io_ctx_s *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count);
+
+    /* Reads at most size bytes, returns the bytes read, 0 if nothing is there, -1 on error */
+    int  (*recv)(struct salt_io_ctx_s *p_ctx, uint8_t *p_buf, int size);
+
+    /* Waits for readiness (writable = 0 read, 1 write), returns 1, 0 on timeout, -1 on error */
+    int  (*wait)(struct salt_io_ctx_s *p_ctx, int writable, int timeout_ms);
+
+    /* Bytes waiting in the output / input queue, -1 if it is not known */
+    int  (*out_queue)(struct salt_io_ctx_s *p_ctx);
+    int  (*in_queue)(struct salt_io_ctx_s *p_ctx);
+
+    /* Blocks until the written bytes left the link */
+    int  (*drain)(struct salt_io_ctx_s *p_ctx);
+
+    void (*close)(struct salt_io_ctx_s *p_ctx);
+
+    /* Descriptor for poll() of an event loop, -1 if the link has none */
+    int  (*fd)(struct salt_io_ctx_s *p_ctx);
+} salt_io_transport_t;
+
+/*
+ * One direction of the shared-memory link. Lock free with one producer
+ * and one consumer, head and tail run freely and are masked by the size,
+ * they are accessed with the __atomic builtins of gcc.
+ */
+typedef struct salt_io_ring_s {
+    uint8_t     buffer[SALT_IO_RING_SIZE];
+    uint32_t    head;               /**< Written by the producer. */
+    uint32_t    tail;               /**< Written by the consumer. */
+    int         closed;             /**< Set by the end which closed the link. */
+} salt_io_ring_t;
+
+/* Both directions of the shared-memory link */
+typedef struct salt_io_shm_s {
+    salt_io_ring_t  ring_ab;
+    salt_io_ring_t  ring_ba;
+} salt_io_shm_t;
+
+/*
+ * I/O thread which owns the link of a context, see salt_io_start_thread().
+ * my_write() puts the frames into ring_tx and returns, the thread writes
+ * them to the link and puts the received bytes into ring_rx. The pipes 
+ * wake the other side when its ring got new bytes.
+ */
+typedef struct salt_io_thread_s {
+    salt_io_ring_t  ring_tx;            /**< Written by my_write(), sent by the thread. */
+    salt_io_ring_t  ring_rx;            /**< Received by the thread, read by my_read(). */
+    const struct salt_io_transport_s *p_link; /**< Transport of the link owned by the thread. */
+    int         wake_tx[2];             /**< Pipe, new bytes in ring_tx or the stop. */
+    int         wake_rx[2];             /**< Pipe, new bytes in ring_rx. */
+    int         stop;                   /**< Set by salt_io_close(), the thread sends the rest and ends. */
+    uint32_t    line_rate;              /**< Pacing of the thread, see salt_io_set_line(), accessed atomically. */
+    double      tx_tokens;              /**< Bytes which can be sent now. */
+    uint64_t    tx_refill_us;           /**< Time of the last refill in microseconds. */
+#if !defined(_WIN32)
+    pthread_t   thread;
+#endif
+} salt_io_thread_t;
+
+/*
+ * Decoder of the COBS frames (zero bytes stuffed out, a zero ends the 
+ * frame), see salt_io_cobs_decode(). Zeroed before the first byte.
+ */
+typedef struct salt_io_cobs_s {
+    uint32_t    len;                    /**< Bytes decoded into the frame. */
+    uint8_t     code;                   /**< Bytes left in the current block. */
+    uint8_t     zero;                   /**< 1 if the current block is followed by a zero. */
+    uint8_t     drop;                   /**< 1 if the frame is too long, skipped to the next zero. */
+} salt_io_cobs_t;
+
+/* One chunk of the ARQ in the window of the sender or of the receiver */
+typedef struct salt_io_arq_chunk_s {
+    uint8_t     data[SALT_IO_ARQ_CHUNK];
+    uint16_t    size;                   /**< Bytes in data. */
+    uint8_t     used;                   /**< Sender: not acknowledged yet, receiver: received. */
+    uint8_t     retries;                /**< Repetitions of the chunk. */
+    uint64_t    sent_us;                /**< Time of the last transmission. */
+    uint64_t    timer_us;               /**< Start of the timeout, the link sent the bytes before the chunk. */
+    uint64_t    first_us;               /**< Time of the first transmission, for SALT_IO_ARQ_DEAD_MS. */
+} salt_io_arq_chunk_t;
+
+/*
+ * Selective-repeat ARQ which owns the link of a context, see 
+ * salt_io_start_arq(). It runs in the calls of my_write() / my_read()
+ * (no thread), the sequence numbers run freely and wrap at 65536.
+ */
+typedef struct salt_io_arq_s {
+    const struct salt_io_transport_s *p_link; /**< Transport of the link owned by the ARQ. */
+
+    /* Sender */
+    salt_io_arq_chunk_t tx[SALT_IO_ARQ_WINDOW];
+    uint16_t    tx_base;                /**< Oldest chunk which was not acknowledged. */
+    uint16_t    tx_next;                /**< Sequence number of the next new chunk. */
+    double      srtt_us;                /**< Smoothed round trip, 0 = no sample yet. */
+    double      rttvar_us;              /**< Variation of the round trip. */
+    double      rto_us;                 /**< Retransmission timeout. */
+
+    /* Receiver */
+    salt_io_arq_chunk_t rx[SALT_IO_ARQ_WINDOW];
+    uint16_t    rx_next;                /**< Next chunk in order, acknowledged cumulatively. */
+    uint8_t     ready[SALT_IO_ARQ_WINDOW * SALT_IO_ARQ_CHUNK];
+    uint32_t    ready_begin;            /**< First byte in order not read by my_read(). */
+    uint32_t    ready_end;              /**< Behind the last byte in order. */
+    int         ack_pending;            /**< 1 if the peer waits for an acknowledgement. */
+    uint64_t    ack_us;                 /**< Time of the last acknowledgement. */
+    uint64_t    data_us;                /**< Time of the last received chunk, 0 = none yet. */
+    uint8_t     in_frame[SALT_IO_ARQ_FRAME_SIZE];
+    salt_io_cobs_t in_cobs;
+    int         readable;               /**< 1 if the last wait reported the link readable. */
+
+    /* Bytes for the link, sent by the next calls if it took only a part */
+    uint8_t     wire[SALT_IO_ARQ_WIRE_SIZE];
+    uint32_t    wire_len;
+
+    uint32_t    retransmits;            /**< Chunks sent again. */
+    uint32_t    damaged;                /**< Chunks dropped for a wrong CRC32C or size. */
+    int         failed;                 /**< 1 if the link failed or a chunk was not acknowledged in SALT_IO_ARQ_DEAD_MS. */
+} salt_io_arq_t;
+
+/*
+ * Reed-Solomon FEC which owns the link of a context, see salt_io_start_fec().
+ * It runs in the calls of my_write() / my_read() (no thread) like the ARQ.
+ */
+typedef struct salt_io_fec_s {
+    const struct salt_io_transport_s *p_link; /**< Transport of the link owned by the FEC. */
+    uint32_t    parity;                 /**< Parity bytes of a codeword, the code rate is (255 - parity) / 255. */
+
+    /* Products of each coefficient of the generator polynomial, the encoder needs no multiplication */
+    uint8_t     gen_mul[SALT_IO_FEC_PARITY_MAX][256];
+
+    /* Receiver */
+    uint8_t     in[SALT_IO_FEC_N];      /**< Codeword being received. */
+    uint32_t    in_len;
+    int         in_failed;              /**< 1 if the previous codeword could not be corrected. */
+    uint8_t     ready[SALT_IO_FEC_READY_SIZE];
+    uint32_t    ready_begin;            /**< First decoded byte not read by my_read(). */
+    uint32_t    ready_end;              /**< Behind the last decoded byte. */
+    int         readable;               /**< 1 if the last wait reported the link readable. */
+
+    /* Codewords for the link, sent by the next calls if it took only a part */
+    uint8_t     wire[SALT_IO_FEC_WIRE_SIZE];
+    uint32_t    wire_len;
+
+    uint32_t    corrected;              /**< Damaged bytes (symbols) corrected. */
+    uint32_t    uncorrectable;          /**< Codewords with more than parity / 2 damaged bytes, dropped. */
+    int         failed;                 /**< 1 if the link failed. */
+} salt_io_fec_t;
+
+/* One port of the bond, its context was opened by salt_io_open_port(), ... */
+typedef struct salt_io_bond_port_s {
+    struct salt_io_ctx_s *p_ctx;
+
+    /* Stripe being received, a whole stripe beyond the window waits here */
+    uint8_t     in[SALT_IO_BOND_HEADER_SIZE + SALT_IO_BOND_STRIPE];
+    uint32_t    in_len;
+    int         pending;                /**< 1 if in holds a whole stripe which does not fit into the window yet. */
+    uint16_t    last_seq;               /**< Last stripe received through the port. */
+    int         has_last;               /**< 1 if last_seq is valid. */
+    int         readable;               /**< 1 if the last wait reported the port readable. */
+    int         dead;                   /**< 1 after an error, a hangup or a damaged header. */
+
+    /* Stripes for the port, sent by the next calls if it took only a part */
+    uint8_t     wire[SALT_IO_BOND_WIRE_SIZE];
+    uint32_t    wire_len;
+} salt_io_bond_port_t;
+
+/* One stripe in the window of the receiver */
+typedef struct salt_io_bond_slot_s {
+    uint8_t     data[SALT_IO_BOND_STRIPE];
+    uint16_t    size;
+    uint8_t     used;
+} salt_io_bond_slot_t;
+
+/*
+ * Ports bonded into one link, see salt_io_open_bond(). It runs in the calls
+ * of my_write() / my_read() (no thread), the sequence numbers wrap at 65536.
+ */
+typedef struct salt_io_bond_s {
+    salt_io_bond_port_t ports[SALT_IO_BOND_MAX];
+    int         count;                  /**< Bonded ports. */
+    int         alive;                  /**< Ports which did not fail. */
+    int         mode;                   /**< SALT_IO_BOND_ROUND_ROBIN or SALT_IO_BOND_QUEUE_DEPTH. */
+    int         next;                   /**< Port of the next stripe (round robin, ties of the queue depth). */
+    uint16_t    tx_seq;                 /**< Sequence number of the next stripe. */
+
+    /* Receiver */
+    salt_io_bond_slot_t rx[SALT_IO_BOND_WINDOW];
+    uint16_t    rx_next;                /**< Next stripe in order. */
+    uint8_t     ready[SALT_IO_BOND_WINDOW * SALT_IO_BOND_STRIPE];
+    uint32_t    ready_begin;            /**< First byte in order not read by my_read(). */
+    uint32_t    ready_end;              /**< Behind the last byte in order. */
+
+    uint32_t    lost;                   /**< Stripes skipped, they went through a failed port. */
+} salt_io_bond_t;
+
+/* One read or write of a file in flight */
+typedef struct salt_io_uring_op_s {
+    uint8_t     *p_data;                /**< Rest of the buffer, a short transfer continues there. */
+    uint32_t    size;
+    uint64_t    offset;
+    int         owner;                  /**< Entry of owners, -1 without an owner. */
+    int         fd;
+    uint8_t     used;
+    uint8_t     write;                  /**< 1 for a write, 0 for a read. */
+} salt_io_uring_op_t;
+
+/*
+ * Owner of the reads / writes of the files. It is returned by
+ * salt_io_uring_file_done() when none of its operations is in flight
+ * and its submitting is finished (open 0).
+ */
+typedef struct salt_io_uring_owner_s {
+    void        *p_owner;               /**< NULL for a free entry. */
+    uint32_t    busy;                   /**< Its operations in flight. */
+    uint8_t     open;                   /**< 1 while more operations may be submitted. */
+} salt_io_uring_owner_t;
+
+/*
+ * io_uring of one transfer, see salt_io_uring_init(). It runs in the calls
+ * of my_write() / my_read() and of the file functions (no thread), one
+ * io_uring_enter() submits everything queued and reaps the completions.
+ * The mapped rings are kept as void pointers, the header does not need
+ * <linux/io_uring.h>.
+ */
+typedef struct salt_io_uring_s {
+    int         ring_fd;                /**< -1 if the ring is not created. */
+    void        *p_sq_map;
+    void        *p_cq_map;
+    void        *p_sqes;
+    uint32_t    sq_map_size;
+    uint32_t    cq_map_size;
+    uint32_t    sqes_size;
+    uint32_t    *p_sq_head;
+    uint32_t    *p_sq_tail;
+    uint32_t    *p_sq_mask;
+    uint32_t    *p_sq_array;
+    uint32_t    *p_cq_head;
+    uint32_t    *p_cq_tail;
+    uint32_t    *p_cq_mask;
+    void        *p_cqes;
+    uint32_t    sq_queued;              /**< Submissions not passed to the kernel yet. */
+    int         fast_poll;              /**< 1 if the kernel polls the link itself (IORING_FEAT_FAST_POLL). */
+    int64_t     timeout[2];             /**< Timeout of the wait (struct __kernel_timespec). */
+
+    /* Link owned by the ring, see salt_io_start_uring() */
+    const struct salt_io_transport_s *p_link;
+    int         link_fd;
+    int         link_flags;             /**< Status flags of the descriptor, restored by salt_io_close(). */
+    int         link_batching;          /**< read_batching of the context, restored by salt_io_close(). */
+    uint8_t     rx[SALT_IO_URING_RX_SIZE];
+    uint32_t    rx_begin;               /**< First byte not read by my_read(). */
+    uint32_t    rx_end;                 /**< Behind the last received byte. */
+    int         rx_busy;                /**< 1 if the read of the link is in flight. */
+    uint8_t     wire[SALT_IO_URING_WIRE_SIZE];
+    uint32_t    wire_len;               /**< Bytes for the link, new bytes are appended behind. */
+    uint32_t    wire_busy;              /**< Bytes of the write in flight at the start of wire. */
+    int         failed;                 /**< 1 if the link failed. */
+
+    /* Files */
+    salt_io_uring_op_t ops[SALT_IO_URING_FILE_OPS];
+    uint32_t    reads_busy;
+    uint32_t    writes_busy;
+    salt_io_uring_owner_t owners[SALT_IO_URING_FILE_OPS];
+    int         file_failed;            /**< 1 if a read or a write of a file failed. */
+
+    uint32_t    calls;                  /**< io_uring_enter() calls. */
+    uint32_t    completions;            /**< Completions reaped. */
+} salt_io_uring_t;
+
+/* Encodes size bytes with COBS and the zero delimiter into p_dst (size + size / 254 + 2), returns the length */
+uint32_t salt_io_cobs_encode(const uint8_t *p_src, uint32_t size, uint8_t *p_dst);
+
+/*
+ * Decodes one received byte into p_frame of max_size bytes. Returns 1 if
+ * the zero ended a frame of p_cobs->len bytes, -1 if it ended a frame 
+ * which was too long, 0 otherwise. The caller sets p_cobs->len to 0 
+ * after it used the frame, before the next byte.
+ */
+int salt_io_cobs_decode(salt_io_cobs_t *p_cobs, uint8_t *p_frame, uint32_t max_size, uint8_t byte);
+
+/* CRC32C (Castagnoli) of size bytes continuing crc, 0 for the first part */
+uint32_t salt_io_crc32c(uint32_t crc, const uint8_t *p_data, uint32_t size);
+
+/* RS-232 port or pseudo terminal, the rs232 library */
+extern const salt_io_transport_t salt_io_serial_transport;
+
+/* Connected AF_UNIX or TCP socket */
+extern const salt_io_transport_t salt_io_socket_transport;
+
+/* Shared-memory ring between two threads of one process */
+extern const salt_io_transport_t salt_io_shm_transport;
+
+/* io_uring which owns one of the links with a descriptor above */
+extern const salt_io_transport_t salt_io_uring_transport;
+
+/* Rings of the I/O thread which owns one of the links above */
+extern const salt_io_transport_t salt_io_thread_transport;
+
+/* Several ports of the links above bonded into one link */
+extern const salt_io_transport_t salt_io_bond_transport;
+
+/* Reed-Solomon FEC which owns one of the links above */
+extern const salt_io_transport_t salt_io_fec_transport;
+
+/* Selective-repeat ARQ which owns one of the links above */
+extern const salt_io_transport_t salt_io_arq_transport;
+
+#endif /* SALT_IO_TRANSPORT_H */
@@ -0,0 +1,78 @@
+/*
+ * LZ compression of the sent blocks
+ *
+ * A small codec of the LZ77 family in the format of the LZ4 blocks:
+ * sequences of token[1] literals[n] offset[2] with the lengths over 15
+ * continued by bytes of 255. Every block is compressed alone, the
+ * receiver decodes it without the previous blocks (a resumed transfer
+ * starts anywhere) and without more memory than the block.
+ *
+ * Windows/Linux
+ *
+ * KEMT FEI TUKE, Diploma thesis
+ */
+
+#ifndef SALT_LZ_H
+#define SALT_LZ_H
+
+#include <stdint.h>
+
+/* Positions of the last 4-byte sequences, 2^SALT_LZ_HASH_LOG of them */
+#define SALT_LZ_HASH_LOG            12
+
+/* Shortest match, the matches are at most 65535 bytes back */
+#define SALT_LZ_MIN_MATCH           4
+#define SALT_LZ_MAX_OFFSET          65535
+
+/* The last 5 bytes are literals, the last match starts 12 bytes before the end */
+#define SALT_LZ_LAST_LITERALS       5
+#define SALT_LZ_MATCH_LIMIT         12
+
+/* Bytes of the block counted by salt_lz_entropy() */
+#define SALT_LZ_SAMPLE              1024
+
+/* State of the compressor, the table is cleared for each block */
+typedef struct salt_lz_s
+{
+    uint32_t    table[1 << SALT_LZ_HASH_LOG];
+} salt_lz_t;
+
+/*
+ * Compresses the block into p_dst.
+ *
+ * @par capacity:       size of p_dst, a block which does not compress
+ *                      below it is not compressed
+ *
+ * @return  size of the compressed block, 0 if it does not fit
+ */
+uint32_t salt_lz_compress(salt_lz_t *p_lz,
+                          const uint8_t *p_src,
+                          uint32_t size,
+                          uint8_t *p_dst,
+                          uint32_t capacity);
+
+/*
+ * Decompresses the block, every length and offset is checked against
+ * the input and the output.
+ *
+ * @par capacity:       size of p_dst
+ * @par p_size:         size of the decompressed block
+ *
+ * @return 0 in case success, -1 if the block is damaged or too large
+ */
+int salt_lz_decompress(const uint8_t *p_src,
+                       uint32_t size,
+                       uint8_t *p_dst,
+                       uint32_t capacity,
+                       uint32_t *p_size);
+
+/*
+ * Cheap estimate of the compressibility: entropy of the bytes of
+ * a sample of the block (SALT_LZ_SAMPLE bytes spread over it).
+ * Text has 4 - 6 bits per byte, compressed or encrypted data almost 8.
+ *
+ * @return  bits per byte
+ */
+double salt_lz_entropy(const uint8_t *p_data, uint32_t size);
+
+#endif
@@ -29,20 +29,22 @@
 /* For more info and how to use this library, visit: http://www.teuniz.net/RS-232/ */
 
 
+#if defined(__linux__)
+#define _GNU_SOURCE   /* posix_openpt(), ptsname() */
+#endif
+
 #include "rs232.h"
 
+#if defined(__linux__)
+#include <linux/serial.h>   /* TIOCGICOUNT */
+#endif
+
 
 #if defined(__linux__) || defined(__FreeBSD__)   /* Linux & FreeBSD */
 
 #define RS232_PORTNR  38
 
 
-int Cport[RS232_PORTNR],
-    error;
-
-struct termios new_port_settings,
-       old_port_settings[RS232_PORTNR];
-
 const char *comports[RS232_PORTNR]={"/dev/ttyS0","/dev/ttyS1","/dev/ttyS2","/dev/ttyS3","/dev/ttyS4","/dev/ttyS5",
                                     "/dev/ttyS6","/dev/ttyS7","/dev/ttyS8","/dev/ttyS9","/dev/ttyS10","/dev/ttyS11",
                                     "/dev/ttyS12","/dev/ttyS13","/dev/ttyS14","/dev/ttyS15","/dev/ttyUSB0",
@@ -52,84 +54,148 @@ const char *comports[RS232_PORTNR]={"/dev/ttyS0","/dev/ttyS1","/dev/ttyS2","/dev
                                     "/dev/cuau0","/dev/cuau1","/dev/cuau2","/dev/cuau3",
                                     "/dev/cuaU0","/dev/cuaU1","/dev/cuaU2","/dev/cuaU3"};
 
-int RS232_OpenComport(int comport_number, int baudrate, const char *mode, int flowctrl)
+/*
+termios2 of the kernel, asm/termbits.h can not be included together with
+termios.h: with BOTHER in c_cflag the baudrate is any number in c_ospeed,
+the driver sets the nearest rate its divisor can do
+*/
+#if defined(__linux__) && defined(TCGETS2)
+
+#define RS232_TERMIOS2
+
+struct termios2
+{
+  tcflag_t c_iflag;
+  tcflag_t c_oflag;
+  tcflag_t c_cflag;
+  tcflag_t c_lflag;
+  cc_t c_line;
+  cc_t c_cc[19];
+  speed_t c_ispeed;
+  speed_t c_ospeed;
+};
+
+#ifndef BOTHER
+#define BOTHER  0010000
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT  16
+#endif
+
+/* the rate set by the driver may differ by 2 %, the tolerance of a UART */
+#define RS232_BAUD_TOLERANCE  50
+
+#endif
+
+/* the Bxxxx constant of the baudrate, -1 if there is none */
+static int rs232_baud_constant(int baudrate)
+{
+  switch(baudrate)
+  {
+    case      50 : return(B50);
+    case      75 : return(B75);
+    case     110 : return(B110);
+    case     134 : return(B134);
+    case     150 : return(B150);
+    case     200 : return(B200);
+    case     300 : return(B300);
+    case     600 : return(B600);
+    case    1200 : return(B1200);
+    case    1800 : return(B1800);
+    case    2400 : return(B2400);
+    case    4800 : return(B4800);
+    case    9600 : return(B9600);
+    case   19200 : return(B19200);
+    case   38400 : return(B38400);
+    case   57600 : return(B57600);
+    case  115200 : return(B115200);
+    case  230400 : return(B230400);
+    case  460800 : return(B460800);
+#if defined(__linux__)
+    case  500000 : return(B500000);
+    case  576000 : return(B576000);
+    case  921600 : return(B921600);
+    case 1000000 : return(B1000000);
+    case 1152000 : return(B1152000);
+    case 1500000 : return(B1500000);
+    case 2000000 : return(B2000000);
+    case 2500000 : return(B2500000);
+    case 3000000 : return(B3000000);
+    case 3500000 : return(B3500000);
+    case 4000000 : return(B4000000);
+#endif
+    default      : return(-1);
+  }
+}
+
+
+#if defined(RS232_TERMIOS2)
+/* any baudrate by termios2, request is TCSETS2 or TCSETSW2 (after the output drained) */
+static int rs232_set_custom_baudrate(int fd, int baudrate, unsigned long request)
+{
+  struct termios2 settings;
+
+  if(ioctl(fd, TCGETS2, &settings) == -1)
+  {
+    perror("unable to read portsettings ");
+    return(1);
+  }
+
+  settings.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+  settings.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+  settings.c_ispeed = baudrate;
+  settings.c_ospeed = baudrate;
+
+  if(ioctl(fd, request, &settings) == -1)
+  {
+    perror("unable to adjust portsettings ");
+    return(1);
+  }
+
+  if(ioctl(fd, TCGETS2, &settings) == -1)
+  {
+    perror("unable to read portsettings ");
+    return(1);
+  }
+
+  if(abs((int)settings.c_ospeed - baudrate) > baudrate / RS232_BAUD_TOLERANCE)
+  {
+    printf("baudrate %d is not supported by the port (%u)\n", baudrate, (unsigned)settings.c_ospeed);
+    return(1);
+  }
+
+  return(0);
+}
+#endif
+
+
+int RS232_PortOpen(rs232_port_t *port, const char *devname, int baudrate, const char *mode, int flowctrl)
 {
   int baudr,
-      status;
+      status,
+      error;
 
-  if((comport_number>=RS232_PORTNR)||(comport_number<0))
+  struct termios new_port_settings;
+
+  port->fd = -1;
+  port->pty_slave = -1;
+
+  if(strlen(devname) >= RS232_NAME_SIZE)
   {
-    printf("illegal comport number\n");
+    printf("too long device name \"%s\"\n", devname);
     return(1);
   }
+  strcpy(port->name, devname);
 
-  switch(baudrate)
+  baudr = rs232_baud_constant(baudrate);
+  if(baudr == -1)
   {
-    case      50 : baudr = B50;
-                   break;
-    case      75 : baudr = B75;
-                   break;
-    case     110 : baudr = B110;
-                   break;
-    case     134 : baudr = B134;
-                   break;
-    case     150 : baudr = B150;
-                   break;
-    case     200 : baudr = B200;
-                   break;
-    case     300 : baudr = B300;
-                   break;
-    case     600 : baudr = B600;
-                   break;
-    case    1200 : baudr = B1200;
-                   break;
-    case    1800 : baudr = B1800;
-                   break;
-    case    2400 : baudr = B2400;
-                   break;
-    case    4800 : baudr = B4800;
-                   break;
-    case    9600 : baudr = B9600;
-                   break;
-    case   19200 : baudr = B19200;
-                   break;
-    case   38400 : baudr = B38400;
-                   break;
-    case   57600 : baudr = B57600;
-                   break;
-    case  115200 : baudr = B115200;
-                   break;
-    case  230400 : baudr = B230400;
-                   break;
-    case  460800 : baudr = B460800;
-                   break;
-#if defined(__linux__)
-    case  500000 : baudr = B500000;
-                   break;
-    case  576000 : baudr = B576000;
-                   break;
-    case  921600 : baudr = B921600;
-                   break;
-    case 1000000 : baudr = B1000000;
-                   break;
-    case 1152000 : baudr = B1152000;
-                   break;
-    case 1500000 : baudr = B1500000;
-                   break;
-    case 2000000 : baudr = B2000000;
-                   break;
-    case 2500000 : baudr = B2500000;
-                   break;
-    case 3000000 : baudr = B3000000;
-                   break;
-    case 3500000 : baudr = B3500000;
-                   break;
-    case 4000000 : baudr = B4000000;
-                   break;
+#if defined(RS232_TERMIOS2)
+    baudr = B38400;  /* replaced by the exact rate after tcsetattr() */
+#else
+    printf("invalid baudrate\n");
+    return(1);
 #endif
-    default      : printf("invalid baudrate\n");
-                   return(1);
-                   break;
   }
 
   int cbits=CS8,
@@ -194,26 +260,28 @@ http://pubs.opengroup.org/onlinepubs/7908799/xsh/termios.h.html
 http://man7.org/linux/man-pages/man3/termios.3.html
 */
 
-  Cport[comport_number] = open(comports[comport_number], O_RDWR | O_NOCTTY | O_NDELAY);
-  if(Cport[comport_number]==-1)
+  port->fd = open(port->name, O_RDWR | O_NOCTTY | O_NDELAY);
+  if(port->fd==-1)
   {
     perror("unable to open comport ");
     return(1);
   }
 
   /* lock access so that another process can't also use the port */
-  if(flock(Cport[comport_number], LOCK_EX | LOCK_NB) != 0)
+  if(flock(port->fd, LOCK_EX | LOCK_NB) != 0)
   {
-    close(Cport[comport_number]);
+    close(port->fd);
+    port->fd = -1;
     perror("Another process has locked the comport.");
     return(1);
   }
 
-  error = tcgetattr(Cport[comport_number], old_port_settings + comport_number);
+  error = tcgetattr(port->fd, &port->old_settings);
   if(error==-1)
   {
-    close(Cport[comport_number]);
-    flock(Cport[comport_number], LOCK_UN);  /* free the port so that others can use it. */
+    flock(port->fd, LOCK_UN);  /* free the port so that others can use it. */
+    close(port->fd);
+    port->fd = -1;
     perror("unable to read portsettings ");
     return(1);
   }
@@ -233,22 +301,41 @@ http://man7.org/linux/man-pages/man3/termios.3.html
   cfsetispeed(&new_port_settings, baudr);
   cfsetospeed(&new_port_settings, baudr);
 
-  error = tcsetattr(Cport[comport_number], TCSANOW, &new_port_settings);
+  error = tcsetattr(port->fd, TCSANOW, &new_port_settings);
   if(error==-1)
   {
-    tcsetattr(Cport[comport_number], TCSANOW, old_port_settings + comport_number);
-    close(Cport[comport_number]);
-    flock(Cport[comport_number], LOCK_UN);  /* free the port so that others can use it. */
+    tcsetattr(port->fd, TCSANOW, &port->old_settings);
+    flock(port->fd, LOCK_UN);  /* free the port so that others can use it. */
+    close(port->fd);
+    port->fd = -1;
     perror("unable to adjust portsettings ");
     return(1);
   }
 
+#if defined(RS232_TERMIOS2)
+  if((rs232_baud_constant(baudrate) == -1) && rs232_set_custom_baudrate(port->fd, baudrate, TCSETS2))
+  {
+    tcsetattr(port->fd, TCSANOW, &port->old_settings);
+    flock(port->fd, LOCK_UN);  /* free the port so that others can use it. */
+    close(port->fd);
+    port->fd = -1;
+    return(1);
+  }
+#endif
+
 /* http://man7.org/linux/man-pages/man4/tty_ioctl.4.html */
 
-  if(ioctl(Cport[comport_number], TIOCMGET, &status) == -1)
+  if(ioctl(port->fd, TIOCMGET, &status) == -1)
   {
-    tcsetattr(Cport[comport_number], TCSANOW, old_port_settings + comport_number);
-    flock(Cport[comport_number], LOCK_UN);  /* free the port so that others can use it. */
+    if((errno == ENOTTY) || (errno == EINVAL))
+    {
+      return(0);  /* no modem control lines, e.g. a pseudo terminal */
+    }
+
+    tcsetattr(port->fd, TCSANOW, &port->old_settings);
+    flock(port->fd, LOCK_UN);  /* free the port so that others can use it. */
+    close(port->fd);
+    port->fd = -1;
     perror("unable to get portstatus");
     return(1);
   }
@@ -256,10 +343,12 @@ http://man7.org/linux/man-pages/man3/termios.3.html
   status |= TIOCM_DTR;    /* turn on DTR */
   status |= TIOCM_RTS;    /* turn on RTS */
 
-  if(ioctl(Cport[comport_number], TIOCMSET, &status) == -1)
+  if(ioctl(port->fd, TIOCMSET, &status) == -1)
   {
-    tcsetattr(Cport[comport_number], TCSANOW, old_port_settings + comport_number);
-    flock(Cport[comport_number], LOCK_UN);  /* free the port so that others can use it. */
+    tcsetattr(port->fd, TCSANOW, &port->old_settings);
+    flock(port->fd, LOCK_UN);  /* free the port so that others can use it. */
+    close(port->fd);
+    port->fd = -1;
     perror("unable to set portstatus");
     return(1);
   }
@@ -268,11 +357,11 @@ http://man7.org/linux/man-pages/man3/termios.3.html
 }
 
 
-int RS232_PollComport(int comport_number, unsigned char *buf, int size)
+int RS232_PortPoll(rs232_port_t *port, unsigned char *buf, int size)
 {
   int n;
 
-  n = read(Cport[comport_number], buf, size);
+  n = read(port->fd, buf, size);
 
   if(n < 0)
   {
@@ -283,215 +372,554 @@ int RS232_PollComport(int comport_number, unsigned char *buf, int size)
 }
 
 
-int RS232_SendByte(int comport_number, unsigned char byte)
+static int RS232_PortWaitEvents(rs232_port_t *port, short events, int timeout_ms)
 {
-  int n = write(Cport[comport_number], &byte, 1);
+  int n;
+
+  struct pollfd pfd;
+
+  pfd.fd = port->fd;
+  pfd.events = events;
+  pfd.revents = 0;
+
+  n = poll(&pfd, 1, timeout_ms);
   if(n < 0)
   {
-    if(errno == EAGAIN)
-    {
-      return 0;
-    }
-    else
-    {
-      return 1;
-    }
+    if(errno == EINTR)  return 0;
+
+    return -1;
   }
 
-  return(0);
+  if(n == 0)  return 0;
+
+  if(pfd.revents & (POLLERR | POLLNVAL))  return -1;
+
+  return 1;
 }
 
 
-int RS232_SendBuf(int comport_number, unsigned char *buf, int size)
+/* blocks until the port is readable or timeout_ms expires (-1 waits forever) */
+/* returns 1 when readable, 0 on timeout, -1 in case of an error */
+int RS232_PortWait(rs232_port_t *port, int timeout_ms)
 {
-  int n = write(Cport[comport_number], buf, size);
-  if(n < 0)
-  {
-    if(errno == EAGAIN)
-    {
-      return 0;
-    }
-    else
-    {
-      return -1;
-    }
-  }
+  return RS232_PortWaitEvents(port, POLLIN, timeout_ms);
+}
 
-  return(n);
+
+/* same as RS232_PortWait() but waits for free space in the output queue */
+int RS232_PortWaitWritable(rs232_port_t *port, int timeout_ms)
+{
+  return RS232_PortWaitEvents(port, POLLOUT, timeout_ms);
 }
 
 
-void RS232_CloseComport(int comport_number)
+/* returns the number of bytes waiting in the output queue, -1 if it is not known */
+int RS232_PortGetOutQueue(rs232_port_t *port)
 {
-  int status;
+  int n;
 
-  if(ioctl(Cport[comport_number], TIOCMGET, &status) == -1)
+  /* the output of a pseudo terminal waits in the input queue of its slave */
+  if(port->pty_slave >= 0)
   {
-    perror("unable to get portstatus");
-  }
+    if(ioctl(port->pty_slave, FIONREAD, &n) == -1)
+    {
+      return -1;
+    }
 
-  status &= ~TIOCM_DTR;    /* turn off DTR */
-  status &= ~TIOCM_RTS;    /* turn off RTS */
+    return(n);
+  }
 
-  if(ioctl(Cport[comport_number], TIOCMSET, &status) == -1)
+  if(ioctl(port->fd, TIOCOUTQ, &n) == -1)
   {
-    perror("unable to set portstatus");
+    return -1;
   }
 
-  tcsetattr(Cport[comport_number], TCSANOW, old_port_settings + comport_number);
-  close(Cport[comport_number]);
-
-  flock(Cport[comport_number], LOCK_UN);  /* free the port so that others can use it. */
+  return(n);
 }
 
-/*
-Constant  Description
-TIOCM_LE        DSR (data set ready/line enable)
-TIOCM_DTR       DTR (data terminal ready)
-TIOCM_RTS       RTS (request to send)
-TIOCM_ST        Secondary TXD (transmit)
-TIOCM_SR        Secondary RXD (receive)
-TIOCM_CTS       CTS (clear to send)
-TIOCM_CAR       DCD (data carrier detect)
-TIOCM_CD        see TIOCM_CAR
-TIOCM_RNG       RNG (ring)
-TIOCM_RI        see TIOCM_RNG
-TIOCM_DSR       DSR (data set ready)
-
-http://man7.org/linux/man-pages/man4/tty_ioctl.4.html
-*/
 
-int RS232_IsDCDEnabled(int comport_number)
+/* returns the number of received bytes waiting in the input queue, -1 if it is not known */
+int RS232_PortGetInQueue(rs232_port_t *port)
 {
-  int status;
+  int n;
 
-  ioctl(Cport[comport_number], TIOCMGET, &status);
+  if(ioctl(port->fd, FIONREAD, &n) == -1)
+  {
+    return -1;
+  }
 
-  if(status&TIOCM_CAR) return(1);
-  else return(0);
+  return(n);
 }
 
 
-int RS232_IsRINGEnabled(int comport_number)
+/* blocks until all bytes in the output queue have been transmitted */
+int RS232_PortDrain(rs232_port_t *port)
 {
-  int status;
-
-  ioctl(Cport[comport_number], TIOCMGET, &status);
-
-  if(status&TIOCM_RNG) return(1);
-  else return(0);
-}
+  int n,
+      last = -1,
+      stalled = 0;
 
+/*
+tcdrain() returns immediately on a pseudo terminal, wait until the peer
+has read everything (closing the master would discard the rest) or has
+not read anything for a second. The written bytes reach the input queue
+of the slave a moment later (flip buffer), it must stay empty for 10 ms
+*/
+  if(port->pty_slave >= 0)
+  {
+    while(((n = RS232_PortGetOutQueue(port)) >= 0) && (stalled < 1000) && 
+          ((n > 0) || (last != 0) || (stalled < 10)))
+    {
+      stalled = (n == last) ? stalled + 1 : 0;
+      last = n;
+      usleep(1000);
+    }
 
-int RS232_IsCTSEnabled(int comport_number)
-{
-  int status;
+    return((n < 0) ? -1 : 0);
+  }
 
-  ioctl(Cport[comport_number], TIOCMGET, &status);
+  if(tcdrain(port->fd) == -1)
+  {
+    return -1;
+  }
 
-  if(status&TIOCM_CTS) return(1);
-  else return(0);
+  return(0);
 }
 
 
-int RS232_IsDSREnabled(int comport_number)
+/*
+changes the baudrate of the opened port, the other settings are kept,
+the characters which are being sent leave the port with the old rate,
+a rate without a Bxxxx constant is set by termios2 (e.g. 1843200)
+*/
+int RS232_PortSetBaudrate(rs232_port_t *port, int baudrate)
 {
-  int status;
-
-  ioctl(Cport[comport_number], TIOCMGET, &status);
-
-  if(status&TIOCM_DSR) return(1);
-  else return(0);
-}
+  int baudr;
 
+  struct termios settings;
 
-void RS232_enableDTR(int comport_number)
-{
-  int status;
+  baudr = rs232_baud_constant(baudrate);
+  if(baudr == -1)
+  {
+#if defined(RS232_TERMIOS2)
+    return rs232_set_custom_baudrate(port->fd, baudrate, TCSETSW2);
+#else
+    printf("invalid baudrate\n");
+    return(1);
+#endif
+  }
 
-  if(ioctl(Cport[comport_number], TIOCMGET, &status) == -1)
+  if(tcgetattr(port->fd, &settings) == -1)
   {
-    perror("unable to get portstatus");
+    perror("unable to read portsettings ");
+    return(1);
   }
 
-  status |= TIOCM_DTR;    /* turn on DTR */
+  cfsetispeed(&settings, baudr);
+  cfsetospeed(&settings, baudr);
 
-  if(ioctl(Cport[comport_number], TIOCMSET, &status) == -1)
+  if(tcsetattr(port->fd, TCSADRAIN, &settings) == -1)
   {
-    perror("unable to set portstatus");
+    perror("unable to adjust portsettings ");
+    return(1);
   }
+
+  return(0);
 }
 
 
-void RS232_disableDTR(int comport_number)
+/* returns the baudrate set by the driver, -1 if it is not known */
+int RS232_PortGetBaudrate(rs232_port_t *port)
 {
-  int status;
+#if defined(RS232_TERMIOS2)
+  struct termios2 settings;
 
-  if(ioctl(Cport[comport_number], TIOCMGET, &status) == -1)
+  if(ioctl(port->fd, TCGETS2, &settings) == -1)
   {
-    perror("unable to get portstatus");
+    return -1;
   }
 
-  status &= ~TIOCM_DTR;    /* turn off DTR */
+  return((int)settings.c_ospeed);
+#else
+  (void)port;
 
-  if(ioctl(Cport[comport_number], TIOCMSET, &status) == -1)
-  {
-    perror("unable to set portstatus");
-  }
+  return -1;
+#endif
 }
 
 
-void RS232_enableRTS(int comport_number)
+/*
+kernel side batching of the reads, see VMIN and VTIME in termios(3):
+a read blocks until min(vmin, size) bytes are received or vtime * 100 mSec.
+passed since the last received byte, vmin = 0 makes the reads non-blocking again
+*/
+int RS232_PortSetReadBatching(rs232_port_t *port, int vmin, int vtime)
 {
-  int status;
+  int flags;
+
+  struct termios settings;
 
-  if(ioctl(Cport[comport_number], TIOCMGET, &status) == -1)
+  if((vmin < 0) || (vmin > 255) || (vtime < 0) || (vtime > 255))
   {
-    perror("unable to get portstatus");
+    printf("invalid read batching %d / %d\n", vmin, vtime);
+    return(1);
   }
 
-  status |= TIOCM_RTS;    /* turn on RTS */
-
-  if(ioctl(Cport[comport_number], TIOCMSET, &status) == -1)
+  if(tcgetattr(port->fd, &settings) == -1)
   {
-    perror("unable to set portstatus");
+    perror("unable to read portsettings ");
+    return(1);
   }
-}
 
+  settings.c_cc[VMIN] = vmin;
+  settings.c_cc[VTIME] = vtime;
 
-void RS232_disableRTS(int comport_number)
-{
-  int status;
+  if(tcsetattr(port->fd, TCSANOW, &settings) == -1)
+  {
+    perror("unable to adjust portsettings ");
+    return(1);
+  }
 
-  if(ioctl(Cport[comport_number], TIOCMGET, &status) == -1)
+  /* O_NDELAY would return from read() immediately, no matter what VMIN is */
+  flags = fcntl(port->fd, F_GETFL);
+  if(flags == -1)
   {
-    perror("unable to get portstatus");
+    perror("unable to read port flags ");
+    return(1);
   }
 
-  status &= ~TIOCM_RTS;    /* turn off RTS */
+  if(vmin > 0)  flags &= ~O_NDELAY;
+  else  flags |= O_NDELAY;
 
-  if(ioctl(Cport[comport_number], TIOCMSET, &status) == -1)
+  if(fcntl(port->fd, F_SETFL, flags) == -1)
   {
-    perror("unable to set portstatus");
+    perror("unable to adjust port flags ");
+    return(1);
   }
-}
 
+  return(0);
+}
 
-void RS232_flushRX(int comport_number)
+
+int RS232_PortSendByte(rs232_port_t *port, unsigned char byte)
 {
-  tcflush(Cport[comport_number], TCIFLUSH);
+  int n = write(port->fd, &byte, 1);
+  if(n < 0)
+  {
+    if(errno == EAGAIN)
+    {
+      return 0;
+    }
+    else
+    {
+      return 1;
+    }
+  }
+
+  return(0);
 }
 
 
-void RS232_flushTX(int comport_number)
+int RS232_PortSendBuf(rs232_port_t *port, unsigned char *buf, int size)
 {
-  tcflush(Cport[comport_number], TCOFLUSH);
+  int n = write(port->fd, buf, size);
+  if(n < 0)
+  {
+    if(errno == EAGAIN)
+    {
+      return 0;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  return(n);
 }
 
 
-void RS232_flushRXTX(int comport_number)
+/*
+sends count buffers with one write (writev), the bytes leave the port
+in the same order as the buffers, at most RS232_MAX_IOV buffers
+*/
+int RS232_PortSendBufv(rs232_port_t *port, unsigned char **bufs, const int *sizes, int count)
+{
+  int i, n;
+
+  struct iovec iov[RS232_MAX_IOV];
+
+  if((count < 1) || (count > RS232_MAX_IOV))
+  {
+    return -1;
+  }
+
+  for(i=0; i<count; i++)
+  {
+    iov[i].iov_base = bufs[i];
+    iov[i].iov_len = sizes[i];
+  }
+
+  n = writev(port->fd, iov, count);
+  if(n < 0)
+  {
+    if(errno == EAGAIN)
+    {
+      return 0;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  return(n);
+}
+
+
+void RS232_PortClose(rs232_port_t *port)
+{
+  int status;
+
+  if(port->fd < 0)  return;
+
+  if(ioctl(port->fd, TIOCMGET, &status) == -1)
+  {
+    if((errno != ENOTTY) && (errno != EINVAL))
+    {
+      perror("unable to get portstatus");
+    }
+  }
+  else
+  {
+    status &= ~TIOCM_DTR;    /* turn off DTR */
+    status &= ~TIOCM_RTS;    /* turn off RTS */
+
+    if(ioctl(port->fd, TIOCMSET, &status) == -1)
+    {
+      perror("unable to set portstatus");
+    }
+  }
+
+  tcsetattr(port->fd, TCSANOW, &port->old_settings);
+
+  flock(port->fd, LOCK_UN);  /* free the port so that others can use it. */
+  close(port->fd);
+  port->fd = -1;
+
+  if(port->pty_slave >= 0)
+  {
+    close(port->pty_slave);
+    port->pty_slave = -1;
+  }
+}
+
+
+/*
+creates a pseudo terminal, the master side becomes the port, the slave
+side (e.g. /dev/pts/3, returned in slave_name) behaves as the other end
+of a null-modem cable and is opened by the peer with RS232_PortOpen()
+*/
+int RS232_PortOpenPty(rs232_port_t *port, int baudrate, const char *mode, int flowctrl, char *slave_name, int size)
+{
+  int master;
+
+  const char *name;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY | O_NDELAY);
+  if(master == -1)
+  {
+    perror("unable to open pseudo terminal ");
+    return(1);
+  }
+
+  if((grantpt(master) == -1) || (unlockpt(master) == -1) || ((name = ptsname(master)) == NULL))
+  {
+    close(master);
+    perror("unable to unlock pseudo terminal ");
+    return(1);
+  }
+
+  if((int)strlen(name) >= size)
+  {
+    close(master);
+    printf("buffer for the name of pseudo terminal is too small\n");
+    return(1);
+  }
+  strcpy(slave_name, name);
+
+/*
+the termios of a pseudo terminal belong to its slave side, the slave is
+configured as a normal port and kept open, otherwise the master gets EIO
+until the peer opens it
+*/
+  if(RS232_PortOpen(port, slave_name, baudrate, mode, flowctrl))
+  {
+    close(master);
+    return(1);
+  }
+
+  flock(port->fd, LOCK_UN);  /* the peer locks the slave */
+
+  port->pty_slave = port->fd;
+  port->fd = master;
+
+  return(0);
+}
+
+
+/*
+error counters of the UART driver since the port was opened (TIOCGICOUNT),
+returns 1 if the driver has none, e.g. a pseudo terminal or a USB adapter
+without the ioctl, the counters are zero then
+*/
+int RS232_PortGetCounters(rs232_port_t *port, rs232_counters_t *counters)
+{
+  memset(counters, 0, sizeof(rs232_counters_t));
+
+#if defined(__linux__)
+  struct serial_icounter_struct icount;
+
+  if(ioctl(port->fd, TIOCGICOUNT, &icount) == -1)
+  {
+    return(1);
+  }
+
+  counters->rx = icount.rx;
+  counters->tx = icount.tx;
+  counters->frame = icount.frame;
+  counters->overrun = icount.overrun;
+  counters->parity = icount.parity;
+  counters->brk = icount.brk;
+  counters->buf_overrun = icount.buf_overrun;
+
+  return(0);
+#else
+  (void)port;
+
+  return(1);
+#endif
+}
+
+/*
+Constant  Description
+TIOCM_LE        DSR (data set ready/line enable)
+TIOCM_DTR       DTR (data terminal ready)
+TIOCM_RTS       RTS (request to send)
+TIOCM_ST        Secondary TXD (transmit)
+TIOCM_SR        Secondary RXD (receive)
+TIOCM_CTS       CTS (clear to send)
+TIOCM_CAR       DCD (data carrier detect)
+TIOCM_CD        see TIOCM_CAR
+TIOCM_RNG       RNG (ring)
+TIOCM_RI        see TIOCM_RNG
+TIOCM_DSR       DSR (data set ready)
+
+http://man7.org/linux/man-pages/man4/tty_ioctl.4.html
+*/
+
+int RS232_PortIsDCDEnabled(rs232_port_t *port)
+{
+  int status;
+
+  ioctl(port->fd, TIOCMGET, &status);
+
+  if(status&TIOCM_CAR) return(1);
+  else return(0);
+}
+
+
+int RS232_PortIsRINGEnabled(rs232_port_t *port)
+{
+  int status;
+
+  ioctl(port->fd, TIOCMGET, &status);
+
+  if(status&TIOCM_RNG) return(1);
+  else return(0);
+}
+
+
+int RS232_PortIsCTSEnabled(rs232_port_t *port)
+{
+  int status;
+
+  ioctl(port->fd, TIOCMGET, &status);
+
+  if(status&TIOCM_CTS) return(1);
+  else return(0);
+}
+
+
+int RS232_PortIsDSREnabled(rs232_port_t *port)
+{
+  int status;
+
+  ioctl(port->fd, TIOCMGET, &status);
+
+  if(status&TIOCM_DSR) return(1);
+  else return(0);
+}
+
+
+static void RS232_PortSetModemLine(rs232_port_t *port, int line, int on)
+{
+  int status;
+
+  if(ioctl(port->fd, TIOCMGET, &status) == -1)
+  {
+    perror("unable to get portstatus");
+  }
+
+  if(on)  status |= line;
+  else  status &= ~line;
+
+  if(ioctl(port->fd, TIOCMSET, &status) == -1)
+  {
+    perror("unable to set portstatus");
+  }
+}
+
+
+void RS232_PortEnableDTR(rs232_port_t *port)
+{
+  RS232_PortSetModemLine(port, TIOCM_DTR, 1);    /* turn on DTR */
+}
+
+
+void RS232_PortDisableDTR(rs232_port_t *port)
+{
+  RS232_PortSetModemLine(port, TIOCM_DTR, 0);    /* turn off DTR */
+}
+
+
+void RS232_PortEnableRTS(rs232_port_t *port)
+{
+  RS232_PortSetModemLine(port, TIOCM_RTS, 1);    /* turn on RTS */
+}
+
+
+void RS232_PortDisableRTS(rs232_port_t *port)
+{
+  RS232_PortSetModemLine(port, TIOCM_RTS, 0);    /* turn off RTS */
+}
+
+
+void RS232_PortFlushRX(rs232_port_t *port)
+{
+  tcflush(port->fd, TCIFLUSH);
+}
+
+
+void RS232_PortFlushTX(rs232_port_t *port)
+{
+  tcflush(port->fd, TCOFLUSH);
+}
+
+
+void RS232_PortFlushRXTX(rs232_port_t *port)
 {
-  tcflush(Cport[comport_number], TCIOFLUSH);
+  tcflush(port->fd, TCIOFLUSH);
 }
 
 
@@ -499,8 +927,6 @@ void RS232_flushRXTX(int comport_number)
 
 #define RS232_PORTNR  32
 
-HANDLE Cport[RS232_PORTNR];
-
 
 const char *comports[RS232_PORTNR]={"\\\\.\\COM1",  "\\\\.\\COM2",  "\\\\.\\COM3",  "\\\\.\\COM4",
                                     "\\\\.\\COM5",  "\\\\.\\COM6",  "\\\\.\\COM7",  "\\\\.\\COM8",
@@ -511,16 +937,19 @@ const char *comports[RS232_PORTNR]={"\\\\.\\COM1",  "\\\\.\\COM2",  "\\\\.\\COM3
                                     "\\\\.\\COM25", "\\\\.\\COM26", "\\\\.\\COM27", "\\\\.\\COM28",
                                     "\\\\.\\COM29", "\\\\.\\COM30", "\\\\.\\COM31", "\\\\.\\COM32"};
 
-char mode_str[128];
-
 
-int RS232_OpenComport(int comport_number, int baudrate, const char *mode, int flowctrl)
+int RS232_PortOpen(rs232_port_t *port, const char *devname, int baudrate, const char *mode, int flowctrl)
 {
-  if((comport_number>=RS232_PORTNR)||(comport_number<0))
+  char mode_str[128];
+
+  port->handle = INVALID_HANDLE_VALUE;
+
+  if(strlen(devname) >= RS232_NAME_SIZE)
   {
-    printf("illegal comport number\n");
+    printf("too long device name \"%s\"\n", devname);
     return(1);
   }
+  strcpy(port->name, devname);
 
   switch(baudrate)
   {
@@ -562,8 +991,12 @@ int RS232_OpenComport(int comport_number, int baudrate, const char *mode, int fl
                    break;
     case 3000000 : strcpy(mode_str, "baud=3000000");
                    break;
-    default      : printf("invalid baudrate\n");
-                   return(1);
+    default      : if(baudrate <= 0)
+                   {
+                     printf("invalid baudrate\n");
+                     return(1);
+                   }
+                   sprintf(mode_str, "baud=%d", baudrate);  /* the driver decides */
                    break;
   }
 
@@ -632,7 +1065,7 @@ http://technet.microsoft.com/en-us/library/cc732236.aspx
 https://docs.microsoft.com/en-us/windows/desktop/api/winbase/ns-winbase-_dcb
 */
 
-  Cport[comport_number] = CreateFileA(comports[comport_number],
+  port->handle = CreateFileA(port->name,
                       GENERIC_READ|GENERIC_WRITE,
                       0,                          /* no share  */
                       NULL,                       /* no security */
@@ -640,7 +1073,7 @@ https://docs.microsoft.com/en-us/windows/desktop/api/winbase/ns-winbase-_dcb
                       0,                          /* no threads */
                       NULL);                      /* no templates */
 
-  if(Cport[comport_number]==INVALID_HANDLE_VALUE)
+  if(port->handle==INVALID_HANDLE_VALUE)
   {
     printf("unable to open comport\n");
     return(1);
@@ -653,7 +1086,8 @@ https://docs.microsoft.com/en-us/windows/desktop/api/winbase/ns-winbase-_dcb
   if(!BuildCommDCBA(mode_str, &port_settings))
   {
     printf("unable to set comport dcb settings\n");
-    CloseHandle(Cport[comport_number]);
+    CloseHandle(port->handle);
+    port->handle = INVALID_HANDLE_VALUE;
     return(1);
   }
 
@@ -663,10 +1097,11 @@ https://docs.microsoft.com/en-us/windows/desktop/api/winbase/ns-winbase-_dcb
     port_settings.fRtsControl = RTS_CONTROL_HANDSHAKE;
   }
 
-  if(!SetCommState(Cport[comport_number], &port_settings))
+  if(!SetCommState(port->handle, &port_settings))
   {
     printf("unable to set comport cfg settings\n");
-    CloseHandle(Cport[comport_number]);
+    CloseHandle(port->handle);
+    port->handle = INVALID_HANDLE_VALUE;
     return(1);
   }
 
@@ -678,10 +1113,11 @@ https://docs.microsoft.com/en-us/windows/desktop/api/winbase/ns-winbase-_dcb
   Cptimeouts.WriteTotalTimeoutMultiplier = 0;
   Cptimeouts.WriteTotalTimeoutConstant   = 0;
 
-  if(!SetCommTimeouts(Cport[comport_number], &Cptimeouts))
+  if(!SetCommTimeouts(port->handle, &Cptimeouts))
   {
     printf("unable to set comport time-out settings\n");
-    CloseHandle(Cport[comport_number]);
+    CloseHandle(port->handle);
+    port->handle = INVALID_HANDLE_VALUE;
     return(1);
   }
 
@@ -689,14 +1125,14 @@ https://docs.microsoft.com/en-us/windows/desktop/api/winbase/ns-winbase-_dcb
 }
 
 
-int RS232_PollComport(int comport_number, unsigned char *buf, int size)
+int RS232_PortPoll(rs232_port_t *port, unsigned char *buf, int size)
 {
   int n;
 
 /* added the void pointer cast, otherwise gcc will complain about */
 /* "warning: dereferencing type-punned pointer will break strict aliasing rules" */
 
-  if(!ReadFile(Cport[comport_number], buf, size, (LPDWORD)((void *)&n), NULL))
+  if(!ReadFile(port->handle, buf, size, (LPDWORD)((void *)&n), NULL))
   {
     return -1;
   }
@@ -705,142 +1141,592 @@ int RS232_PollComport(int comport_number, unsigned char *buf, int size)
 }
 
 
-int RS232_SendByte(int comport_number, unsigned char byte)
+/* there is no poll() on a comm handle, check the input queue every millisecond */
+int RS232_PortWait(rs232_port_t *port, int timeout_ms)
 {
-  int n;
+  COMSTAT status;
 
-  if(!WriteFile(Cport[comport_number], &byte, 1, (LPDWORD)((void *)&n), NULL))
+  DWORD errors,
+        start = GetTickCount();
+
+  while(1)
   {
-    return(1);
+    if(!ClearCommError(port->handle, &errors, &status))
+    {
+      return -1;
+    }
+
+    if(status.cbInQue > 0)  return 1;
+
+    if((timeout_ms >= 0) && ((GetTickCount() - start) >= (DWORD)timeout_ms))
+    {
+      return 0;
+    }
+
+    Sleep(1);
   }
+}
 
-  if(n<0)  return(1);
 
-  return(0);
+/* WriteFile() blocks until the bytes are written, the port is always writable */
+int RS232_PortWaitWritable(rs232_port_t *port, int timeout_ms)
+{
+  return 1;
 }
 
 
-int RS232_SendBuf(int comport_number, unsigned char *buf, int size)
+int RS232_PortGetOutQueue(rs232_port_t *port)
 {
-  int n;
+  COMSTAT status;
+
+  DWORD errors;
 
-  if(WriteFile(Cport[comport_number], buf, size, (LPDWORD)((void *)&n), NULL))
+  if(!ClearCommError(port->handle, &errors, &status))
   {
-    return(n);
+    return -1;
   }
 
-  return(-1);
+  return((int)status.cbOutQue);
 }
 
 
-void RS232_CloseComport(int comport_number)
+int RS232_PortGetInQueue(rs232_port_t *port)
 {
-  CloseHandle(Cport[comport_number]);
-}
+  COMSTAT status;
 
-/*
-http://msdn.microsoft.com/en-us/library/windows/desktop/aa363258%28v=vs.85%29.aspx
-*/
+  DWORD errors;
 
-int RS232_IsDCDEnabled(int comport_number)
-{
+  if(!ClearCommError(port->handle, &errors, &status))
+  {
+    return -1;
+  }
+
+  return((int)status.cbInQue);
+}
+
+
+int RS232_PortDrain(rs232_port_t *port)
+{
+  if(!FlushFileBuffers(port->handle))
+  {
+    return -1;
+  }
+
+  return(0);
+}
+
+
+/* changes the baudrate of the opened port, the other settings are kept */
+int RS232_PortSetBaudrate(rs232_port_t *port, int baudrate)
+{
+  DCB port_settings;
+
+  memset(&port_settings, 0, sizeof(port_settings));
+  port_settings.DCBlength = sizeof(port_settings);
+
+  if(!GetCommState(port->handle, &port_settings))
+  {
+    printf("unable to read comport settings\n");
+    return(1);
+  }
+
+  port_settings.BaudRate = (DWORD)baudrate;
+
+  if(!SetCommState(port->handle, &port_settings))
+  {
+    printf("unable to set comport cfg settings\n");
+    return(1);
+  }
+
+  return(0);
+}
+
+
+/* returns the baudrate set in the driver, -1 if it is not known */
+int RS232_PortGetBaudrate(rs232_port_t *port)
+{
+  DCB port_settings;
+
+  memset(&port_settings, 0, sizeof(port_settings));
+  port_settings.DCBlength = sizeof(port_settings);
+
+  if(!GetCommState(port->handle, &port_settings))
+  {
+    return -1;
+  }
+
+  return((int)port_settings.BaudRate);
+}
+
+
+/* ReadFile() waits for the first byte and then until the buffer is full */
+/* or vtime * 100 mSec. passed between two bytes */
+int RS232_PortSetReadBatching(rs232_port_t *port, int vmin, int vtime)
+{
+  COMMTIMEOUTS Cptimeouts;
+
+  if((vmin < 0) || (vmin > 255) || (vtime < 0) || (vtime > 255))
+  {
+    printf("invalid read batching %d / %d\n", vmin, vtime);
+    return(1);
+  }
+
+  Cptimeouts.ReadIntervalTimeout         = (vmin > 0) ? (DWORD)(vtime * 100) : MAXDWORD;
+  Cptimeouts.ReadTotalTimeoutMultiplier  = 0;
+  Cptimeouts.ReadTotalTimeoutConstant    = 0;
+  Cptimeouts.WriteTotalTimeoutMultiplier = 0;
+  Cptimeouts.WriteTotalTimeoutConstant   = 0;
+
+  if(!SetCommTimeouts(port->handle, &Cptimeouts))
+  {
+    printf("unable to set comport time-out settings\n");
+    return(1);
+  }
+
+  return(0);
+}
+
+
+int RS232_PortSendByte(rs232_port_t *port, unsigned char byte)
+{
+  int n;
+
+  if(!WriteFile(port->handle, &byte, 1, (LPDWORD)((void *)&n), NULL))
+  {
+    return(1);
+  }
+
+  if(n<0)  return(1);
+
+  return(0);
+}
+
+
+int RS232_PortSendBuf(rs232_port_t *port, unsigned char *buf, int size)
+{
+  int n;
+
+  if(WriteFile(port->handle, buf, size, (LPDWORD)((void *)&n), NULL))
+  {
+    return(n);
+  }
+
+  return(-1);
+}
+
+
+/* no writev() on windows, the buffers are written one after another */
+int RS232_PortSendBufv(rs232_port_t *port, unsigned char **bufs, const int *sizes, int count)
+{
+  int i, n, sent=0;
+
+  if((count < 1) || (count > RS232_MAX_IOV))
+  {
+    return -1;
+  }
+
+  for(i=0; i<count; i++)
+  {
+    n = RS232_PortSendBuf(port, bufs[i], sizes[i]);
+    if(n < 0)
+    {
+      return -1;
+    }
+
+    sent += n;
+
+    if(n < sizes[i])  break;
+  }
+
+  return(sent);
+}
+
+
+void RS232_PortClose(rs232_port_t *port)
+{
+  if(port->handle == INVALID_HANDLE_VALUE)  return;
+
+  CloseHandle(port->handle);
+  port->handle = INVALID_HANDLE_VALUE;
+}
+
+
+/* ClearCommError() reports only the flags of the last errors, not counters */
+int RS232_PortGetCounters(rs232_port_t *port, rs232_counters_t *counters)
+{
+  (void)port;
+
+  memset(counters, 0, sizeof(rs232_counters_t));
+
+  return(1);
+}
+
+
+/* no pseudo terminals on windows, use a com0com pair instead */
+int RS232_PortOpenPty(rs232_port_t *port, int baudrate, const char *mode, int flowctrl, char *slave_name, int size)
+{
+  printf("pseudo terminals are not supported on windows\n");
+
+  return(1);
+}
+
+/*
+http://msdn.microsoft.com/en-us/library/windows/desktop/aa363258%28v=vs.85%29.aspx
+*/
+
+int RS232_PortIsDCDEnabled(rs232_port_t *port)
+{
   int status;
 
-  GetCommModemStatus(Cport[comport_number], (LPDWORD)((void *)&status));
+  GetCommModemStatus(port->handle, (LPDWORD)((void *)&status));
 
   if(status&MS_RLSD_ON) return(1);
   else return(0);
 }
 
 
-int RS232_IsRINGEnabled(int comport_number)
+int RS232_PortIsRINGEnabled(rs232_port_t *port)
 {
   int status;
 
-  GetCommModemStatus(Cport[comport_number], (LPDWORD)((void *)&status));
+  GetCommModemStatus(port->handle, (LPDWORD)((void *)&status));
 
   if(status&MS_RING_ON) return(1);
   else return(0);
 }
 
 
-int RS232_IsCTSEnabled(int comport_number)
+int RS232_PortIsCTSEnabled(rs232_port_t *port)
 {
   int status;
 
-  GetCommModemStatus(Cport[comport_number], (LPDWORD)((void *)&status));
+  GetCommModemStatus(port->handle, (LPDWORD)((void *)&status));
 
   if(status&MS_CTS_ON) return(1);
   else return(0);
 }
 
 
-int RS232_IsDSREnabled(int comport_number)
+int RS232_PortIsDSREnabled(rs232_port_t *port)
 {
   int status;
 
-  GetCommModemStatus(Cport[comport_number], (LPDWORD)((void *)&status));
+  GetCommModemStatus(port->handle, (LPDWORD)((void *)&status));
 
   if(status&MS_DSR_ON) return(1);
   else return(0);
 }
 
 
+void RS232_PortEnableDTR(rs232_port_t *port)
+{
+  EscapeCommFunction(port->handle, SETDTR);
+}
+
+
+void RS232_PortDisableDTR(rs232_port_t *port)
+{
+  EscapeCommFunction(port->handle, CLRDTR);
+}
+
+
+void RS232_PortEnableRTS(rs232_port_t *port)
+{
+  EscapeCommFunction(port->handle, SETRTS);
+}
+
+
+void RS232_PortDisableRTS(rs232_port_t *port)
+{
+  EscapeCommFunction(port->handle, CLRRTS);
+}
+
+/*
+https://msdn.microsoft.com/en-us/library/windows/desktop/aa363428%28v=vs.85%29.aspx
+*/
+
+void RS232_PortFlushRX(rs232_port_t *port)
+{
+  PurgeComm(port->handle, PURGE_RXCLEAR | PURGE_RXABORT);
+}
+
+
+void RS232_PortFlushTX(rs232_port_t *port)
+{
+  PurgeComm(port->handle, PURGE_TXCLEAR | PURGE_TXABORT);
+}
+
+
+void RS232_PortFlushRXTX(rs232_port_t *port)
+{
+  PurgeComm(port->handle, PURGE_RXCLEAR | PURGE_RXABORT);
+  PurgeComm(port->handle, PURGE_TXCLEAR | PURGE_TXABORT);
+}
+
+
+#endif
+
+
+/*
+ports addressed by a number, the number selects the device in comports
+(or the name set by RS232_SetComportName()), the functions below
+use the port objects and are kept for the programs written for them
+*/
+static rs232_port_t ports[RS232_PORTNR];
+
+
+/* returns the port object of comport_number or NULL */
+rs232_port_t *RS232_GetPort(int comport_number)
+{
+  if((comport_number>=RS232_PORTNR)||(comport_number<0))
+  {
+    printf("illegal comport number\n");
+    return(NULL);
+  }
+
+  return(ports + comport_number);
+}
+
+
+int RS232_OpenComport(int comport_number, int baudrate, const char *mode, int flowctrl)
+{
+  rs232_port_t *port = RS232_GetPort(comport_number);
+
+  if(port == NULL)  return(1);
+
+  return RS232_PortOpen(port, comports[comport_number], baudrate, mode, flowctrl);
+}
+
+
+int RS232_OpenPty(int comport_number, int baudrate, const char *mode, int flowctrl, char *slave_name, int size)
+{
+  rs232_port_t *port = RS232_GetPort(comport_number);
+
+  if(port == NULL)  return(1);
+
+  return RS232_PortOpenPty(port, baudrate, mode, flowctrl, slave_name, size);
+}
+
+
+int RS232_PollComport(int comport_number, unsigned char *buf, int size)
+{
+  return RS232_PortPoll(ports + comport_number, buf, size);
+}
+
+
+int RS232_WaitComport(int comport_number, int timeout_ms)
+{
+  return RS232_PortWait(ports + comport_number, timeout_ms);
+}
+
+
+int RS232_WaitComportWritable(int comport_number, int timeout_ms)
+{
+  return RS232_PortWaitWritable(ports + comport_number, timeout_ms);
+}
+
+
+int RS232_GetOutQueue(int comport_number)
+{
+  return RS232_PortGetOutQueue(ports + comport_number);
+}
+
+
+int RS232_GetInQueue(int comport_number)
+{
+  return RS232_PortGetInQueue(ports + comport_number);
+}
+
+
+int RS232_DrainComport(int comport_number)
+{
+  return RS232_PortDrain(ports + comport_number);
+}
+
+
+int RS232_SetBaudrate(int comport_number, int baudrate)
+{
+  return RS232_PortSetBaudrate(ports + comport_number, baudrate);
+}
+
+
+int RS232_GetCounters(int comport_number, rs232_counters_t *counters)
+{
+  return RS232_PortGetCounters(ports + comport_number, counters);
+}
+
+
+int RS232_GetBaudrate(int comport_number)
+{
+  return RS232_PortGetBaudrate(ports + comport_number);
+}
+
+
+int RS232_SetReadBatching(int comport_number, int vmin, int vtime)
+{
+  return RS232_PortSetReadBatching(ports + comport_number, vmin, vtime);
+}
+
+
+int RS232_SendByte(int comport_number, unsigned char byte)
+{
+  return RS232_PortSendByte(ports + comport_number, byte);
+}
+
+
+int RS232_SendBuf(int comport_number, unsigned char *buf, int size)
+{
+  return RS232_PortSendBuf(ports + comport_number, buf, size);
+}
+
+
+int RS232_SendBufv(int comport_number, unsigned char **bufs, const int *sizes, int count)
+{
+  return RS232_PortSendBufv(ports + comport_number, bufs, sizes, count);
+}
+
+
+void RS232_CloseComport(int comport_number)
+{
+  RS232_PortClose(ports + comport_number);
+}
+
+
+int RS232_IsDCDEnabled(int comport_number)
+{
+  return RS232_PortIsDCDEnabled(ports + comport_number);
+}
+
+
+int RS232_IsRINGEnabled(int comport_number)
+{
+  return RS232_PortIsRINGEnabled(ports + comport_number);
+}
+
+
+int RS232_IsCTSEnabled(int comport_number)
+{
+  return RS232_PortIsCTSEnabled(ports + comport_number);
+}
+
+
+int RS232_IsDSREnabled(int comport_number)
+{
+  return RS232_PortIsDSREnabled(ports + comport_number);
+}
+
+
 void RS232_enableDTR(int comport_number)
 {
-  EscapeCommFunction(Cport[comport_number], SETDTR);
+  RS232_PortEnableDTR(ports + comport_number);
 }
 
 
 void RS232_disableDTR(int comport_number)
 {
-  EscapeCommFunction(Cport[comport_number], CLRDTR);
+  RS232_PortDisableDTR(ports + comport_number);
 }
 
 
 void RS232_enableRTS(int comport_number)
 {
-  EscapeCommFunction(Cport[comport_number], SETRTS);
+  RS232_PortEnableRTS(ports + comport_number);
 }
 
 
 void RS232_disableRTS(int comport_number)
 {
-  EscapeCommFunction(Cport[comport_number], CLRRTS);
+  RS232_PortDisableRTS(ports + comport_number);
 }
 
-/*
-https://msdn.microsoft.com/en-us/library/windows/desktop/aa363428%28v=vs.85%29.aspx
-*/
 
 void RS232_flushRX(int comport_number)
 {
-  PurgeComm(Cport[comport_number], PURGE_RXCLEAR | PURGE_RXABORT);
+  RS232_PortFlushRX(ports + comport_number);
 }
 
 
 void RS232_flushTX(int comport_number)
 {
-  PurgeComm(Cport[comport_number], PURGE_TXCLEAR | PURGE_TXABORT);
+  RS232_PortFlushTX(ports + comport_number);
 }
 
 
 void RS232_flushRXTX(int comport_number)
 {
-  PurgeComm(Cport[comport_number], PURGE_RXCLEAR | PURGE_RXABORT);
-  PurgeComm(Cport[comport_number], PURGE_TXCLEAR | PURGE_TXABORT);
+  RS232_PortFlushRXTX(ports + comport_number);
 }
 
 
-#endif
-
-
 void RS232_cputs(int comport_number, const char *text)  /* sends a string to serial port */
 {
   while(*text != 0)   RS232_SendByte(comport_number, *(text++));
 }
 
 
+/* opens the port with kernel side batching of the reads, see RS232_SetReadBatching() */
+int RS232_OpenComportBatched(int comport_number, int baudrate, const char *mode, int flowctrl, int vmin, int vtime)
+{
+  if(RS232_OpenComport(comport_number, baudrate, mode, flowctrl))
+  {
+    return(1);
+  }
+
+  if(RS232_SetReadBatching(comport_number, vmin, vtime))
+  {
+    RS232_CloseComport(comport_number);
+    return(1);
+  }
+
+  return(0);
+}
+
+
+/* changes the device opened by RS232_OpenComport(), e.g. "/dev/pts/3" */
+int RS232_SetComportName(int comport_number, const char *devname)
+{
+  static char names[RS232_PORTNR][RS232_NAME_SIZE];
+
+  if((comport_number>=RS232_PORTNR)||(comport_number<0))
+  {
+    printf("illegal comport number\n");
+    return(1);
+  }
+
+  if(strlen(devname) >= RS232_NAME_SIZE)
+  {
+    printf("too long device name \"%s\"\n", devname);
+    return(1);
+  }
+
+  strcpy(names[comport_number], devname);
+  comports[comport_number] = names[comport_number];
+
+  return(0);
+}
+
+
+/* creates a pseudo terminal and opens both sides, a loopback in one process */
+int RS232_OpenPtyPair(int master_number, int slave_number, int baudrate, const char *mode, int flowctrl)
+{
+  char slave_name[RS232_NAME_SIZE];
+
+  if(RS232_OpenPty(master_number, baudrate, mode, flowctrl, slave_name, RS232_NAME_SIZE))
+  {
+    return(1);
+  }
+
+  if(RS232_SetComportName(slave_number, slave_name) ||
+     RS232_OpenComport(slave_number, baudrate, mode, flowctrl))
+  {
+    RS232_CloseComport(master_number);
+    return(1);
+  }
+
+  return(0);
+}
+
+
 /* return index in comports matching to device name or -1 if not found */
 int RS232_GetPortnr(const char *devname)
 {
@@ -866,14 +1752,3 @@ int RS232_GetPortnr(const char *devname)
 
   return -1;  /* device not found */
 }
-
-
-
-
-
-
-
-
-
-
-
@@ -86,6 +86,25 @@ salt_ret_t salt_set_context(salt_channel_t *p_channel,
     return SALT_SUCCESS;
 }
 
+uint8_t salt_get_io_interest(salt_channel_t *p_channel)
+{
+    uint8_t interest = 0;
+
+    if (NULL == p_channel) {
+        return 0;
+    }
+
+    if (SALT_IO_READY != p_channel->read_channel.state) {
+        interest |= SALT_IO_WANT_READ;
+    }
+
+    if (SALT_IO_READY != p_channel->write_channel.state) {
+        interest |= SALT_IO_WANT_WRITE;
+    }
+
+    return interest;
+}
+
 salt_ret_t salt_protocols_init(salt_channel_t *p_channel,
                                salt_protocols_t *p_protocols,
                                uint8_t *p_buffer,
@@ -26,13 +26,20 @@
 
 /* ======== Includes ===================================== */
 
+/* 64-bit off_t for pread() / pwritev() / mmap() of the files over 4 GiB */
+#if !defined(_WIN32)
+#define _FILE_OFFSET_BITS   64
+#endif
+
 /* Basic libraries for working in C. */
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <math.h>
 #include <time.h>
+#include <sys/time.h>
 
 /**
 * Macro allows diagnostic information to be written 
@@ -42,9 +49,17 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <malloc.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <errno.h>
 #endif
+#include <sys/stat.h>
 
 /* ===== Salt-channel libraries ===== */
 
@@ -85,23 +100,20 @@
  */
 #include "salti_util.h"
 
+/* SHA-512 of the blocks and of the file to be resumed */
+#include "salt_crypto_wrapper.h"
+
 /* 
  * Created functions for implementing 
  * Salt channel protocol on RS-232  
  */
 #include "salt_example_rs232.h" 
 
-/* for Linux for fseeko() and ftello() and macro MILISECONDS */
-#if !defined(_WIN32)
-#define _FILE_OFFSET_BITS   64
-#define MILISECONDS         850
-#endif
-
 
 salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_client_channel, 
                                     salt_io_impl write_impl,
                                     salt_io_impl read_impl,
-                                    int *p_cport_nr,
+                                    salt_io_ctx_t *p_io_ctx,
                                     salt_time_t *p_time_impl,
                                     uint32_t treshold) 
 {   
@@ -133,7 +145,7 @@ salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_client_channel,
      * 
      */
     ret = salt_create(p_client_channel, SALT_CLIENT, write_impl, read_impl, p_time_impl);
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /**
      * Creates and sets the signature used for the salt channel.
@@ -144,7 +156,7 @@ salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_client_channel,
      * @return SALT_ERROR   Any input pointer was a NULL pointer.
      */
     ret = salt_create_signature(p_client_channel); 
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /**
      * Initiates a new salt session.
@@ -162,17 +174,17 @@ salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_client_channel,
      *
      */
     ret = salt_init_session(p_client_channel, hndsk_buffer, sizeof(hndsk_buffer));
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
    /**
     * Sets the context passed to the user injected read/write implementation.
     */
-    ret = salt_set_context(p_client_channel, p_cport_nr, p_cport_nr);
-    assert(ret == SALT_SUCCESS);
+    ret = salt_set_context(p_client_channel, p_io_ctx, p_io_ctx);
+    if (ret != SALT_SUCCESS) return ret;
 
     /* Set threshold for delay protection */
     ret = salt_set_delay_threshold(p_client_channel, treshold);
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /* ========  Salt-handshake process  ================= */
     do {
@@ -194,7 +206,6 @@ salt_ret_t salt_impl_and_hndshk(salt_channel_t *p_client_channel,
             printf("Salt error: 0x%02x\r\n", p_client_channel->err_code);
             printf("Salt error read: 0x%02x\r\n", p_client_channel->read_channel.err_code);
             printf("Salt error write: 0x%02x\r\n", p_client_channel->write_channel.err_code);
-            assert(ret == SALT_SUCCESS);
         } else if (ret == SALT_SUCCESS) 
         {   
             /**
@@ -213,7 +224,7 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
                                     salt_protocols_t *p_protocols, 
                                     salt_io_impl write_impl,
                                     salt_io_impl read_impl,
-                                    int *p_cport_nr,
+                                    salt_io_ctx_t *p_io_ctx,
                                     salt_time_t *p_time_impl,
                                     const uint8_t *p_signature,
                                     uint32_t treshold) 
@@ -243,11 +254,11 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
      * Create a new Salt channel client 
      */
     ret = salt_create(p_server_channel, SALT_SERVER, write_impl, read_impl, p_time_impl);
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /* Initiates to add information about supported protocols to host */
     ret = salt_protocols_init(p_server_channel, p_protocols, protocol_buffer, sizeof(protocol_buffer));
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /**
      * Add a protocol to supported protocols.
@@ -270,7 +281,7 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
      * @return SALT_SUCCESS Protocol was added.
      */
     ret = salt_protocols_append(p_protocols, "ECHO", 4);
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /**
      * Sets the signature used for the salt channel.
@@ -287,33 +298,38 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
      * @return SALT_ERROR   Any input pointer was a NULL pointer.
      */
     ret = salt_set_signature(p_server_channel, p_signature);
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /**
      * Initiates a new salt session.
     */
     ret = salt_init_session(p_server_channel, hndsk_buffer, sizeof(hndsk_buffer));
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     /**
     * Sets the context passed to the user injected read/write implementation.
     *
     * @param client_channel     Pointer to channel handle.
-    * @param p_cport_nr        Pointer to write context.
-    * @param p_cport_nr        Pointer to read context.
+    * @param p_io_ctx          Pointer to write context.
+    * @param p_io_ctx          Pointer to read context.
     *
     * @return SALT_SUCCESS The context was successfully set.
     * @return SALT_ERROR   p_channel was a NULL pointer.
     */
-    ret = salt_set_context(p_server_channel, p_cport_nr, p_cport_nr);
-    assert(ret == SALT_SUCCESS);
+    ret = salt_set_context(p_server_channel, p_io_ctx, p_io_ctx);
+    if (ret != SALT_SUCCESS) return ret;
 
     /* Set threshold for delay protection */
     ret = salt_set_delay_threshold(p_server_channel, treshold);
-    assert(ret == SALT_SUCCESS);
+    if (ret != SALT_SUCCESS) return ret;
 
     printf("Performing Salt Handshake\n");
-    ret = salt_handshake(p_server_channel, NULL);
+
+    /* my_read() returns SALT_PENDING after its deadline, while the client is not here */
+    do {
+
+        ret = salt_handshake(p_server_channel, NULL);
+    } while (ret == SALT_PENDING);
 
     /**
      * @return SALT_SUCCESS When the handshake process is completed.
@@ -330,7 +346,6 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
         printf("Salt error: 0x%02x\r\n", p_server_channel->err_code);
         printf("Salt error read: 0x%02x\r\n", p_server_channel->read_channel.err_code);
         printf("Salt error write: 0x%02x\r\n", p_server_channel->write_channel.err_code);
-        assert(ret == SALT_SUCCESS);
     }
 
     if (ret == SALT_SUCCESS) 
@@ -347,13 +362,173 @@ salt_ret_t salt_impl_and_hndshk_server(salt_channel_t *p_server_channel,
 }
 
 
+/*
+ * Reads the confirmations "ACK <blocks> <credit>" of the receiver. With 
+ * wait it blocks until one arrives, then (and without wait) only the ones
+ * which are already in the port are read. Nothing is read when all sent
+ * blocks are confirmed, the next message is not a confirmation.
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+static int salt_window_read_ack(salt_channel_t *p_channel,
+                                salt_window_t *p_window,
+                                uint8_t *p_buffer,
+                                uint32_t size_buffer,
+                                salt_msg_t *p_msg,
+                                int wait)
+{
+    salt_io_ctx_t *p_io_ctx = (salt_io_ctx_t *) p_channel->read_channel.p_context;
+    int non_blocking = p_io_ctx->non_blocking;
+    uint32_t blocks, credit, length;
+    char ack[PROTOCOL_BUFFER];
+    salt_ret_t ret_msg;
+
+    /* The credit 0 is waited out, the receiver opens the window by the next ACK */
+    while (p_window->acked < p_window->blocks || (wait && p_window->credit == 0))
+    {
+        /* A read started without waiting continues by the next call */
+        if (!wait) salt_io_set_non_blocking(p_io_ctx, 1);
+        ret_msg = salt_read_begin(p_channel, p_buffer, size_buffer, p_msg);
+        salt_io_set_non_blocking(p_io_ctx, non_blocking);
+
+        if (ret_msg == SALT_ERROR) return -1;
+        if (ret_msg == SALT_PENDING)
+        {
+            if (!wait) return 0;
+            continue;
+        }
+
+        do
+        {
+            length = p_msg->read.message_size;
+            if (length >= sizeof(ack)) length = sizeof(ack) - 1;
+            memcpy(ack, p_msg->read.p_payload, length);
+            ack[length] = '\0';
+
+            if (sscanf(ack, "ACK %u %u", &blocks, &credit) != 2 || blocks > p_window->blocks)
+            {
+                printf("Unexpected confirmation: %s\n", ack);
+                return -1;
+            }
+            if (blocks > p_window->acked) p_window->acked = blocks;
+            p_window->credit = credit;
+        } while (salt_read_next(p_msg) == SALT_SUCCESS);
+
+        wait = 0;
+    }
+
+    return 0;
+}
+
+/* ====== Compression of the blocks ======= */
+
+int salt_compressor_init(salt_compressor_t *p_compressor, uint32_t block_size)
+{
+    memset(p_compressor, 0, sizeof(*p_compressor));
+    p_compressor->p_block = (uint8_t *) malloc((size_t) block_size + SALT_BLOCK_HEADER_SIZE);
+
+    return (p_compressor->p_block == NULL) ? -1 : 0;
+}
+
+void salt_compressor_free(salt_compressor_t *p_compressor)
+{
+    free(p_compressor->p_block);
+    p_compressor->p_block = NULL;
+}
+
+/*
+ * Puts the header and the block into the block of the compressor, 
+ * compressed if it gets smaller.
+ *
+ * @return  bytes of the header and the block
+ */
+static uint32_t salt_compress_block(salt_compressor_t *p_compressor, const uint8_t *p_data, uint32_t size)
+{
+    uint8_t *p_block = p_compressor->p_block;
+    uint32_t length = 0;
+
+    /* Compressed or encrypted data is not worth the try */
+    if (salt_lz_entropy(p_data, size) <= SALT_LZ_ENTROPY_MAX)
+    {
+        length = salt_lz_compress(&p_compressor->lz, p_data, size, &p_block[SALT_BLOCK_HEADER_SIZE], 
+                                  (size > 0) ? size - 1 : 0);
+    }
+
+    if (length > 0)
+    {
+        p_block[0] = SALT_BLOCK_LZ;
+        p_compressor->compressed++;
+    }
+    else
+    {
+        p_block[0] = SALT_BLOCK_RAW;
+        memcpy(&p_block[SALT_BLOCK_HEADER_SIZE], p_data, size);
+        length = size;
+    }
+    p_block[1] = (uint8_t) size;
+    p_block[2] = (uint8_t) (size >> 8);
+    p_block[3] = (uint8_t) (size >> 16);
+    p_block[4] = (uint8_t) (size >> 24);
+
+    p_compressor->blocks++;
+    p_compressor->raw_bytes += size;
+    p_compressor->sent_bytes += length + SALT_BLOCK_HEADER_SIZE;
+
+    return length + SALT_BLOCK_HEADER_SIZE;
+}
+
+/*
+ * Decodes the block with the header into p_out.
+ *
+ * @par capacity:       bytes free in p_out
+ * @par p_size:         bytes of the file in the block
+ *
+ * @return 0 in case success, -1 if the block is damaged or too large
+ */
+static int salt_decompress_block(const uint8_t *p_block, 
+                                 uint32_t length, 
+                                 uint8_t *p_out, 
+                                 uint32_t capacity,
+                                 uint32_t *p_size)
+{
+    uint32_t size, decoded;
+    uint8_t method;
+
+    if (length < SALT_BLOCK_HEADER_SIZE) return -1;
+
+    method = p_block[0];
+    size = (uint32_t) p_block[1] | ((uint32_t) p_block[2] << 8) | 
+           ((uint32_t) p_block[3] << 16) | ((uint32_t) p_block[4] << 24);
+    if (size > capacity) return -1;
+
+    length -= SALT_BLOCK_HEADER_SIZE;
+    p_block += SALT_BLOCK_HEADER_SIZE;
+    if (method == SALT_BLOCK_RAW)
+    {
+        if (length != size) return -1;
+        memcpy(p_out, p_block, size);
+    }
+    else if (method == SALT_BLOCK_LZ)
+    {
+        if (salt_lz_decompress(p_block, length, p_out, size, &decoded) != 0 || decoded != size) return -1;
+    }
+    else return -1;
+
+    *p_size = size;
+
+    return 0;
+}
+
 uint32_t salt_encrypt_and_send(salt_channel_t *p_channel,
                                uint8_t *p_buffer,
                                uint32_t size_buffer,
-                               uint32_t file_size,
+                               uint64_t file_size,
                                uint32_t block_size,
-                               uint8_t *p_input,
-                               salt_msg_t *p_msg)
+                               salt_file_source_t *p_source,
+                               salt_msg_t *p_msg,
+                               const uint64_t *p_ranges,
+                               uint32_t range_count,
+                               salt_compressor_t *p_compressor)
 { 
     /*
      * typedef enum
@@ -364,13 +539,60 @@ uint32_t salt_encrypt_and_send(salt_channel_t *p_channel,
     salt_msg_t confirm_msg;
 
     /* Variables for working with data   */          
-    uint32_t begin = 0, sent_size = block_size, sleep_return; 
+    uint64_t begin = 0, end = 0;
+    uint32_t sent_size = block_size, range = 0, length; 
     uint8_t help_buffer[STATIC_ARRAY];
+    const uint8_t *p_block;
+    uint32_t header = (p_compressor != NULL) ? SALT_BLOCK_HEADER_SIZE : 0;
+
+    /* Blocks sent and confirmed */
+    salt_window_t window;
+
+    salt_window_init(&window);
+    for (range = 0; range < range_count; range++)
+    {
+        if (p_ranges[2 * range] > p_ranges[2 * range + 1] || p_ranges[2 * range + 1] > file_size)
+        {
+            printf("\nInvalid range of the file %llu - %llu\n", 
+                   (unsigned long long) p_ranges[2 * range], (unsigned long long) p_ranges[2 * range + 1]);
+            return 0;
+        }
+    }
+    range = 0;
+    if (range_count > 0)
+    {
+        begin = p_ranges[0];
+        end = p_ranges[1];
+    }
 
     printf("\n******| Encrypting data and sending it with Salt channel |********\n");
           
-    while(begin < file_size)
+    while(range < range_count || window.acked < window.blocks)
     {
+        /* The next range of the blocks which the receiver misses */
+        if (range < range_count && begin >= end)
+        {
+            if (++range < range_count)
+            {
+                begin = p_ranges[2 * range];
+                end = p_ranges[2 * range + 1];
+            }
+            continue;
+        }
+
+        /* The window is full or all blocks are sent, waiting for a confirmation */
+        if (range >= range_count || window.blocks - window.acked >= window.credit)
+        {
+            if (salt_window_read_ack(p_channel, &window, help_buffer, sizeof(help_buffer), 
+                                     &confirm_msg, 1) != 0)
+            {
+                printf("\nError during reading of the confirmation\r\n");
+                salt_print_line_stats(p_channel);
+                return 0;
+            }
+            continue;
+        }
+
         /**
         * Write encrypted messages
         *
@@ -393,7 +615,8 @@ uint32_t salt_encrypt_and_send(salt_channel_t *p_channel,
         * @return SALT_ERROR   Bad buffer size or bad state of channel session.
         *
         */
-        ret_msg = salt_write_begin(p_buffer, sent_size + SALT_WRITE_OVRHD_SIZE, p_msg);
+        sent_size = block_size;
+        ret_msg = salt_write_begin(p_buffer, sent_size + header + SALT_WRITE_OVRHD_SIZE, p_msg);
         assert(ret_msg == SALT_SUCCESS);
 
         /**
@@ -429,19 +652,29 @@ uint32_t salt_encrypt_and_send(salt_channel_t *p_channel,
         *
         */
 
-        /* 
-         * If file_size < sent_size (BLOCK_SIZE)
-         * then we use APP packet
-         */
-        if (file_size % sent_size == file_size) sent_size = file_size;
-
         /*
-         * If left bytes less than sent_size(BLOCK_SIZE)
-         * send residue bytes
+         * If left bytes of the range less than sent_size(BLOCK_SIZE)
+         * send residue bytes, the ranges end at a block or at file_size
          */
-        if (begin + sent_size > file_size) sent_size = file_size - begin;
+        if (begin + sent_size > end) sent_size = (uint32_t) (end - begin);
+
+        /* The block is in the mapping or in a buffer read ahead */
+        p_block = salt_source_get(p_source, begin, sent_size);
+        if (p_block == NULL)
+        {
+            printf("\nFailed to read the file at %llu\n", (unsigned long long) begin);
+            return 0;
+        }
+
+        /* The block goes behind its header, compressed if it gets smaller */
+        length = sent_size;
+        if (p_compressor != NULL)
+        {
+            length = salt_compress_block(p_compressor, p_block, sent_size);
+            p_block = p_compressor->p_block;
+        }
 
-        ret_msg = salt_write_next(p_msg, p_input + begin, sent_size);
+        ret_msg = salt_write_next(p_msg, p_block, length);
         assert(ret_msg == SALT_SUCCESS);
 
         begin += sent_size;
@@ -480,25 +713,31 @@ uint32_t salt_encrypt_and_send(salt_channel_t *p_channel,
         if (ret_msg == SALT_ERROR)
         {   
             printf("\nError during writting:\r\n");
-            assert(ret_msg == SALT_SUCCESS);
+            salt_print_line_stats(p_channel);
+            return 0;
         } 
 
-        ret_msg = SALT_PENDING;
-        /* I expect confirmation from the recipient */
-        printf("\nI expect confirmation from the recipient :)\n");
-        while(1)
-        {   
-            ret_msg = salt_read_begin(p_channel, help_buffer, sizeof(help_buffer), &confirm_msg);
-            if (ret_msg == SALT_SUCCESS) break;
-        }
-#if !defined(_WIN32)
-        if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS)) == 0)
+        window.blocks++;
+
+        /* The confirmations which arrived meanwhile open the window */
+        if (salt_window_read_ack(p_channel, &window, help_buffer, sizeof(help_buffer), 
+                                 &confirm_msg, 0) != 0)
         {
-            printf("Problem during sleep");
+            printf("\nError during reading of the confirmation\r\n");
+            salt_print_line_stats(p_channel);
             return 0;
         }
-#endif
-    } /* end of while(begin < file_size) */
+
+        /* The credit paces the blocks, my_write() paces the bytes */
+    } /* end of while(range < range_count || window.acked < window.blocks) */
+
+    if (p_compressor != NULL && p_compressor->blocks > 0)
+    {
+        printf("\nCompressed %u of %u blocks, %llu bytes of the file sent as %llu (%.2fx)\n",
+               p_compressor->compressed, p_compressor->blocks, 
+               (unsigned long long) p_compressor->raw_bytes, (unsigned long long) p_compressor->sent_bytes,
+               (double) p_compressor->raw_bytes / (double) p_compressor->sent_bytes);
+    }
     
     return 1;
 }
@@ -517,13 +756,18 @@ uint32_t salt_write_small_messages(salt_channel_t *p_channel,
 
    //Prepare the message before encrypting and sending 
    ret = salt_write_begin(tx_buffer, sizeof(tx_buffer), &out_msg);
-   assert(ret == SALT_SUCCESS);
+   if (ret != SALT_SUCCESS) return 0;
    //Copy clear text message to be encrypted to next encrypted package
    ret = salt_write_next(&out_msg, p_data, size_data);
-   assert(ret == SALT_SUCCESS);
+   if (ret != SALT_SUCCESS) return 0;
    //Wrapping and creating encrypted messages, sending for client 
    ret = salt_write_execute(p_channel, &out_msg, false);
-   assert(ret == SALT_SUCCESS);
+   if (ret != SALT_SUCCESS)
+   {
+       printf("\nError during writing :(\r\n");
+       salt_print_line_stats(p_channel);
+       return 0;
+   }
 
     return 1;
 }
@@ -532,7 +776,7 @@ uint32_t salt_read_small_messages(salt_channel_t *p_channel,
                                  uint8_t *p_buffer,
                                  uint32_t buffer_size,
                                  salt_msg_t *p_msg,
-                                 uint32_t *p_expceted_size,
+                                 uint64_t *p_expceted_size,
                                  uint32_t read_convert_size)
 { 
     memset(p_buffer, 0, buffer_size);
@@ -558,16 +802,17 @@ uint32_t salt_read_small_messages(salt_channel_t *p_channel,
             printf("%*.*s\r\n", 0, p_msg->read.message_size, (char*) p_msg->read.p_payload);
             if(read_convert_size)
             {
-                *p_expceted_size= atoi((char*)p_msg->read.p_payload);
+                *p_expceted_size= strtoull((char*)p_msg->read.p_payload, NULL, 10);
             }
         } while (salt_read_next(p_msg) == SALT_SUCCESS);
     }
 
-    /* Verification of the decryption and data transmission process */
+    /* Verification of the decryption and data transmission process, the caller closes the session */
     if (ret == SALT_ERROR)
     {
         printf("\nError during reading :(\r\n");
-        assert(ret == SALT_SUCCESS);
+        salt_print_line_stats(p_channel);
+        return 0;
     } 
 
     return 1;
@@ -575,199 +820,1824 @@ uint32_t salt_read_small_messages(salt_channel_t *p_channel,
 }
 
 uint32_t salt_convert_size_and_send(salt_channel_t *p_channel,
-                                    uint32_t convert_size)     
+                                    uint64_t convert_size)     
 { 
     /* Buffer for conversion size to char */
     uint8_t convert_array[STATIC_ARRAY];
     memset(convert_array, 0, sizeof(convert_array));
 
-    /* Convert uint32_t (convert_size) to char and send it with cport_number */
-    sprintf((char *)convert_array, "%u", convert_size);
+    /* Convert uint64_t (convert_size) to char and send it with cport_number */
+    sprintf((char *)convert_array, "%llu", (unsigned long long) convert_size);
 
     uint32_t received_verify = salt_write_small_messages(p_channel,
                                                          convert_array,
                                                         strlen((char *)convert_array),
                                                         STATIC_ARRAY);
-    if (received_verify != 1)
-    {
-        printf("Failed to send size message\n");
-        assert(received_verify == 1);
-    } 
+    if (received_verify != 1) printf("Failed to send size message\n");
     
     return (received_verify == 1) ? received_verify : 0;
 }
 
+/* Copies the last read message as a string */
+static void salt_message_text(salt_msg_t *p_msg, char *p_text, uint32_t size)
+{
+    uint32_t length = p_msg->read.message_size;
 
-uint32_t sleep_miliseconds_win_linux(int sleep_miliseconds)
-{ 
-
-#ifdef _WIN32
-    Sleep(sleep_miliseconds); /* Sleep for sleep_miliseconds - WINDOWS */
-#else
-    usleep(sleep_miliseconds * 1000);  /* - Linux */
-#endif
-
-    return 1;
+    if (length >= size) length = size - 1;
+    memcpy(p_text, p_msg->read.p_payload, length);
+    p_text[length] = '\0';
 }
 
-uint32_t salt_read_and_decrypt_server(salt_channel_t *p_channel,
-                                        uint8_t *p_buffer,
-                                        uint32_t size_buffer,
-                                        salt_msg_t *p_msg,
-                                        uint8_t *p_coppy_buffer,
-                                        uint32_t *p_decrypt_size,
-                                        FILE *fp)
+int salt_resume_client(salt_channel_t *p_channel,
+                       const char *p_id,
+                       uint64_t *p_ranges,
+                       uint32_t max_ranges,
+                       int compression)
 {
+    uint8_t buffer[STATIC_ARRAY];
+    char message[STATIC_ARRAY];
+    salt_msg_t msg_in;
+    uint32_t count, i;
+    unsigned long long value;
+    int offset, used;
+    double deadline;
+    salt_ret_t ret;
 
-    /*
-     * typedef enum
-     * which can obtain values:
-     * SALT_SUCCESS, SALT_PENDING, SALT_ERROR            
-     */
-    salt_ret_t ret_msg;
+    /* The receiver finds its journal by the id of the file */
+    sprintf(message, "FILE %s%s", p_id, compression ? " LZ" : "");
+    if (salt_write_small_messages(p_channel, (uint8_t *) message, strlen(message), STATIC_ARRAY) != 1) return -1;
 
-    /* Variables for confirm message */
-    uint32_t result, length_check;
+    /* The server checks its journal first, a server which does not answer ends the session */
+    deadline = wall_time_seconds() + SALT_REPLY_TIMEOUT / 1000.0;
+    do {
 
-    uint8_t check_data[STATIC_ARRAY];
+        ret = salt_read_begin(p_channel, buffer, sizeof(buffer), &msg_in);
+    } while (ret == SALT_PENDING && wall_time_seconds() < deadline);
 
-    strcpy((char *)check_data, "OK");
-    length_check = strlen((char *)check_data);
+    if (ret != SALT_SUCCESS)
+    {
+        printf("No answer of the server to the resume (0x%02x)\n", p_channel->read_channel.err_code);
+        return -1;
+    }
 
-    printf("\n******| Data reception and decryption with Salt channel |********\n");
+    salt_message_text(&msg_in, message, sizeof(message));
+    if (sscanf(message, "RESUME %u%n", &count, &offset) != 1 || count > max_ranges) return -1;
 
-    /**
-    * Reads one or multiple encrypted message.
-    *
-    * The actual I/O operation of the read process.
-    *
-    * @param p_channel:
-    * Pointer to salt channel handle.
-    * @param p_buffer:      
-    * Pointer where to store received (clear text) data.
-    * @param size_buffer:   
-    * Size of p_buffer, must be greater or equal to SALT_READ_OVERHEAD_SIZE.
-    * @param p_msg:         
-    * Pointer to message structure to use when reading the message.
-    *
-    *
-    * @return SALT_SUCCESS A message was successfully received.
-    * @return SALT_PENDING The receive process is still pending.
-    * @return SALT_ERROR   If any error occured during the read. If this occured, the session is considered
-    *                      closed and a new handshake must be performed. I.e., the session must be initated
-    *                      and then a handshake.
-    */
-    do 
+    for (i = 0; i < 2 * count; i++)
     {
+        if (sscanf(&message[offset], "%llu%n", &value, &used) != 1) return -1;
+        p_ranges[i] = value;
+        offset += used;
+    }
 
-        ret_msg = salt_read_begin(p_channel, p_buffer, size_buffer, p_msg);
-    } while (ret_msg == SALT_PENDING);
+    return (int) count;
+}
 
-    /**
-    * Used to read messages recevied.
-    *
-    * Used to read single or multiple application packages. Due to encryption overhead
-    * the longest clear text message that can be received is SALT_READ_OVERHEAD_SIZE smaller
-    * than the provided receive buffer.
-    *
-    * @param msg_in     Pointer to message structure.
-    *
-    * @return SALT_SUCCESS The next message could be parsed and ready to be read.
-    * @return SALT_ERROR   No more messages available.
-    *
-    * Read message structure:
-    * typedef union salt_msg_u {
-    *  struct {
-    *      uint8_t     *p_buffer;          < Message buffer. 
-    *      uint8_t     *p_payload;         < Pointer to current message. 
-    *      uint32_t    buffer_size;        < Message buffer size. 
-    *      uint32_t    buffer_used;        < Index of how many bytes have been processed. 
-    *      uint16_t    messages_left;      < Number of messages left to read. 
-    *      uint32_t    message_size;       < Current message size. 
-    *  } read;
-    * } salt_msg_t;
-    * 
-    */
-    if (ret_msg == SALT_SUCCESS)     
-    {   
-        printf("\nRecevied %d BLOCK/BLOCKS:\n\n", ++p_msg->read.messages_left);
-            
-        do 
-        {
-            *p_decrypt_size += p_msg->read.message_size;
-            fwrite(p_msg->read.p_payload, 1, p_msg->read.message_size, fp); 
-        } while (salt_read_next(p_msg) == SALT_SUCCESS);
-    } else if (ret_msg == SALT_ERROR)
+int salt_resume_server(salt_channel_t *p_channel,
+                       salt_journal_t *p_journal,
+                       const char *file,
+                       int data_fd,
+                       uint64_t file_size,
+                       uint32_t block_size,
+                       uint64_t *p_ranges,
+                       uint32_t max_ranges,
+                       int *p_compression)
+{
+    uint8_t buffer[STATIC_ARRAY], id[SALT_DIGEST_SIZE];
+    char message[STATIC_ARRAY];
+    salt_msg_t msg_in;
+    uint32_t count, i, length;
+    unsigned int byte;
+    int committed;
+
+    if (salt_read_small_messages(p_channel, buffer, sizeof(buffer), &msg_in, NULL, 0) != 1) return -1;
+
+    salt_message_text(&msg_in, message, sizeof(message));
+    if (strncmp(message, "FILE ", 5) != 0) return -1;
+
+    /* The blocks of the sender have the header of the compression */
+    length = (uint32_t) strlen(message);
+    *p_compression = (length == 5 + 2 * SALT_DIGEST_SIZE + 3 && 
+                      strcmp(&message[5 + 2 * SALT_DIGEST_SIZE], " LZ") == 0);
+    if (length != 5 + 2 * SALT_DIGEST_SIZE && !*p_compression) return -1;
+
+    for (i = 0; i < SALT_DIGEST_SIZE; i++)
     {
-        printf("ERROR in salt_read_and_decrypt_server()\n");
-        assert(ret_msg == SALT_SUCCESS);
-    } 
+        if (sscanf(&message[5 + 2 * i], "%2x", &byte) != 1) return -1;
+        id[i] = (uint8_t) byte;
+    }
 
-    result = salt_write_small_messages(p_channel,
-                                        check_data,
-                                        length_check,
-                                        STATIC_ARRAY);
-    if (result != 1)
+    committed = salt_journal_open(p_journal, file, data_fd, file_size, block_size, id);
+    if (committed < 0) return -1;
+    if (committed > 0) 
     {
-        printf("Failed to send block receipt message\n");
-        assert(result == 1);
-    } 
+        printf("\nResuming the transfer, %d of %u blocks are on the disk\n", committed, p_journal->blocks);
+    }
 
-    return 1;
+    count = salt_journal_missing(p_journal, p_ranges, max_ranges);
+
+    length = (uint32_t) sprintf(message, "RESUME %u", count);
+    for (i = 0; i < 2 * count; i++) 
+    {
+        length += (uint32_t) sprintf(&message[length], " %llu", (unsigned long long) p_ranges[i]);
+    }
+
+    if (salt_write_small_messages(p_channel, (uint8_t *) message, length, STATIC_ARRAY) != 1) return -1;
+
+    return (int) count;
 }
 
 
-uint8_t *loading_file(char *file, 
-                      uint32_t *file_size, 
-                      int my_file)
-{   
+/* Writes the bytes without the salt channel, e.g. the probe of a baudrate */
+static int salt_baudrate_raw_write(salt_io_ctx_t *p_io_ctx, 
+                                   uint8_t *p_data, 
+                                   uint32_t size)
+{
+    salt_io_channel_t channel;
+    salt_ret_t ret;
 
-    FILE *stream;
+    memset(&channel, 0, sizeof(channel));
+    channel.p_context = p_io_ctx;
+    channel.p_data = p_data;
+    channel.size_expected = size;
 
-    int32_t result1, result2;
+    do {
 
-    uint8_t *input;
-    uint32_t expected_size_file,
-             range;
+        ret = my_write(&channel);
+    } while (ret == SALT_PENDING);
 
-    /**
-     * if my_file == 0 -> test file 
-     * if my_file == 1 -> your file 
-     * 
-     * Creating our random test file:
-     * 
-     */
+    return (ret == SALT_SUCCESS) && (salt_io_drain(p_io_ctx) == 0);
+}
 
-    if(!my_file) 
+/* Reads the bytes without the salt channel until the deadline */
+static int salt_baudrate_raw_read(salt_io_ctx_t *p_io_ctx, 
+                                  uint8_t *p_data, 
+                                  uint32_t size, 
+                                  int32_t timeout_ms)
+{
+    salt_io_channel_t channel;
+    salt_ret_t ret;
+    int32_t read_timeout = p_io_ctx->read_timeout;
+    double deadline = wall_time_seconds() + timeout_ms / 1000.0;
+
+    memset(&channel, 0, sizeof(channel));
+    channel.p_context = p_io_ctx;
+    channel.p_data = p_data;
+    channel.size_expected = size;
+    channel.max_size = size;
+
+    salt_io_set_read_timeout(p_io_ctx, timeout_ms);
+    do {
+
+        ret = my_read(&channel);
+    } while (ret == SALT_PENDING && wall_time_seconds() < deadline);
+    salt_io_set_read_timeout(p_io_ctx, read_timeout);
+
+    return (ret == SALT_SUCCESS);
+}
+
+/* 
+ * Both peers switch to new_rate, the client sends the probe and the server 
+ * echoes it if it arrived unchanged, then both return to old_rate. 
+ * The client waits longer, so the server is always ready before it.
+ * A probe which arrived intact fails too if the UART counted overruns or
+ * framing / parity errors meanwhile, the rate is too fast for this host.
+ *
+ * @return 1 probe passed, 0 probe failed, -1 old_rate can not be restored
+ */
+static int salt_baudrate_probe(salt_io_ctx_t *p_io_ctx,
+                               int new_rate,
+                               int old_rate,
+                               const char *mode,
+                               int client)
+{
+    uint8_t probe[SALT_BAUD_PROBE_SIZE], received[SALT_BAUD_PROBE_SIZE];
+    salt_io_stats_t before, after;
+    int settle = client ? 2 * SALT_BAUD_SETTLE : SALT_BAUD_SETTLE, 
+        framing = p_io_ctx->framing, passed = 0, i;
+
+    /* Each byte value once, 37 is coprime with 256 */
+    for (i = 0; i < SALT_BAUD_PROBE_SIZE; i++) probe[i] = (uint8_t) (i * 37 + 11);
+
+    if (salt_io_set_baudrate(p_io_ctx, new_rate, mode) == 0)
     {
-        if ((stream = fopen(file, "wb")) == NULL) 
+        sleep_miliseconds_win_linux(settle);
+        salt_io_discard_input(p_io_ctx);
+        salt_io_get_stats(p_io_ctx, &before);
+
+        /* The probe is raw bytes, not a frame */
+        salt_io_set_framing(p_io_ctx, SALT_IO_FRAMING_NONE);
+
+        if (client)
         {
-            printf("Failed to open create file %s\n", file);
-            exit(0);
+            passed = salt_baudrate_raw_write(p_io_ctx, probe, sizeof(probe)) &&
+                     salt_baudrate_raw_read(p_io_ctx, received, sizeof(received), 
+                                            2 * SALT_BAUD_PROBE_TIMEOUT) &&
+                     memcmp(probe, received, sizeof(probe)) == 0;
         }
-        
-        printf("Creating own file\n");
-      
-        uint32_t i = 0;
-
-        printf("Enter the approximate file size in bytes: \n");
-        if (EOF == scanf("%u", &expected_size_file))
+        else 
         {
-            printf("Oh no man :( bad file size, the program will end.\nPlease turn it on again\n");
+            passed = salt_baudrate_raw_read(p_io_ctx, received, sizeof(received), 
+                                            SALT_BAUD_PROBE_TIMEOUT) &&
+                     memcmp(probe, received, sizeof(probe)) == 0 &&
+                     salt_baudrate_raw_write(p_io_ctx, probe, sizeof(probe));
+        }
+
+        /* Without counters (pty) only the comparison decides */
+        if (passed && salt_io_get_stats(p_io_ctx, &after) && 
+            (after.overruns != before.overruns || 
+             after.buf_overruns != before.buf_overruns ||
+             after.frame_errors != before.frame_errors || 
+             after.parity_errors != before.parity_errors))
+        {
+            printf("Baudrate %d: overruns %u, framing %u, parity %u during the probe\n", 
+                   new_rate, 
+                   (after.overruns - before.overruns) + (after.buf_overruns - before.buf_overruns),
+                   after.frame_errors - before.frame_errors,
+                   after.parity_errors - before.parity_errors);
+            passed = 0;
+        }
+
+        salt_io_set_framing(p_io_ctx, framing);
+    }
+
+    /* The result is sent with the rate which is known to work */
+    if (salt_io_set_baudrate(p_io_ctx, old_rate, mode) != 0) return -1;
+
+    sleep_miliseconds_win_linux(settle);
+    salt_io_discard_input(p_io_ctx);
+
+    return passed;
+}
+
+/* Reads one small message into p_buffer, returns its text ("" if the read failed, no upshift) */
+static char *salt_baudrate_read_message(salt_channel_t *p_channel, 
+                                        uint8_t *p_buffer, 
+                                        uint32_t size_buffer,
+                                        char *p_text,
+                                        uint32_t size_text)
+{
+    salt_msg_t msg_in;
+
+    p_text[0] = '\0';
+    if (salt_read_small_messages(p_channel, p_buffer, size_buffer, &msg_in, NULL, 0) == 1)
+    {
+        salt_message_text(&msg_in, p_text, size_text);
+    }
+
+    return p_text;
+}
+
+int salt_baudrate_upshift_client(salt_channel_t *p_channel,
+                                 salt_io_ctx_t *p_io_ctx,
+                                 int baudrate,
+                                 const char *mode)
+{
+    static const int rates[] = { SALT_BAUDRATES };
+
+    uint8_t message[STATIC_ARRAY], buffer[STATIC_ARRAY];
+    int common[sizeof(rates) / sizeof(rates[0])], count = 0, passed, i;
+    char text[STATIC_ARRAY], *p_text, *p_end;
+    long rate;
+
+    /* The current rate again, it fails on a link without a baudrate */
+    if (salt_io_set_baudrate(p_io_ctx, baudrate, mode) != 0) return baudrate;
+
+    printf("\n******************| Baudrate upshift |*********************\n");
+
+    /* The offer, the rates above the current one */
+    strcpy((char *) message, "BAUD");
+    for (i = 0; i < (int) (sizeof(rates) / sizeof(rates[0])); i++)
+    {
+        if (rates[i] > baudrate) sprintf((char *) message + strlen((char *) message), " %d", rates[i]);
+    }
+    salt_write_small_messages(p_channel, message, strlen((char *) message), STATIC_ARRAY);
+
+    /* The answer, the rates of both ports */
+    p_text = salt_baudrate_read_message(p_channel, buffer, sizeof(buffer), text, sizeof(text));
+    if (strncmp(p_text, "BAUD", 4) != 0) return baudrate;
+
+    p_text += 4;
+    while (count < (int) (sizeof(common) / sizeof(common[0])) && 
+           (rate = strtol(p_text, &p_end, 10)) > 0 && p_end != p_text)
+    {
+        common[count++] = (int) rate;
+        p_text = p_end;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf((char *) message, "TRY %d", common[i]);
+        salt_write_small_messages(p_channel, message, strlen((char *) message), STATIC_ARRAY);
+
+        passed = salt_baudrate_probe(p_io_ctx, common[i], baudrate, mode, 1);
+        if (passed < 0)
+        {
+            printf("The baudrate %d can not be restored\n", baudrate);
+            return baudrate;
+        }
+
+        sprintf((char *) message, "%s %d", passed ? "OK" : "FAIL", common[i]);
+        salt_write_small_messages(p_channel, message, strlen((char *) message), STATIC_ARRAY);
+
+        if (passed && salt_io_set_baudrate(p_io_ctx, common[i], mode) == 0)
+        {
+            sleep_miliseconds_win_linux(2 * SALT_BAUD_SETTLE);
+            printf("Baudrate %d -> %d\n", baudrate, common[i]);
+
+            return common[i];
+        }
+
+        printf("Baudrate %d failed, falling back\n", common[i]);
+    }
+
+    return baudrate;
+}
+
+int salt_baudrate_upshift_server(salt_channel_t *p_channel,
+                                 salt_io_ctx_t *p_io_ctx,
+                                 int baudrate,
+                                 const char *mode)
+{
+    static const int rates[] = { SALT_BAUDRATES };
+
+    uint8_t message[STATIC_ARRAY], buffer[STATIC_ARRAY];
+    int common[sizeof(rates) / sizeof(rates[0])], count = 0, passed, i;
+    char text[STATIC_ARRAY], *p_text, *p_end;
+    long rate;
+
+    /* The client skips a link without a baudrate too */
+    if (salt_io_set_baudrate(p_io_ctx, baudrate, mode) != 0) return baudrate;
+
+    printf("\n******************| Baudrate upshift |*********************\n");
+
+    /* The offer of the client, the rates of this port are kept */
+    p_text = salt_baudrate_read_message(p_channel, buffer, sizeof(buffer), text, sizeof(text));
+    if (strncmp(p_text, "BAUD", 4) != 0) return baudrate;
+
+    strcpy((char *) message, "BAUD");
+    p_text += 4;
+    while ((rate = strtol(p_text, &p_end, 10)) > 0 && p_end != p_text)
+    {
+        for (i = 0; i < (int) (sizeof(rates) / sizeof(rates[0])); i++)
+        {
+            if (rates[i] == rate && rate > baudrate && 
+                count < (int) (sizeof(common) / sizeof(common[0])))
+            {
+                common[count++] = (int) rate;
+                sprintf((char *) message + strlen((char *) message), " %ld", rate);
+            }
+        }
+        p_text = p_end;
+    }
+    salt_write_small_messages(p_channel, message, strlen((char *) message), STATIC_ARRAY);
+
+    /* The client tries the rates in the same order */
+    for (i = 0; i < count; i++)
+    {
+        p_text = salt_baudrate_read_message(p_channel, buffer, sizeof(buffer), text, sizeof(text));
+        if (strncmp(p_text, "TRY ", 4) != 0 || atoi(p_text + 4) != common[i]) return baudrate;
+
+        passed = salt_baudrate_probe(p_io_ctx, common[i], baudrate, mode, 0);
+        if (passed < 0)
+        {
+            printf("The baudrate %d can not be restored\n", baudrate);
+            return baudrate;
+        }
+
+        /* The verdict of the client covers both directions */
+        p_text = salt_baudrate_read_message(p_channel, buffer, sizeof(buffer), text, sizeof(text));
+        if (strncmp(p_text, "OK ", 3) == 0 && salt_io_set_baudrate(p_io_ctx, common[i], mode) == 0)
+        {
+            sleep_miliseconds_win_linux(SALT_BAUD_SETTLE);
+            printf("Baudrate %d -> %d\n", baudrate, common[i]);
+
+            return common[i];
+        }
+
+        printf("Baudrate %d failed, falling back\n", common[i]);
+    }
+
+    return baudrate;
+}
+
+double wall_time_seconds(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+void salt_print_transfer_summary(uint64_t size,
+                                 clock_t cpu_start,
+                                 clock_t cpu_end,
+                                 double wall_elapsed)
+{
+    double cpu_elapsed = (double)(cpu_end - cpu_start) / CLOCKS_PER_SEC,
+           megabytes = (double) size / (1024.0 * 1024.0);
+
+    printf("\n****************** Summary *********************\n");
+    printf("File transfer about size: %llu time took seconds: %0.f\n", (unsigned long long) size, wall_elapsed);
+    printf("CPU time: %.3f s, ", cpu_elapsed);
+    if (size > 0)
+        printf("CPU time per transferred MB: %.3f s\n", cpu_elapsed / megabytes);
+    else
+        printf("nothing was transferred\n");
+
+#if defined(__linux__)
+    {
+        /* System calls of the process which read and write, io_uring needs less of them */
+        FILE *stream = fopen("/proc/self/io", "r");
+        char line[64];
+        unsigned long long syscr = 0, syscw = 0;
+
+        while (stream != NULL && fgets(line, sizeof(line), stream) != NULL)
+        {
+            sscanf(line, "syscr: %llu", &syscr);
+            sscanf(line, "syscw: %llu", &syscw);
+        }
+        if (stream != NULL)
+        {
+            fclose(stream);
+            printf("Read system calls: %llu, write system calls: %llu\n", syscr, syscw);
+        }
+    }
+#endif
+    printf("\n");
+}
+
+void salt_print_line_stats(salt_channel_t *p_channel)
+{
+    salt_io_stats_t *p_stats = salt_io_update_stats(p_channel);
+
+    printf("Line: ");
+    if (p_stats->counters_valid)
+    {
+        printf("rx %u tx %u, overruns %u (buffer %u), framing %u, parity %u, breaks %u, ",
+               p_stats->rx_chars, p_stats->tx_chars, p_stats->overruns, 
+               p_stats->buf_overruns, p_stats->frame_errors, 
+               p_stats->parity_errors, p_stats->breaks);
+    }
+    else
+    {
+        printf("no error counters, ");
+    }
+    printf("queued rx %d tx %d, dropped frames %u, ARQ damaged chunks %u retransmits %u, "
+           "FEC corrected bytes %u uncorrectable codewords %u, "
+           "bonded ports %u lost stripes %u, io_uring calls %u completions %u\n", 
+           p_stats->rx_queue, p_stats->tx_queue, p_stats->dropped_frames,
+           p_stats->damaged_chunks, p_stats->retransmits,
+           p_stats->fec_corrected, p_stats->fec_uncorrectable,
+           p_stats->bond_ports, p_stats->bond_lost,
+           p_stats->uring_calls, p_stats->uring_completions);
+}
+
+uint32_t sleep_miliseconds_win_linux(int sleep_miliseconds)
+{ 
+
+#ifdef _WIN32
+    Sleep(sleep_miliseconds); /* Sleep for sleep_miliseconds - WINDOWS */
+#else
+    usleep(sleep_miliseconds * 1000);  /* - Linux */
+#endif
+
+    return 1;
+}
+
+void salt_window_init(salt_window_t *p_window)
+{
+    p_window->blocks = 0;
+    p_window->acked = 0;
+    p_window->credit = SALT_WINDOW_BLOCKS;
+}
+
+int salt_buffer_pool_init(salt_buffer_pool_t *p_pool, uint32_t size, uint32_t count)
+{
+    uint32_t page;
+
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    page = info.dwPageSize;
+#else
+    page = (uint32_t) sysconf(_SC_PAGESIZE);
+#endif
+    if (count == 0 || count > 32) return -1;
+
+    p_pool->buffer_size = (size + page - 1) / page * page;
+    p_pool->count = count;
+    p_pool->free_mask = (count == 32) ? 0xFFFFFFFF : ((1u << count) - 1);
+
+#if defined(_WIN32)
+    p_pool->p_memory = _aligned_malloc((size_t) p_pool->buffer_size * count, page);
+#else
+    if (posix_memalign((void **) &p_pool->p_memory, page, (size_t) p_pool->buffer_size * count)) 
+        p_pool->p_memory = NULL;
+#endif
+
+    return (p_pool->p_memory == NULL) ? -1 : 0;
+}
+
+uint8_t *salt_buffer_pool_get(salt_buffer_pool_t *p_pool)
+{
+    uint32_t i;
+
+    for (i = 0; i < p_pool->count; i++)
+    {
+        if (p_pool->free_mask & (1u << i))
+        {
+            p_pool->free_mask &= ~(1u << i);
+            return &p_pool->p_memory[(size_t) i * p_pool->buffer_size];
+        }
+    }
+
+    return NULL;
+}
+
+/* Index of the buffer in the pool */
+static uint32_t salt_buffer_pool_index(salt_buffer_pool_t *p_pool, uint8_t *p_buffer)
+{
+    return (uint32_t) ((size_t) (p_buffer - p_pool->p_memory) / p_pool->buffer_size);
+}
+
+void salt_buffer_pool_put(salt_buffer_pool_t *p_pool, uint8_t *p_buffer)
+{
+    p_pool->free_mask |= 1u << salt_buffer_pool_index(p_pool, p_buffer);
+}
+
+void salt_buffer_pool_free(salt_buffer_pool_t *p_pool)
+{
+#if defined(_WIN32)
+    _aligned_free(p_pool->p_memory);
+#else
+    free(p_pool->p_memory);
+#endif
+    p_pool->p_memory = NULL;
+    p_pool->free_mask = 0;
+}
+
+int salt_open_output(const char *file)
+{
+#if defined(_WIN32)
+    return _open(file, _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(file, O_RDWR | O_CREAT, 0644);
+#endif
+}
+
+int salt_preallocate_output(int fd, uint64_t size)
+{
+#if defined(_WIN32)
+    /* The size is set, windows allocates the clusters */
+    if (_filelengthi64(fd) >= (__int64) size) return 0;
+
+    return (_chsize_s(fd, (__int64) size) == 0) ? 0 : -1;
+#else
+    /* A file system without fallocate() only loses the preallocation */
+    return (posix_fallocate(fd, 0, (off_t) size) == ENOSPC) ? -1 : 0;
+#endif
+}
+
+int salt_close_output(int fd)
+{
+#if defined(_WIN32)
+    return _close(fd);
+#else
+    return close(fd);
+#endif
+}
+
+/*
+ * Writes the payload ranges of one block at the offset of the file. 
+ * Adjacent ranges are joined, a short write continues with the rest.
+ *
+ * @return 0 in case success, -1 in case of error
+ */
+static int salt_write_ranges(int fd, uint8_t **pp_data, uint32_t *p_sizes, int count, uint64_t offset)
+{
+#if defined(_WIN32)
+    int i, written;
+    uint32_t done;
+
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        for (done = 0; done < p_sizes[i]; done += (uint32_t) written)
+        {
+            written = _write(fd, &pp_data[i][done], p_sizes[i] - done);
+            if (written <= 0) return -1;
+        }
+    }
+#else
+    struct iovec iov[SALT_WRITER_IOV];
+    int i, first = 0;
+    ssize_t written;
+
+    for (i = 0; i < count; i++)
+    {
+        iov[i].iov_base = pp_data[i];
+        iov[i].iov_len = p_sizes[i];
+    }
+
+    while (first < count)
+    {
+        written = pwritev(fd, &iov[first], count - first, (off_t) offset);
+        if (written < 0) return -1;
+
+        offset += (uint64_t) written;
+
+        /* Skip the written ranges, the rest of a partly written one stays */
+        while (first < count && (size_t) written >= iov[first].iov_len)
+        {
+            written -= (ssize_t) iov[first].iov_len;
+            first++;
+        }
+        if (first < count)
+        {
+            iov[first].iov_base = (uint8_t *) iov[first].iov_base + written;
+            iov[first].iov_len -= (size_t) written;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+/* ====== Journal of the received blocks ======= */
+
+#define SALT_JOURNAL_MAGIC      "SALTJRN2"
+
+/* Header of the journal, the records of the blocks follow it */
+typedef struct salt_journal_header_s
+{
+    char        magic[8];
+    uint64_t    file_size;
+    uint32_t    block_size;
+    uint8_t     id[SALT_DIGEST_SIZE];       /**< Id of the file, see salt_source_id(). */
+    uint32_t    crc;                        /**< CRC32C of the fields above. */
+} salt_journal_header_t;
+
+/* fdatasync(), the data must be on the disk before its record */
+static int salt_sync_file(int fd)
+{
+#if defined(_WIN32)
+    return _commit(fd);
+#else
+    return fdatasync(fd);
+#endif
+}
+
+static int salt_truncate_file(int fd, uint64_t size)
+{
+#if defined(_WIN32)
+    return (_chsize_s(fd, size) == 0) ? 0 : -1;
+#else
+    return ftruncate(fd, (off_t) size);
+#endif
+}
+
+/* Reads size bytes at the offset, a short read is an error */
+static int salt_read_at(int fd, uint8_t *p_data, uint32_t size, uint64_t offset)
+{
+    uint32_t done;
+#if defined(_WIN32)
+    int n;
+
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) return -1;
+
+    for (done = 0; done < size; done += (uint32_t) n)
+    {
+        n = _read(fd, &p_data[done], size - done);
+        if (n <= 0) return -1;
+    }
+#else
+    ssize_t n;
+
+    for (done = 0; done < size; done += (uint32_t) n)
+    {
+        n = pread(fd, &p_data[done], size - done, (off_t) offset + done);
+        if (n <= 0) return -1;
+    }
+#endif
+
+    return 0;
+}
+
+/* Writes size bytes at the offset */
+static int salt_write_at(int fd, const uint8_t *p_data, uint32_t size, uint64_t offset)
+{
+    uint8_t *p_bytes = (uint8_t *) p_data;
+
+    return salt_write_ranges(fd, &p_bytes, &size, 1, offset);
+}
+
+/* First SALT_DIGEST_SIZE bytes of the SHA-512 */
+static void salt_digest(const uint8_t *p_data, uint32_t size, uint8_t *p_digest)
+{
+    uint8_t hash[api_crypto_hash_sha512_BYTES];
+
+    api_crypto_hash_sha512(hash, p_data, size);
+    memcpy(p_digest, hash, SALT_DIGEST_SIZE);
+}
+
+int salt_journal_open(salt_journal_t *p_journal, 
+                      const char *file,
+                      int data_fd,
+                      uint64_t file_size, 
+                      uint32_t block_size,
+                      const uint8_t *p_id)
+{
+    salt_journal_header_t header, stored;
+    salt_journal_record_t record;
+    uint8_t digest[SALT_DIGEST_SIZE], *p_block;
+    uint64_t expected;
+    uint32_t length;
+    int committed = 0;
+
+    /* The index of a block is 32-bit in the records */
+    if (block_size == 0 || (file_size + block_size - 1) / block_size >= 0xFFFFFFFF) return -1;
+
+    snprintf(p_journal->name, sizeof(p_journal->name), "%s.journal", file);
+    p_journal->data_fd = data_fd;
+    p_journal->file_size = file_size;
+    p_journal->block_size = block_size;
+    p_journal->blocks = (uint32_t) ((file_size + block_size - 1) / block_size);
+    p_journal->pending = 0;
+    p_journal->pending_bytes = 0;
+    p_journal->failed = 0;
+    salt_journal_set_budget(p_journal, SALT_SYNC_BYTES, SALT_SYNC_MS);
+    memset(p_journal->queued, 0, sizeof(p_journal->queued));
+
+#if defined(_WIN32)
+    p_journal->fd = _open(p_journal->name, _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    p_journal->fd = open(p_journal->name, O_RDWR | O_CREAT, 0644);
+#endif
+    p_journal->p_done = calloc(p_journal->blocks + 1, 1);
+    p_block = malloc(block_size);
+    if (p_journal->fd < 0 || p_journal->p_done == NULL || p_block == NULL)
+    {
+        free(p_block);
+        salt_journal_close(p_journal, 0);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SALT_JOURNAL_MAGIC, sizeof(header.magic));
+    header.file_size = file_size;
+    header.block_size = block_size;
+    memcpy(header.id, p_id, SALT_DIGEST_SIZE);
+    header.crc = salt_io_crc32c(0, (const uint8_t *) &header, offsetof(salt_journal_header_t, crc));
+
+    length = sizeof(header);
+    if (salt_read_at(p_journal->fd, (uint8_t *) &stored, sizeof(stored), 0) == 0 &&
+        memcmp(&stored, &header, sizeof(header)) == 0)
+    {
+        /* 
+         * The records up to the first torn one, a block is kept only 
+         * if the data on the disk still has its digest
+         */
+        while (salt_read_at(p_journal->fd, (uint8_t *) &record, sizeof(record), length) == 0 &&
+               record.crc == salt_io_crc32c(0, (const uint8_t *) &record, offsetof(salt_journal_record_t, crc)))
+        {
+            length += sizeof(record);
+            if (record.block >= p_journal->blocks || p_journal->p_done[record.block]) continue;
+
+            expected = file_size - (uint64_t) record.block * block_size;
+            if (expected > block_size) expected = block_size;
+
+            if (record.size != expected ||
+                salt_read_at(data_fd, p_block, record.size, (uint64_t) record.block * block_size) != 0) continue;
+
+            salt_digest(p_block, record.size, digest);
+            if (memcmp(digest, record.digest, SALT_DIGEST_SIZE) == 0)
+            {
+                p_journal->p_done[record.block] = 1;
+                committed++;
+            }
+        }
+    }
+    else
+    {
+        /* Another file, the received data and the journal start empty */
+        if (salt_truncate_file(data_fd, 0) != 0 || salt_truncate_file(p_journal->fd, 0) != 0 ||
+            salt_write_at(p_journal->fd, (const uint8_t *) &header, sizeof(header), 0) != 0 ||
+            salt_sync_file(data_fd) != 0 || salt_sync_file(p_journal->fd) != 0)
+        {
+            committed = -1;
+        }
+    }
+    free(p_block);
+
+    /* The next records follow the last complete one */
+    if (committed < 0 || salt_truncate_file(p_journal->fd, length) != 0)
+    {
+        salt_journal_close(p_journal, 0);
+        return -1;
+    }
+    p_journal->length = length;
+
+    return committed;
+}
+
+void salt_journal_set_budget(salt_journal_t *p_journal, uint64_t sync_bytes, uint32_t sync_ms)
+{
+    p_journal->sync_bytes = sync_bytes;
+    p_journal->sync_ms = sync_ms;
+}
+
+int salt_journal_add(salt_journal_t *p_journal, const salt_journal_record_t *p_record)
+{
+    salt_journal_record_t *p_next;
+
+    /* The batch of a failed commit stays pending, the journal takes no more records */
+    if (p_journal->failed) return -1;
+    if (p_journal->pending >= SALT_JOURNAL_BATCH && salt_journal_commit(p_journal) != 0) return -1;
+
+    p_next = &p_journal->batch[p_journal->pending++];
+    if (p_journal->pending == 1) p_journal->pending_since = wall_time_seconds();
+    *p_next = *p_record;
+    p_next->crc = salt_io_crc32c(0, (const uint8_t *) p_next, offsetof(salt_journal_record_t, crc));
+    p_journal->pending_bytes += p_record->size;
+
+    if (p_journal->pending == SALT_JOURNAL_BATCH || p_journal->pending_bytes >= p_journal->sync_bytes ||
+        (wall_time_seconds() - p_journal->pending_since) * 1000.0 >= p_journal->sync_ms)
+    {
+        return salt_journal_commit(p_journal);
+    }
+
+    return 0;
+}
+
+int salt_journal_commit(salt_journal_t *p_journal)
+{
+    uint32_t i, size = p_journal->pending * sizeof(salt_journal_record_t);
+
+    if (p_journal->failed) return -1;
+    if (p_journal->pending == 0) return 0;
+
+    if (salt_sync_file(p_journal->data_fd) != 0 ||
+        salt_write_at(p_journal->fd, (const uint8_t *) p_journal->batch, size, p_journal->length) != 0 ||
+        salt_sync_file(p_journal->fd) != 0)
+    {
+        p_journal->failed = 1;
+        return -1;
+    }
+    p_journal->length += size;
+
+    for (i = 0; i < p_journal->pending; i++) p_journal->p_done[p_journal->batch[i].block] = 1;
+    p_journal->pending = 0;
+    p_journal->pending_bytes = 0;
+
+    return 0;
+}
+
+uint32_t salt_journal_missing(salt_journal_t *p_journal, uint64_t *p_ranges, uint32_t max_ranges)
+{
+    uint32_t block, count = 0;
+    uint64_t begin, end;
+
+    for (block = 0; block < p_journal->blocks; block++)
+    {
+        if (p_journal->p_done[block]) continue;
+
+        begin = (uint64_t) block * p_journal->block_size;
+        end = (p_journal->file_size - begin > p_journal->block_size) ? 
+                begin + p_journal->block_size : p_journal->file_size;
+
+        if (count > 0 && p_ranges[2 * count - 1] == begin)
+        {
+            p_ranges[2 * count - 1] = end;
+        }
+        else if (count == max_ranges)
+        {
+            /* The rest goes as the last range */
+            p_ranges[2 * count - 1] = p_journal->file_size;
+            break;
+        }
+        else
+        {
+            p_ranges[2 * count] = begin;
+            p_ranges[2 * count + 1] = end;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void salt_journal_close(salt_journal_t *p_journal, int complete)
+{
+    if (p_journal->fd >= 0)
+    {
+        salt_journal_commit(p_journal);
+#if defined(_WIN32)
+        _close(p_journal->fd);
+        if (complete) _unlink(p_journal->name);
+#else
+        close(p_journal->fd);
+        if (complete) unlink(p_journal->name);
+#endif
+    }
+    p_journal->fd = -1;
+
+    free(p_journal->p_done);
+    p_journal->p_done = NULL;
+}
+
+int salt_buffer_written(salt_buffer_pool_t *p_pool, salt_journal_t *p_journal, uint8_t *p_buffer)
+{
+    uint32_t i = salt_buffer_pool_index(p_pool, p_buffer);
+    int ret = 0;
+
+    if (p_journal != NULL && p_journal->queued[i].size > 0)
+    {
+        ret = salt_journal_add(p_journal, &p_journal->queued[i]);
+        p_journal->queued[i].size = 0;
+    }
+    salt_buffer_pool_put(p_pool, p_buffer);
+
+    return ret;
+}
+
+/* 
+ * Writes the ranges by pwritev() or submits them to the io_uring of the link,
+ * the rest of the buffer follows by salt_writer_submit().
+ */
+static int salt_store_ranges(salt_io_uring_t *p_uring, int fd, uint8_t **pp_data, uint32_t *p_sizes,
+                             int count, uint64_t offset, uint8_t *p_buffer)
+{
+    if (p_uring == NULL) return salt_write_ranges(fd, pp_data, p_sizes, count, offset);
+
+    return salt_io_uring_write_file(p_uring, fd, pp_data, p_sizes, count, offset, p_buffer, 0);
+}
+
+/* ====== Writer of the received file ======= */
+
+#if !defined(_WIN32)
+/* 
+ * Waits for a job, with the pending blocks of the journal only until 
+ * their time budget ends, then they are committed.
+ */
+static void salt_writer_wait(salt_writer_t *p_writer)
+{
+    salt_journal_t *p_journal = p_writer->p_journal;
+    struct timespec deadline;
+    double at;
+    int failed;
+
+    if (p_journal == NULL || p_journal->pending == 0)
+    {
+        pthread_cond_wait(&p_writer->cond, &p_writer->lock);
+        return;
+    }
+
+    at = p_journal->pending_since + p_journal->sync_ms / 1000.0;
+    if (at > wall_time_seconds())
+    {
+        /* wall_time_seconds() is the time of CLOCK_REALTIME of the condition */
+        deadline.tv_sec = (time_t) at;
+        deadline.tv_nsec = (long) ((at - (double) deadline.tv_sec) * 1e9);
+        if (pthread_cond_timedwait(&p_writer->cond, &p_writer->lock, &deadline) == 0) return;
+    }
+
+    pthread_mutex_unlock(&p_writer->lock);
+    failed = salt_journal_commit(p_journal);
+    pthread_mutex_lock(&p_writer->lock);
+    p_writer->failed |= (failed != 0);
+}
+
+static void *salt_writer_main(void *p_arg)
+{
+    salt_writer_t *p_writer = (salt_writer_t *) p_arg;
+    salt_writer_job_t *p_job;
+    uint8_t *pp_data[SALT_WRITER_IOV];
+    uint32_t sizes[SALT_WRITER_IOV], first, last;
+    uint64_t offset, end;
+    int count, failed, i;
+
+    pthread_mutex_lock(&p_writer->lock);
+    for (;;)
+    {
+        while (p_writer->head == p_writer->tail && !p_writer->stop) salt_writer_wait(p_writer);
+        if (p_writer->head == p_writer->tail) break;
+
+        /* The queued blocks which follow each other in the file go by one pwritev() */
+        first = p_writer->tail;
+        offset = end = p_writer->jobs[first % SALT_RX_POOL_COUNT].offset;
+        count = 0;
+        for (last = first; last != p_writer->head; last++)
+        {
+            p_job = &p_writer->jobs[last % SALT_RX_POOL_COUNT];
+            if (p_job->offset != end || count + p_job->count > SALT_WRITER_IOV) break;
+
+            for (i = 0; i < p_job->count; i++)
+            {
+                pp_data[count] = p_job->p_ranges[i];
+                sizes[count++] = p_job->sizes[i];
+                end += p_job->sizes[i];
+            }
+        }
+        pthread_mutex_unlock(&p_writer->lock);
+
+        failed = (count > 0 && salt_write_ranges(p_writer->fd, pp_data, sizes, count, offset) != 0);
+        for (i = (int) first; !failed && i != (int) last; i++)
+        {
+            p_job = &p_writer->jobs[(uint32_t) i % SALT_RX_POOL_COUNT];
+            if (p_writer->p_journal != NULL && p_job->record.size > 0)
+                failed = (salt_journal_add(p_writer->p_journal, &p_job->record) != 0);
+        }
+
+        pthread_mutex_lock(&p_writer->lock);
+        for (; first != last; first++)
+        {
+            salt_buffer_pool_put(p_writer->p_pool, p_writer->jobs[first % SALT_RX_POOL_COUNT].p_buffer);
+        }
+        p_writer->tail = last;
+        p_writer->failed |= failed;
+        pthread_cond_broadcast(&p_writer->cond);
+    }
+    pthread_mutex_unlock(&p_writer->lock);
+
+    return NULL;
+}
+#endif
+
+int salt_writer_start(salt_writer_t *p_writer, 
+                      int fd, 
+                      salt_buffer_pool_t *p_pool,
+                      salt_journal_t *p_journal,
+                      salt_io_uring_t *p_uring)
+{
+    if (p_pool->count > SALT_RX_POOL_COUNT) return -1;
+
+    p_writer->fd = fd;
+    p_writer->p_pool = p_pool;
+    p_writer->p_journal = p_journal;
+    p_writer->p_uring = p_uring;
+    p_writer->head = p_writer->tail = 0;
+    p_writer->running = 0;
+    p_writer->stop = 0;
+    p_writer->failed = 0;
+
+#if !defined(_WIN32)
+    /* The writes of the io_uring do not block the protocol thread either */
+    if (p_uring != NULL) return 0;
+
+    if (pthread_mutex_init(&p_writer->lock, NULL) != 0) return -1;
+    if (pthread_cond_init(&p_writer->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&p_writer->lock);
+        return -1;
+    }
+    if (pthread_create(&p_writer->thread, NULL, salt_writer_main, p_writer) != 0)
+    {
+        printf("unable to create the writer thread\n");
+        pthread_cond_destroy(&p_writer->cond);
+        pthread_mutex_destroy(&p_writer->lock);
+        return -1;
+    }
+    p_writer->running = 1;
+#endif
+
+    return 0;
+}
+
+uint8_t *salt_writer_buffer(salt_writer_t *p_writer)
+{
+    uint8_t *p_buffer, *p_written;
+    int failed = 0;
+
+#if !defined(_WIN32)
+    if (p_writer->running)
+    {
+        pthread_mutex_lock(&p_writer->lock);
+        while (p_writer->p_pool->free_mask == 0 && !p_writer->failed)
+        {
+            pthread_cond_wait(&p_writer->cond, &p_writer->lock);
+        }
+        p_buffer = p_writer->failed ? NULL : salt_buffer_pool_get(p_writer->p_pool);
+        pthread_mutex_unlock(&p_writer->lock);
+
+        return p_buffer;
+    }
+#endif
+
+    /* Buffers whose writes finished return to the pool, without a free one it waits for them */
+    while (p_writer->p_uring != NULL && (p_written = salt_io_uring_file_done(p_writer->p_uring, 0)) != NULL)
+    {
+        failed |= salt_buffer_written(p_writer->p_pool, p_writer->p_journal, p_written);
+    }
+    p_buffer = salt_buffer_pool_get(p_writer->p_pool);
+    while (p_buffer == NULL && p_writer->p_uring != NULL && 
+           (p_written = salt_io_uring_file_done(p_writer->p_uring, 1)) != NULL)
+    {
+        failed |= salt_buffer_written(p_writer->p_pool, p_writer->p_journal, p_written);
+        p_buffer = salt_buffer_pool_get(p_writer->p_pool);
+    }
+
+    p_writer->failed |= failed;
+    if (p_writer->failed && p_buffer != NULL)
+    {
+        salt_buffer_pool_put(p_writer->p_pool, p_buffer);
+        p_buffer = NULL;
+    }
+
+    return p_buffer;
+}
+
+int salt_writer_submit(salt_writer_t *p_writer,
+                       uint8_t *p_buffer,
+                       uint8_t **pp_data,
+                       const uint32_t *p_sizes,
+                       int count,
+                       uint64_t offset,
+                       const salt_journal_record_t *p_record,
+                       int queued)
+{
+    uint32_t index = salt_buffer_pool_index(p_writer->p_pool, p_buffer);
+    int ret = 0;
+
+#if !defined(_WIN32)
+    if (p_writer->running)
+    {
+        salt_writer_job_t *p_job;
+
+        pthread_mutex_lock(&p_writer->lock);
+
+        /* A buffer without data returns at once, it does not wait behind the queued writes */
+        if (count == 0 && p_record == NULL)
+        {
+            salt_buffer_pool_put(p_writer->p_pool, p_buffer);
+            ret = p_writer->failed ? -1 : 0;
+            pthread_cond_broadcast(&p_writer->cond);
+            pthread_mutex_unlock(&p_writer->lock);
+
+            return ret;
+        }
+
+        p_job = &p_writer->jobs[p_writer->head % SALT_RX_POOL_COUNT];
+        p_job->p_buffer = p_buffer;
+        memcpy(p_job->p_ranges, pp_data, (size_t) count * sizeof(uint8_t *));
+        memcpy(p_job->sizes, p_sizes, (size_t) count * sizeof(uint32_t));
+        p_job->count = count;
+        p_job->offset = offset;
+        if (p_record != NULL) p_job->record = *p_record;
+        else p_job->record.size = 0;
+        p_writer->head++;
+        ret = p_writer->failed ? -1 : 0;
+        pthread_cond_broadcast(&p_writer->cond);
+        pthread_mutex_unlock(&p_writer->lock);
+
+        return ret;
+    }
+#endif
+
+    /* The last call of the buffer, also after its writes by salt_store_ranges() */
+    if (p_writer->p_uring != NULL && (count > 0 || queued))
+    {
+        ret = salt_io_uring_write_file(p_writer->p_uring, p_writer->fd, pp_data, p_sizes, count, 
+                                       offset, p_buffer, 1);
+        queued = 1;
+    }
+    else if (count > 0) ret = salt_write_ranges(p_writer->fd, pp_data, (uint32_t *) p_sizes, count, offset);
+
+    /* The block is journaled when its data is written, see salt_buffer_written() */
+    if (queued)
+    {
+        if (ret == 0 && p_record != NULL && p_writer->p_journal != NULL) p_writer->p_journal->queued[index] = *p_record;
+    }
+    else
+    {
+        if (ret == 0 && p_record != NULL && p_writer->p_journal != NULL) ret = salt_journal_add(p_writer->p_journal, p_record);
+        salt_buffer_pool_put(p_writer->p_pool, p_buffer);
+    }
+    p_writer->failed |= (ret != 0);
+
+    return ret;
+}
+
+/* Free buffers of the pool, under the lock of the thread */
+static uint32_t salt_writer_count_free(salt_writer_t *p_writer)
+{
+    uint32_t i, count = 0;
+
+    for (i = 0; i < p_writer->p_pool->count; i++)
+    {
+        if (p_writer->p_pool->free_mask & (1u << i)) count++;
+    }
+
+    return count;
+}
+
+uint32_t salt_writer_free(salt_writer_t *p_writer)
+{
+    uint32_t count;
+
+#if !defined(_WIN32)
+    if (p_writer->running) pthread_mutex_lock(&p_writer->lock);
+#endif
+    count = salt_writer_count_free(p_writer);
+#if !defined(_WIN32)
+    if (p_writer->running) pthread_mutex_unlock(&p_writer->lock);
+#endif
+
+    return count;
+}
+
+uint32_t salt_writer_wait_free(salt_writer_t *p_writer, uint32_t count)
+{
+    uint8_t *p_written;
+    uint32_t free_buffers;
+
+#if !defined(_WIN32)
+    if (p_writer->running)
+    {
+        /* salt_writer_main() signals the buffers it returns to the pool */
+        pthread_mutex_lock(&p_writer->lock);
+        while ((free_buffers = salt_writer_count_free(p_writer)) < count && !p_writer->failed)
+        {
+            pthread_cond_wait(&p_writer->cond, &p_writer->lock);
+        }
+        if (p_writer->failed) free_buffers = 0;
+        pthread_mutex_unlock(&p_writer->lock);
+
+        return free_buffers;
+    }
+#endif
+
+    while ((free_buffers = salt_writer_count_free(p_writer)) < count && !p_writer->failed &&
+           p_writer->p_uring != NULL && (p_written = salt_io_uring_file_done(p_writer->p_uring, 1)) != NULL)
+    {
+        p_writer->failed |= (salt_buffer_written(p_writer->p_pool, p_writer->p_journal, p_written) != 0);
+    }
+
+    return p_writer->failed ? 0 : free_buffers;
+}
+
+int salt_writer_finish(salt_writer_t *p_writer)
+{
+    uint8_t *p_written;
+
+#if !defined(_WIN32)
+    if (p_writer->running)
+    {
+        /* The thread writes the rest of the queue and ends */
+        pthread_mutex_lock(&p_writer->lock);
+        p_writer->stop = 1;
+        pthread_cond_broadcast(&p_writer->cond);
+        pthread_mutex_unlock(&p_writer->lock);
+
+        pthread_join(p_writer->thread, NULL);
+        pthread_cond_destroy(&p_writer->cond);
+        pthread_mutex_destroy(&p_writer->lock);
+        p_writer->running = 0;
+    }
+#endif
+
+    /* The writes of the last blocks may still be in the ring */
+    while (p_writer->p_uring != NULL && (p_written = salt_io_uring_file_done(p_writer->p_uring, 1)) != NULL)
+    {
+        if (salt_buffer_written(p_writer->p_pool, p_writer->p_journal, p_written) != 0) p_writer->failed = 1;
+    }
+    if (p_writer->p_uring != NULL && p_writer->p_uring->file_failed) p_writer->failed = 1;
+
+    /* The data is on the disk before the last records */
+    if (p_writer->p_journal != NULL && salt_journal_commit(p_writer->p_journal) != 0) p_writer->failed = 1;
+
+    return p_writer->failed ? -1 : 0;
+}
+
+uint32_t salt_read_and_decrypt_server(salt_channel_t *p_channel,
+                                        salt_writer_t *p_writer,
+                                        salt_msg_t *p_msg,
+                                        uint64_t *p_decrypt_size,
+                                        uint64_t expected_size,
+                                        salt_window_t *p_window,
+                                        int compression)
+{
+
+    /*
+     * typedef enum
+     * which can obtain values:
+     * SALT_SUCCESS, SALT_PENDING, SALT_ERROR            
+     */
+    salt_ret_t ret_msg;
+
+    /* Variables for confirm message */
+    uint32_t result, length_check, credit, free_buffers, reserve;
+
+    uint8_t check_data[STATIC_ARRAY];
+
+    /* Payload ranges of the block in the receive buffer */
+    uint8_t *p_ranges[SALT_WRITE_IOV];
+    uint32_t range_sizes[SALT_WRITE_IOV];
+    uint64_t offset = *p_decrypt_size, begin = *p_decrypt_size;
+    int ranges = 0, failed = 0, queued = 0, damaged = 0;
+    uint8_t *p_buffer, *p_payload;
+    salt_journal_t *p_journal = p_writer->p_journal;
+
+    /* Buffer of the decompressed blocks, NULL without the compression */
+    uint8_t *p_plain = NULL;
+    uint32_t plain_size = 0, length;
+
+    /* Record of the block for the journal, the digest is made of the payloads */
+    salt_journal_record_t record, *p_record = NULL;
+    uint64_t hash_state[(api_crypto_hash_sha512_state_size + 7) / 8];
+    uint8_t hash[api_crypto_hash_sha512_BYTES];
+
+    /* The writer takes the buffer of the previous block, the disk is not waited for */
+    p_buffer = salt_writer_buffer(p_writer);
+    if (p_buffer == NULL)
+    {
+        printf("Failed to write the received data\n");
+        return 0;
+    }
+    if (compression && (p_plain = salt_writer_buffer(p_writer)) == NULL)
+    {
+        salt_writer_submit(p_writer, p_buffer, NULL, NULL, 0, offset, NULL, 0);
+        printf("Failed to write the received data\n");
+        return 0;
+    }
+
+    printf("\n******| Data reception and decryption with Salt channel |********\n");
+
+    /**
+    * Reads one or multiple encrypted message.
+    *
+    * The actual I/O operation of the read process.
+    *
+    * @param p_channel:
+    * Pointer to salt channel handle.
+    * @param p_buffer:      
+    * Pointer where to store received (clear text) data.
+    * @param size_buffer:   
+    * Size of p_buffer, must be greater or equal to SALT_READ_OVERHEAD_SIZE.
+    * @param p_msg:         
+    * Pointer to message structure to use when reading the message.
+    *
+    *
+    * @return SALT_SUCCESS A message was successfully received.
+    * @return SALT_PENDING The receive process is still pending.
+    * @return SALT_ERROR   If any error occured during the read. If this occured, the session is considered
+    *                      closed and a new handshake must be performed. I.e., the session must be initated
+    *                      and then a handshake.
+    */
+    do 
+    {
+
+        ret_msg = salt_read_begin(p_channel, p_buffer, p_writer->p_pool->buffer_size, p_msg);
+    } while (ret_msg == SALT_PENDING);
+
+    /**
+    * Used to read messages recevied.
+    *
+    * Used to read single or multiple application packages. Due to encryption overhead
+    * the longest clear text message that can be received is SALT_READ_OVERHEAD_SIZE smaller
+    * than the provided receive buffer.
+    *
+    * @param msg_in     Pointer to message structure.
+    *
+    * @return SALT_SUCCESS The next message could be parsed and ready to be read.
+    * @return SALT_ERROR   No more messages available.
+    *
+    * Read message structure:
+    * typedef union salt_msg_u {
+    *  struct {
+    *      uint8_t     *p_buffer;          < Message buffer. 
+    *      uint8_t     *p_payload;         < Pointer to current message. 
+    *      uint32_t    buffer_size;        < Message buffer size. 
+    *      uint32_t    buffer_used;        < Index of how many bytes have been processed. 
+    *      uint16_t    messages_left;      < Number of messages left to read. 
+    *      uint32_t    message_size;       < Current message size. 
+    *  } read;
+    * } salt_msg_t;
+    * 
+    */
+    if (ret_msg == SALT_SUCCESS)     
+    {   
+        printf("\nRecevied %d BLOCK/BLOCKS:\n\n", ++p_msg->read.messages_left);
+
+        if (p_journal != NULL) api_crypto_hash_sha512_init((uint8_t *) hash_state, sizeof(hash_state));
+            
+        do 
+        {
+            p_payload = p_msg->read.p_payload;
+            length = p_msg->read.message_size;
+
+            /* A compressed block is decoded behind the previous ones, they make one range */
+            if (p_plain != NULL)
+            {
+                if (salt_decompress_block(p_payload, length, &p_plain[plain_size], 
+                                          p_writer->p_pool->buffer_size - plain_size, &length) != 0)
+                {
+                    damaged = failed = 1;
+                    break;
+                }
+                p_payload = &p_plain[plain_size];
+                plain_size += length;
+            }
+
+            *p_decrypt_size += length;
+            if (p_journal != NULL) 
+            {
+                api_crypto_hash_sha512_update((uint8_t *) hash_state, p_payload, length);
+            }
+
+            /* The payloads are decrypted in place, they are only referenced */
+            if (ranges > 0 && 
+                p_ranges[ranges - 1] + range_sizes[ranges - 1] == p_payload)
+            {
+                range_sizes[ranges - 1] += length;
+            }
+            else
+            {
+                if (ranges == SALT_WRITE_IOV)
+                {
+                    if ((failed = salt_store_ranges(p_writer->p_uring, p_writer->fd, p_ranges, range_sizes, 
+                                                    ranges, offset, p_buffer))) break;
+                    queued |= (p_writer->p_uring != NULL);
+                    while (ranges > 0) offset += range_sizes[--ranges];
+                }
+                p_ranges[ranges] = p_payload;
+                range_sizes[ranges++] = length;
+            }
+        } while (salt_read_next(p_msg) == SALT_SUCCESS);
+
+        /* The block is journaled by the writer when its data is written */
+        if (p_journal != NULL && *p_decrypt_size > begin && !failed)
+        {
+            api_crypto_hash_sha512_final((uint8_t *) hash_state, hash);
+            record.block = (uint32_t) (begin / p_journal->block_size);
+            record.size = (uint32_t) (*p_decrypt_size - begin);
+            memcpy(record.digest, hash, SALT_DIGEST_SIZE);
+            p_record = &record;
+        }
+
+        /* The data is in the buffer of the decompressed blocks, the received one is free */
+        if (p_plain != NULL)
+        {
+            if (salt_writer_submit(p_writer, p_buffer, NULL, NULL, 0, offset, NULL, 0) != 0) failed = 1;
+            p_buffer = p_plain;
+            p_plain = NULL;
+        }
+
+        /* The buffer belongs to the writer now, the next frame is read at once */
+        if (salt_writer_submit(p_writer, p_buffer, p_ranges, range_sizes, failed ? 0 : ranges, 
+                               offset, p_record, queued) != 0 || failed)
+        {
+            if (damaged) printf("Damaged compressed block at %llu\n", (unsigned long long) begin);
+            else printf("Failed to write the received data\n");
+            return 0;
+        }
+        p_buffer = NULL;
+    } else if (ret_msg == SALT_ERROR)
+    {
+        printf("ERROR in salt_read_and_decrypt_server()\n");
+        salt_print_line_stats(p_channel);
+    } 
+
+    /* Nothing was received into the buffers */
+    if (p_plain != NULL && salt_writer_submit(p_writer, p_plain, NULL, NULL, 0, offset, NULL, 0) != 0) return 0;
+    if (p_buffer != NULL && salt_writer_submit(p_writer, p_buffer, NULL, NULL, 0, offset, NULL, 0) != 0) return 0;
+
+    /* The session is lost, the journal keeps the written blocks for the next run of the client */
+    if (ret_msg == SALT_ERROR) return 0;
+
+    /* The sender waits only when its credit is used up */
+    p_window->blocks++;
+    if (p_window->blocks - p_window->acked < 
+            ((p_window->credit < SALT_ACK_EVERY) ? p_window->credit : SALT_ACK_EVERY) &&
+        *p_decrypt_size < expected_size)
+    {
+        return 1;
+    }
+
+    /* The credit is the free buffers, one stays for the decompression of the next block */
+    reserve = compression ? 1 : 0;
+    free_buffers = salt_writer_free(p_writer);
+    for (;;)
+    {
+        credit = (free_buffers > reserve) ? free_buffers - reserve : 0;
+        if (credit > SALT_WINDOW_BLOCKS) credit = SALT_WINDOW_BLOCKS;
+
+        sprintf((char *)check_data, "ACK %u %u", p_window->blocks, credit);
+        length_check = strlen((char *)check_data);
+
+        result = salt_write_small_messages(p_channel,
+                                            check_data,
+                                            length_check,
+                                            STATIC_ARRAY);
+        if (result != 1)
+        {
+            printf("Failed to send block receipt message\n");
+            return 0;
+        } 
+        p_window->acked = p_window->blocks;
+        p_window->credit = credit;
+
+        /* 
+         * With the credit 0 the sender stops, so no frame waits in the port 
+         * while the disk is behind. The next ACK opens the window when the 
+         * writer frees a buffer.
+         */
+        if (credit > 0 || *p_decrypt_size >= expected_size) break;
+        free_buffers = salt_writer_wait_free(p_writer, reserve + 1);
+        if (free_buffers <= reserve)
+        {
+            printf("Failed to write the received data\n");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/*
+ * Reads the buffer from the offset, the rest of the file or a window. 
+ * Ahead it is only started: by the io_uring, or the kernel is asked to 
+ * read the pages and the buffer is read by salt_source_wait().
+ */
+static int salt_source_fill(salt_file_source_t *p_source, int buffer, uint64_t offset, int ahead)
+{
+    uint32_t length = p_source->window;
+
+    if (offset >= p_source->size) length = 0;
+    else if (p_source->size - offset < length) length = (uint32_t) (p_source->size - offset);
+    p_source->offsets[buffer] = offset;
+    p_source->lengths[buffer] = length;
+    if (length == 0) return 0;
+
+    if (ahead)
+    {
+        p_source->reading = 1;
+        if (p_source->p_uring != NULL)
+            return salt_io_uring_read_file(p_source->p_uring, p_source->fd, p_source->p_buffers[buffer], 
+                                           length, offset, p_source);
+#if !defined(_WIN32)
+        posix_fadvise(p_source->fd, (off_t) offset, (off_t) length, POSIX_FADV_WILLNEED);
+#endif
+        return 0;
+    }
+
+    if (p_source->p_uring != NULL)
+        return salt_io_uring_read_file(p_source->p_uring, p_source->fd, p_source->p_buffers[buffer], 
+                                       length, offset, NULL);
+
+    return salt_read_at(p_source->fd, p_source->p_buffers[buffer], length, offset);
+}
+
+/* Waits for the buffer read ahead */
+static int salt_source_wait(salt_file_source_t *p_source)
+{
+    int other = 1 - p_source->current;
+    void *p_owner;
+
+    if (!p_source->reading) return 0;
+    p_source->reading = 0;
+
+    if (p_source->p_uring == NULL)
+        return salt_read_at(p_source->fd, p_source->p_buffers[other], 
+                            p_source->lengths[other], p_source->offsets[other]);
+
+    while ((p_owner = salt_io_uring_file_done(p_source->p_uring, 1)) != p_source)
+    {
+        if (p_owner == NULL) return -1;
+    }
+
+    return p_source->p_uring->file_failed ? -1 : 0;
+}
+
+/* 1 if the bytes are in the buffer */
+static int salt_source_holds(salt_file_source_t *p_source, int buffer, uint64_t offset, uint32_t size)
+{
+    return offset >= p_source->offsets[buffer] && 
+           offset - p_source->offsets[buffer] + size <= p_source->lengths[buffer];
+}
+
+int salt_source_open(salt_file_source_t *p_source, 
+                     const char *file, 
+                     uint32_t block_size,
+                     salt_io_uring_t *p_uring)
+{
+#if defined(_WIN32)
+    struct _stati64 info;
+
+    p_source->fd = _open(file, _O_RDONLY | _O_BINARY);
+    if (p_source->fd < 0) return -1;
+    if (_fstati64(p_source->fd, &info) != 0)
+    {
+        _close(p_source->fd);
+        return -1;
+    }
+#else
+    struct stat info;
+
+    p_source->fd = open(file, O_RDONLY);
+    if (p_source->fd < 0) return -1;
+    if (fstat(p_source->fd, &info) != 0)
+    {
+        close(p_source->fd);
+        return -1;
+    }
+#endif
+
+    p_source->size = (uint64_t) info.st_size;
+    p_source->window = (block_size < SALT_SOURCE_WINDOW) ? SALT_SOURCE_WINDOW / block_size * block_size : block_size;
+    p_source->p_map = NULL;
+    p_source->released = 0;
+    p_source->pool.p_memory = NULL;
+    p_source->offsets[0] = p_source->offsets[1] = 0;
+    p_source->lengths[0] = p_source->lengths[1] = 0;
+    p_source->current = 0;
+    p_source->reading = 0;
+    p_source->p_uring = p_uring;
+
+#if !defined(_WIN32)
+    /* The pages are read by the kernel ahead of the blocks and released behind them */
+    if (p_uring == NULL && p_source->size > 0 && p_source->size <= (size_t) -1)
+    {
+        void *p_map = mmap(NULL, (size_t) p_source->size, PROT_READ, MAP_PRIVATE, p_source->fd, 0);
+
+        if (p_map != MAP_FAILED)
+        {
+            p_source->p_map = (uint8_t *) p_map;
+            madvise(p_map, (size_t) p_source->size, MADV_SEQUENTIAL);
             return 0;
+        }
+    }
+#endif
+
+    if (salt_buffer_pool_init(&p_source->pool, p_source->window, 2) != 0)
+    {
+        salt_source_close(p_source);
+        return -1;
+    }
+    p_source->p_buffers[0] = salt_buffer_pool_get(&p_source->pool);
+    p_source->p_buffers[1] = salt_buffer_pool_get(&p_source->pool);
+
+    return 0;
+}
+
+const uint8_t *salt_source_get(salt_file_source_t *p_source, uint64_t offset, uint32_t size)
+{
+    int other;
+
+    if (offset > p_source->size || size > p_source->size - offset) return NULL;
+
+#if !defined(_WIN32)
+    if (p_source->p_map != NULL)
+    {
+        uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE), behind;
+
+        /* A window behind the block stays, the pages before it are dropped */
+        if (offset < p_source->released) p_source->released = offset / page * page;
+        if (offset >= p_source->released + 2 * p_source->window)
+        {
+            behind = (offset - p_source->window) / page * page;
+            madvise(p_source->p_map + p_source->released, (size_t) (behind - p_source->released), MADV_DONTNEED);
+            p_source->released = behind;
+        }
+
+        return p_source->p_map + offset;
+    }
+#endif
+
+    if (!salt_source_holds(p_source, p_source->current, offset, size))
+    {
+        if (salt_source_wait(p_source) != 0) return NULL;
+
+        other = 1 - p_source->current;
+        if (salt_source_holds(p_source, other, offset, size)) p_source->current = other;
+        else if (salt_source_fill(p_source, p_source->current, offset, 0) != 0) return NULL;
+
+        /* The next window is read while the blocks of this one are sent */
+        if (salt_source_fill(p_source, 1 - p_source->current, 
+                             p_source->offsets[p_source->current] + p_source->lengths[p_source->current], 1) != 0) 
+            return NULL;
+    }
+
+    return p_source->p_buffers[p_source->current] + (offset - p_source->offsets[p_source->current]);
+}
+
+int salt_source_id(salt_file_source_t *p_source, char *p_id)
+{
+    uint64_t hash_state[(api_crypto_hash_sha512_state_size + 7) / 8];
+    uint8_t hash[api_crypto_hash_sha512_BYTES];
+    uint8_t edge[4096];
+    uint64_t fields[5], offset, end;
+    uint32_t size;
+    int i;
+#if defined(_WIN32)
+    struct _stati64 info;
+
+    if (_fstati64(p_source->fd, &info) != 0) return -1;
+    fields[1] = (uint64_t) info.st_mtime;
+    fields[2] = 0;
+#else
+    struct stat info;
+
+    if (fstat(p_source->fd, &info) != 0) return -1;
+    fields[1] = (uint64_t) info.st_mtim.tv_sec;
+    fields[2] = (uint64_t) info.st_mtim.tv_nsec;
+#endif
+    fields[0] = p_source->size;
+    fields[3] = (uint64_t) info.st_ino;
+    fields[4] = (uint64_t) info.st_dev;
+
+    api_crypto_hash_sha512_init((uint8_t *) hash_state, sizeof(hash_state));
+    api_crypto_hash_sha512_update((uint8_t *) hash_state, (const uint8_t *) fields, sizeof(fields));
+
+    /* The beginning and the end, both are the whole file when it is small */
+    for (i = 0; i < 2; i++)
+    {
+        offset = (i == 0 || p_source->size < SALT_SOURCE_ID_EDGE) ? 0 : p_source->size - SALT_SOURCE_ID_EDGE;
+        end = (offset + SALT_SOURCE_ID_EDGE < p_source->size) ? offset + SALT_SOURCE_ID_EDGE : p_source->size;
+
+        for (; offset < end; offset += size)
+        {
+            size = (end - offset < sizeof(edge)) ? (uint32_t) (end - offset) : (uint32_t) sizeof(edge);
+            if (salt_read_at(p_source->fd, edge, size, offset) != 0) return -1;
+            api_crypto_hash_sha512_update((uint8_t *) hash_state, edge, size);
+        }
+    }
+    api_crypto_hash_sha512_final((uint8_t *) hash_state, hash);
+
+    for (i = 0; i < SALT_DIGEST_SIZE; i++) sprintf(&p_id[2 * i], "%02x", hash[i]);
+
+    return 0;
+}
+
+void salt_source_close(salt_file_source_t *p_source)
+{
+#if !defined(_WIN32)
+    if (p_source->p_map != NULL) munmap(p_source->p_map, (size_t) p_source->size);
+#endif
+    p_source->p_map = NULL;
+
+    /* The buffer must not be freed under a read of the ring */
+    salt_source_wait(p_source);
+    if (p_source->pool.p_memory != NULL) salt_buffer_pool_free(&p_source->pool);
+
+    salt_close_output(p_source->fd);
+    p_source->fd = -1;
+}
+
+
+int loading_file(char *file, 
+                 uint64_t *file_size, 
+                 int my_file,
+                 uint32_t block_size,
+                 salt_file_source_t *p_source,
+                 salt_io_uring_t *p_uring)
+{   
+
+    FILE *stream;
+
+    unsigned long long expected_size_file, i = 0;
+    uint32_t range;
+
+    /**
+     * if my_file == 0 -> test file 
+     * if my_file == 1 -> your file 
+     * 
+     * Creating our random test file:
+     * 
+     */
+
+    if(!my_file) 
+    {
+        if ((stream = fopen(file, "wb")) == NULL) 
+        {
+            printf("Failed to open create file %s\n", file);
+            exit(0);
+        }
+        
+        printf("Creating own file\n");
+      
+        printf("Enter the approximate file size in bytes: \n");
+        if (EOF == scanf("%llu", &expected_size_file))
+        {
+            printf("Oh no man :( bad file size, the program will end.\nPlease turn it on again\n");
+            return -1;
         } 
         expected_size_file = expected_size_file / 
-                            (sizeof(expected_size_file) * sizeof(expected_size_file));
+                            (sizeof(range) * sizeof(range));
         printf("Enter max integer (range): \n");
         if (EOF == scanf("%u", &range))
         {
             printf("Oh no man :( bad max integer, the program will end.\nPlease turn it on again\n");
-            return 0;
+            return -1;
         } 
        
         while(i++ < expected_size_file)
         {
-            fprintf(stream, "Number %d. %u, ", i,  rand() % range);
+            fprintf(stream, "Number %llu. %u, ", i,  rand() % range);
         }
 
         fprintf(stream, "\nThis is the end of the file being tested :)");
@@ -776,67 +2646,17 @@ uint8_t *loading_file(char *file,
             printf("Failed to closed file\n");
     }
 
-    if ((stream = fopen(file, "rb")) == NULL) 
-    {
-        printf("Failed to open file %s\n", file);
-        exit(0);
-    }
-
-     /**
-     * _fseeki64 functions moves the file pointer (if any) 
-     * associated with stream to a new location that is offset 
-     * bytes from origin 
-     *
-     * SEEK_END : End of file
-     * SEEK_SET : Beginning of file.
-     *
-     * for linux fseekko() and ftello()
+    /**
+     * The file is sent from a mapping or from two buffers of 
+     * SALT_SOURCE_WINDOW bytes, the memory does not grow with 
+     * the size of the file.
      */
-
-#if defined(_WIN32)
-    /* If successful, return 0 */
-    if ((result1 = _fseeki64(stream, 0L, SEEK_END)) != 0)
-        printf("_fseeki64 error1\n");
-
-    /* _ftelli64 return the current file position */
-    *file_size = _ftelli64(stream);
-
-    /* If successful, return 0 */
-    if ((result2 = _fseeki64(stream, 0L, SEEK_SET)) != 0)
-        printf("_fseeki64 error2\n");
-#else 
-    /* If successful, return 0 */
-    if ((result1 = fseeko(stream, 0L, SEEK_END)) != 0)
-        printf("fseeko error1\n");
-
-    /* _ftelli64 return the current file position */
-    *file_size = ftello(stream);
-
-    /* If successful, return 0 */
-    if ((result2 = fseeko(stream, 0L, SEEK_SET)) != 0)
-        printf("fseeko error2\n");
-#endif
-    
-    /* Allocates the requested memory and returns a pointer to it */
-    input = (uint8_t *) malloc(*file_size);
-    if (input == NULL) 
+    if (salt_source_open(p_source, file, block_size, p_uring) != 0) 
     {
-        printf("Memory not allocated for input data.\n");
+        printf("Failed to open file %s\n", file);
         exit(0);
     }
+    *file_size = p_source->size;
 
-    /*
-     * reads data from the given stream into the 
-     * array pointed to, by input
-     * 
-     * file_size is the number of elements, 
-     * each one with a size of size bytes.
-     */
-    int test = fread(input, 1, *file_size, stream);
-    if (!test) printf("We can provide no input at all !!! \n");
-
-    if(fclose(stream) == EOF) 
-        printf("Failed to closed file\n");
-
-    return input;
+    return 0;
 }
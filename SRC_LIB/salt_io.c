@@ -32,11 +32,6 @@
 /* RS-232 : created auxiliary functions for Salt protocol */
 #include "salt_example_rs232.h"
 
-/* ====== Public macro definitions ======= */
-
-/* Sleep for 50 milliSeconds  */
-#define MILISECONDS            50
-
 /**
  * The salt-channel-c implements a delay attack protection. This means that both peers
  * sends a time relative to the first messages sent. This means that from the timestamp
@@ -48,59 +43,545 @@
 
 static salt_ret_t get_time(salt_time_t *p_time, uint32_t *time);
 
+/* Batching of the reads, pacing and coalescing of the opened port p_ctx->p_port */
+static int salt_io_setup_port(salt_io_ctx_t *p_ctx, int baudrate, const char *mode);
+
+/* Current time in microseconds for deadlines and pacing */
+static uint64_t salt_io_time_us(void);
+
+/* Sends the buffers in order, paced by the TX queue of the driver, returns the bytes sent */
+static int32_t salt_io_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, int *p_sizes, int count, int may_wait);
+
+/* Sends the staged frames, without waiting only what the link takes now */
+static int salt_io_flush_stage(salt_io_ctx_t *p_ctx, int may_wait);
+
+/* SALT_SUCCESS if the whole frame of my_write() left (or was staged) */
+static salt_ret_t salt_io_write_done(salt_io_ctx_t *p_ctx, salt_io_channel_t *p_wchannel);
+
+/* Reads the bytes of my_read() from the link, without framing */
+static salt_ret_t salt_io_read_raw(salt_io_ctx_t *p_ctx, salt_io_channel_t *p_rchannel);
+
+/* Reads the bytes of my_read() from the decoded COBS frames */
+static salt_ret_t salt_io_read_cobs(salt_io_ctx_t *p_ctx, salt_io_channel_t *p_rchannel);
+
+/* Decodes one received byte into p_ctx->rx_frame, a complete frame must match its size bytes */
+static void salt_io_frame_decode(salt_io_ctx_t *p_ctx, uint8_t byte);
+
+/* Number of bytes which can be queued in the driver without waiting */
+static uint32_t salt_io_tx_budget(salt_io_ctx_t *p_ctx);
+
+/* Waits until at least needed bytes can be queued in the driver */
+static int salt_io_tx_wait(salt_io_ctx_t *p_ctx, uint32_t needed, uint32_t budget);
+
 salt_time_t my_time = {
     get_time,
     NULL
 };
 
+/* ====== Context of the port ======= */
+
+void salt_io_ctx_init(salt_io_ctx_t *p_ctx, rs232_port_t *p_port)
+{
+    memset(p_ctx, 0, sizeof(salt_io_ctx_t));
+
+    p_ctx->p_transport = &salt_io_serial_transport;
+    p_ctx->p_port = (p_port != NULL) ? p_port : &p_ctx->port;
+    p_ctx->fd = -1;
+    p_ctx->read_timeout = SALT_IO_READ_TIMEOUT;
+    p_ctx->tx_queue_limit = SALT_IO_TX_QUEUE_LIMIT;
+    p_ctx->tx_tokens = SALT_IO_TX_QUEUE_LIMIT;
+    p_ctx->tx_refill_us = salt_io_time_us();
+}
+
+int salt_io_open_port(salt_io_ctx_t *p_ctx, 
+                      int cport_nr, 
+                      int baudrate, 
+                      const char *mode, 
+                      int flowctrl)
+{
+    rs232_port_t *p_port = RS232_GetPort(cport_nr);
+
+    if (p_port == NULL || RS232_OpenComport(cport_nr, baudrate, mode, flowctrl))
+    {
+        return 1;
+    }
+
+    salt_io_ctx_init(p_ctx, p_port);
+
+    return salt_io_setup_port(p_ctx, baudrate, mode);
+}
+
+int salt_io_open_device(salt_io_ctx_t *p_ctx, 
+                        const char *p_device, 
+                        int baudrate, 
+                        const char *mode, 
+                        int flowctrl)
+{
+    salt_io_ctx_init(p_ctx, NULL);
+
+    if (RS232_PortOpen(p_ctx->p_port, p_device, baudrate, mode, flowctrl))
+    {
+        return 1;
+    }
+
+    return salt_io_setup_port(p_ctx, baudrate, mode);
+}
+
+int salt_io_open_pty(salt_io_ctx_t *p_ctx, 
+                     int baudrate, 
+                     const char *mode, 
+                     char *p_slave_name,
+                     int size)
+{
+    salt_io_ctx_init(p_ctx, NULL);
+
+    if (RS232_PortOpenPty(p_ctx->p_port, baudrate, mode, 0, p_slave_name, size))
+    {
+        return 1;
+    }
+
+    return salt_io_setup_port(p_ctx, baudrate, mode);
+}
+
+static int salt_io_setup_port(salt_io_ctx_t *p_ctx, int baudrate, const char *mode)
+{
+    if (RS232_PortSetReadBatching(p_ctx->p_port, SALT_IO_READ_VMIN, SALT_IO_READ_VTIME) != 0 ||
+        salt_io_set_line(p_ctx, baudrate, mode) != 0)
+    {
+        salt_io_close(p_ctx);
+        return 1;
+    }
+
+    p_ctx->read_batching = 1;
+    p_ctx->tx_coalesce_bytes = SALT_IO_TX_COALESCE_BYTES;
+    p_ctx->tx_coalesce_us = SALT_IO_TX_COALESCE_LATENCY;
+
+    return 0;
+}
+
+void salt_io_close(salt_io_ctx_t *p_ctx)
+{
+    p_ctx->p_transport->close(p_ctx);
+}
+
+void salt_io_set_read_timeout(salt_io_ctx_t *p_ctx, int32_t timeout)
+{
+    p_ctx->read_timeout = timeout;
+}
+
+void salt_io_set_non_blocking(salt_io_ctx_t *p_ctx, int non_blocking)
+{
+    p_ctx->non_blocking = non_blocking;
+}
+
+int salt_io_poll_channel(salt_channel_t *p_channel, uint8_t *p_interest)
+{
+    salt_io_ctx_t *p_ctx = (salt_io_ctx_t *) p_channel->write_channel.p_context;
+
+    *p_interest = salt_get_io_interest(p_channel);
+
+    /* The answer can not come before the staged frames leave */
+    if (p_ctx->tx_staged > 0) *p_interest |= SALT_IO_WANT_WRITE;
+
+    return p_ctx->p_transport->fd(p_ctx);
+}
+
+int salt_io_wait_channel(salt_channel_t *p_channel, int timeout_ms)
+{
+    salt_io_ctx_t *p_ctx = (salt_io_ctx_t *) p_channel->write_channel.p_context;
+    uint8_t interest = salt_get_io_interest(p_channel);
+    uint64_t age;
+    int budget_ms, ret;
+
+    /* The staged frames leave when their latency budget expires, the wait for reading ends then */
+    if (p_ctx->tx_staged > 0 && !(interest & SALT_IO_WANT_WRITE))
+    {
+        age = salt_io_time_us() - p_ctx->tx_staged_us;
+        if (age < p_ctx->tx_coalesce_us && (interest & SALT_IO_WANT_READ))
+        {
+            budget_ms = (int) ((p_ctx->tx_coalesce_us - age + 999) / 1000);
+            if (timeout_ms >= 0 && timeout_ms <= budget_ms) return p_ctx->p_transport->wait(p_ctx, 0, timeout_ms);
+
+            ret = p_ctx->p_transport->wait(p_ctx, 0, budget_ms);
+            if (ret != 0) return ret;
+            if (timeout_ms > 0) timeout_ms -= budget_ms;
+        }
+
+        if (salt_io_flush_stage(p_ctx, 0) != 0) return -1;
+    }
+
+    salt_io_poll_channel(p_channel, &interest);
+
+    if (interest & SALT_IO_WANT_WRITE) return p_ctx->p_transport->wait(p_ctx, 1, timeout_ms);
+    if (interest & SALT_IO_WANT_READ) return p_ctx->p_transport->wait(p_ctx, 0, timeout_ms);
+
+    return 1;
+}
+
+/* Sums of the counters and the queues of the bonded ports */
+static int salt_io_get_bond_stats(salt_io_bond_t *p_bond, salt_io_stats_t *p_stats)
+{
+    salt_io_stats_t port;
+    int i, valid = 1;
+
+    p_stats->bond_ports = (uint32_t) p_bond->alive;
+    p_stats->bond_lost = p_bond->lost;
+
+    for (i = 0; i < p_bond->count; i++)
+    {
+        if (p_bond->ports[i].dead) continue;
+
+        valid &= salt_io_get_stats(p_bond->ports[i].p_ctx, &port);
+
+        p_stats->rx_chars += port.rx_chars;
+        p_stats->tx_chars += port.tx_chars;
+        p_stats->overruns += port.overruns;
+        p_stats->buf_overruns += port.buf_overruns;
+        p_stats->frame_errors += port.frame_errors;
+        p_stats->parity_errors += port.parity_errors;
+        p_stats->breaks += port.breaks;
+        p_stats->fec_corrected += port.fec_corrected;
+        p_stats->fec_uncorrectable += port.fec_uncorrectable;
+        p_stats->rx_queue = (p_stats->rx_queue < 0 || port.rx_queue < 0) ? -1 : p_stats->rx_queue + port.rx_queue;
+        p_stats->tx_queue = (p_stats->tx_queue < 0 || port.tx_queue < 0) ? -1 : p_stats->tx_queue + port.tx_queue;
+    }
+    p_stats->counters_valid = (uint8_t) valid;
+
+    return valid;
+}
+
+int salt_io_get_stats(salt_io_ctx_t *p_ctx, salt_io_stats_t *p_stats)
+{
+    const salt_io_transport_t *p_link = p_ctx->p_transport;
+    rs232_counters_t counters;
+
+    memset(p_stats, 0, sizeof(salt_io_stats_t));
+
+    /* The link under the ARQ, the FEC, the io_uring and the I/O thread */
+    if (p_ctx->p_arq != NULL)
+    {
+        p_stats->damaged_chunks = p_ctx->p_arq->damaged;
+        p_stats->retransmits = p_ctx->p_arq->retransmits;
+        p_link = p_ctx->p_arq->p_link;
+    }
+    if (p_ctx->p_fec != NULL)
+    {
+        p_stats->fec_corrected = p_ctx->p_fec->corrected;
+        p_stats->fec_uncorrectable = p_ctx->p_fec->uncorrectable;
+        p_link = p_ctx->p_fec->p_link;
+    }
+    if (p_ctx->p_uring != NULL)
+    {
+        p_stats->uring_calls = p_ctx->p_uring->calls;
+        p_stats->uring_completions = p_ctx->p_uring->completions;
+        p_link = p_ctx->p_uring->p_link;
+    }
+    if (p_link == &salt_io_thread_transport) p_link = p_ctx->p_thread->p_link;
+    p_stats->dropped_frames = p_ctx->frames_dropped;
+
+    if (p_link == &salt_io_bond_transport) return salt_io_get_bond_stats(p_ctx->p_bond, p_stats);
+
+    /* FIONREAD / TIOCOUTQ only ask the driver, also beside the thread */
+    p_stats->rx_queue = p_link->in_queue(p_ctx);
+    p_stats->tx_queue = p_link->out_queue(p_ctx);
+
+    if (p_link != &salt_io_serial_transport || 
+        RS232_PortGetCounters(p_ctx->p_port, &counters) != 0)
+    {
+        return 0;
+    }
+
+    p_stats->rx_chars = counters.rx;
+    p_stats->tx_chars = counters.tx;
+    p_stats->overruns = counters.overrun;
+    p_stats->buf_overruns = counters.buf_overrun;
+    p_stats->frame_errors = counters.frame;
+    p_stats->parity_errors = counters.parity;
+    p_stats->breaks = counters.brk;
+    p_stats->counters_valid = 1;
+
+    return 1;
+}
+
+salt_io_stats_t *salt_io_update_stats(salt_channel_t *p_channel)
+{
+    salt_io_ctx_t *p_ctx = (salt_io_ctx_t *) p_channel->write_channel.p_context;
+
+    salt_io_get_stats(p_ctx, &p_channel->io_stats);
+
+    return &p_channel->io_stats;
+}
+
+int salt_io_set_line(salt_io_ctx_t *p_ctx, int baudrate, const char *mode)
+{
+    /* Start bit */
+    uint32_t bits = 1;
+
+    if (baudrate <= 0)
+    {
+        p_ctx->line_rate = 0;
+        return 0;
+    }
+
+    if (mode == NULL || strlen(mode) != 3 || 
+        mode[0] < '5' || mode[0] > '8' || 
+        (mode[2] != '1' && mode[2] != '2'))
+    {
+        printf("invalid mode of the line\n");
+        return -1;
+    }
+
+    /* Data bits, parity bit and stop bits */
+    bits += mode[0] - '0';
+    if (mode[1] != 'N' && mode[1] != 'n') bits++;
+    bits += mode[2] - '0';
+
+    p_ctx->line_rate = (uint32_t) baudrate / bits;
+
+    return 0;
+}
+
+void salt_io_set_error_rate(salt_io_ctx_t *p_ctx, double ber)
+{
+    if (ber <= 0)
+    {
+        p_ctx->error_threshold = 0;
+        return;
+    }
+    if (ber > 1) ber = 1;
+
+    p_ctx->error_threshold = (uint32_t) (ber * 4294967295.0);
+    if (p_ctx->error_threshold == 0) p_ctx->error_threshold = 1;
+
+    /* The generator must not start from zero */
+    p_ctx->error_seed = (uint32_t) salt_io_time_us() | 1;
+}
+
+int salt_io_set_baudrate(salt_io_ctx_t *p_ctx, int baudrate, const char *mode)
+{
+    /* The link under the I/O thread or the io_uring, if there is one */
+    const salt_io_transport_t *p_link = (p_ctx->p_thread != NULL) ? p_ctx->p_thread->p_link : 
+                                        (p_ctx->p_uring != NULL) ? p_ctx->p_uring->p_link : 
+                                        p_ctx->p_transport;
+    int actual;
+
+    /* The probe of a new rate must see the damaged bytes, the ARQ and the FEC would repair them */
+    if (p_link != &salt_io_serial_transport || p_ctx->p_arq != NULL || p_ctx->p_fec != NULL) return -1;
+
+    /* The frames written with the old rate leave the port first */
+    if (salt_io_drain(p_ctx) != 0 || RS232_PortSetBaudrate(p_ctx->p_port, baudrate) != 0)
+    {
+        return -1;
+    }
+
+    /* The driver sets the nearest rate it can, the pacing follows it */
+    actual = RS232_PortGetBaudrate(p_ctx->p_port);
+    if (salt_io_set_line(p_ctx, (actual > 0) ? actual : baudrate, mode) != 0) return -1;
+
+    /* The I/O thread paces the line, see salt_io_start_thread() */
+    if (p_ctx->p_thread != NULL)
+    {
+        __atomic_store_n(&p_ctx->p_thread->line_rate, p_ctx->line_rate, __ATOMIC_RELAXED);
+        p_ctx->line_rate = 0;
+    }
+
+    return 0;
+}
+
+void salt_io_discard_input(salt_io_ctx_t *p_ctx)
+{
+    uint8_t scratch[256];
+    int32_t queued;
+
+    p_ctx->rx_begin = p_ctx->rx_end = 0;
+    memset(&p_ctx->rx_cobs, 0, sizeof(p_ctx->rx_cobs));
+    p_ctx->rx_frame_begin = 0;
+    p_ctx->rx_frame_ready = 0;
+
+    /* Only the queued bytes, a batched read would wait for more */
+    while ((queued = p_ctx->p_transport->in_queue(p_ctx)) > 0)
+    {
+        if (queued > (int32_t) sizeof(scratch)) queued = sizeof(scratch);
+        if (p_ctx->p_transport->recv(p_ctx, scratch, queued) <= 0) break;
+    }
+}
+
+int salt_io_drain(salt_io_ctx_t *p_ctx)
+{
+    if (salt_io_flush_stage(p_ctx, 1) != 0) return -1;
+
+    return p_ctx->p_transport->drain(p_ctx);
+}
+
+int salt_io_set_framing(salt_io_ctx_t *p_ctx, int framing)
+{
+    if (framing != SALT_IO_FRAMING_NONE && framing != SALT_IO_FRAMING_COBS) return -1;
+
+    /* The frames staged with the old framing leave first */
+    if (salt_io_flush_stage(p_ctx, 1) != 0) return -1;
+
+    p_ctx->framing = framing;
+    p_ctx->tx_frame_len = p_ctx->tx_frame_sent = 0;
+    memset(&p_ctx->rx_cobs, 0, sizeof(p_ctx->rx_cobs));
+    p_ctx->rx_frame_begin = 0;
+    p_ctx->rx_frame_ready = 0;
+
+    return 0;
+}
+
+int salt_io_set_coalescing(salt_io_ctx_t *p_ctx, uint32_t max_bytes, uint32_t latency_us)
+{
+    /* The frames waiting for the old budget leave now */
+    if (salt_io_flush_stage(p_ctx, 1) != 0) return -1;
+
+    if (max_bytes > SALT_IO_TX_STAGE_SIZE) max_bytes = SALT_IO_TX_STAGE_SIZE;
+
+    p_ctx->tx_coalesce_bytes = max_bytes;
+    p_ctx->tx_coalesce_us = latency_us;
+
+    return 0;
+}
+
+int salt_io_flush(salt_io_ctx_t *p_ctx)
+{
+    return salt_io_flush_stage(p_ctx, !p_ctx->non_blocking);
+}
+
+static int salt_io_flush_stage(salt_io_ctx_t *p_ctx, int may_wait)
+{
+    uint8_t *p_bufs[1] = { p_ctx->tx_stage };
+    int sizes[1] = { (int) p_ctx->tx_staged };
+    int32_t sent;
+
+    if (p_ctx->tx_staged == 0) return 0;
+
+    sent = salt_io_send(p_ctx, p_bufs, sizes, 1, may_wait);
+    if (sent < 0)
+    {
+        p_ctx->tx_staged = 0;
+        return -1;
+    }
+
+    /* The rest waits for the next call */
+    p_ctx->tx_staged -= (uint32_t) sent;
+    memmove(p_ctx->tx_stage, &p_ctx->tx_stage[sent], p_ctx->tx_staged);
+
+    return 0;
+}
+
 /* ====== Function for sending messages ======= */
 
 salt_ret_t my_write(salt_io_channel_t *p_wchannel)
 {
-    /* /dev/ttyS0 (COM1 on windows) port */
-    int cport_nr = *((int *) p_wchannel->p_context);
+    salt_io_ctx_t *p_ctx = (salt_io_ctx_t *) p_wchannel->p_context;
 
-    /* Size of bytes sent */
-    int32_t bytes_sent = 0, sleep_return;
- 
-    /* The amount of data to send */
+    /* The frame (size bytes and package) and its length */
+    uint8_t *p_frame = &p_wchannel->p_data[p_wchannel->size];
     uint32_t to_write = p_wchannel->size_expected - p_wchannel->size;
-    
+
+    /* Bytes of the frame which left, encoded ones with the framing */
+    uint32_t *p_done = &p_wchannel->size;
+
+    /* The staged frames and the frame, sent with one writev() */
+    uint8_t *p_bufs[2];
+    int sizes[2];
+    int32_t sent;
+    uint64_t now;
+
 /**
- * Sends multiple bytes via the cport_nr. &p_wchannel->p_data[p_wchannel->size] 
- * is a pointer to a buffer and to_write is the size of the buffer in bytes.
- * 
- * Returns -1 in case of an error, otherwise it returns the amount of bytes sent.
- * This function blocks (it returns after all the bytes have been processed).
- * 
+ * Small frames are only copied behind the frames staged in p_ctx->tx_stage
+ * (see salt_io_set_coalescing()), they leave the port together when the 
+ * byte budget is full, when the oldest frame waits longer than the latency 
+ * budget, in salt_io_flush() or before my_read() waits for the answer.
+ *
+ * A frame which does not fit into the budget is sent together with 
+ * the staged frames by one send() of the transport (writev()).
+ *
+ * This function blocks (it returns after all the bytes have been processed),
+ * in the non-blocking mode it sends what the link takes and returns 
+ * SALT_PENDING, the next call continues with the rest.
  */ 
-   
-    bytes_sent = RS232_SendBuf(cport_nr,
-                               &p_wchannel->p_data[p_wchannel->size], 
-                               to_write);
-    
-    if (bytes_sent != 0)
-        printf("Sent %d bytes.\n", bytes_sent);
+    if (p_ctx->framing == SALT_IO_FRAMING_COBS)
+    {
+        /* The frame is encoded by the first call, the next calls send the rest */
+        if (p_ctx->tx_frame_len == 0)
+        {
+            if (to_write > SALT_IO_FRAME_SIZE)
+            {
+                p_wchannel->err_code = SALT_ERR_BUFF_TO_SMALL;
+                return SALT_ERROR;
+            }
 
-    if (bytes_sent < 0) 
+            p_ctx->tx_frame_len = salt_io_cobs_encode(p_frame, to_write, p_ctx->tx_frame);
+            p_ctx->tx_frame_sent = 0;
+        }
+
+        p_frame = &p_ctx->tx_frame[p_ctx->tx_frame_sent];
+        to_write = p_ctx->tx_frame_len - p_ctx->tx_frame_sent;
+        p_done = &p_ctx->tx_frame_sent;
+    }
+
+    if (to_write > 0 && p_ctx->tx_staged + to_write <= p_ctx->tx_coalesce_bytes)
     {
-        p_wchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
-        printf("-1 bytes were sent, the connection is closed\n");
+        now = salt_io_time_us();
+        if (p_ctx->tx_staged == 0) p_ctx->tx_staged_us = now;
 
-        return SALT_ERROR;
+        memcpy(&p_ctx->tx_stage[p_ctx->tx_staged], p_frame, to_write);
+        p_ctx->tx_staged += to_write;
+        *p_done += to_write;
+
+        if (p_ctx->tx_staged == p_ctx->tx_coalesce_bytes || 
+            now - p_ctx->tx_staged_us >= p_ctx->tx_coalesce_us)
+        {
+            if (salt_io_flush(p_ctx) != 0)
+            {
+                p_wchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+                return SALT_ERROR;
+            }
+        }
+
+        return salt_io_write_done(p_ctx, p_wchannel);
     }
 
-    SALT_HEXDUMP_DEBUG(&p_wchannel->p_data[p_wchannel->size], bytes_sent);
-       
-    /* Addition sent size of bytes */
-    p_wchannel->size += bytes_sent;
+    p_bufs[0] = p_ctx->tx_stage;
+    sizes[0] = (int) p_ctx->tx_staged;
+    p_bufs[1] = p_frame;
+    sizes[1] = (int) to_write;
 
-    if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS)) == 0)
+    sent = salt_io_send(p_ctx, p_bufs, sizes, 2, !p_ctx->non_blocking);
+    if (sent < 0)
     {
-        printf("Problem during sleep I/O");
+        p_ctx->tx_staged = 0;
+        p_ctx->tx_frame_len = 0;
+        p_wchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
         return SALT_ERROR;
     }
 
+    /* Only a part of the staged frames left, the frame waits */
+    if ((uint32_t) sent < p_ctx->tx_staged)
+    {
+        p_ctx->tx_staged -= (uint32_t) sent;
+        memmove(p_ctx->tx_stage, &p_ctx->tx_stage[sent], p_ctx->tx_staged);
+        return SALT_PENDING;
+    }
+
+    *p_done += (uint32_t) sent - p_ctx->tx_staged;
+    p_ctx->tx_staged = 0;
+
+    return salt_io_write_done(p_ctx, p_wchannel);
+}
+
+static salt_ret_t salt_io_write_done(salt_io_ctx_t *p_ctx, salt_io_channel_t *p_wchannel)
+{
+    if (p_ctx->framing == SALT_IO_FRAMING_COBS)
+    {
+        if (p_ctx->tx_frame_sent < p_ctx->tx_frame_len) return SALT_PENDING;
+
+        /* The whole encoded frame left, so did the frame of salt */
+        p_ctx->tx_frame_len = 0;
+        p_wchannel->size = p_wchannel->size_expected;
+    }
+
     return (p_wchannel->size == p_wchannel->size_expected) ? SALT_SUCCESS : SALT_PENDING;
 }
 
@@ -108,51 +589,138 @@ salt_ret_t my_write(salt_io_channel_t *p_wchannel)
 
 salt_ret_t my_read(salt_io_channel_t *p_rchannel)
 {
-    /* /dev/ttyS0 (COM1 on windows) port */
-    int cport_nr = *((int *) p_rchannel->p_context);
+    salt_io_ctx_t *p_ctx = (salt_io_ctx_t *) p_rchannel->p_context;
+
+    if (p_ctx->framing == SALT_IO_FRAMING_COBS) return salt_io_read_cobs(p_ctx, p_rchannel);
+
+    return salt_io_read_raw(p_ctx, p_rchannel);
+}
+
+static salt_ret_t salt_io_read_raw(salt_io_ctx_t *p_ctx, salt_io_channel_t *p_rchannel)
+{
+    /* The port, socket or ring of the context */
+    const salt_io_transport_t *p_link = p_ctx->p_transport;
 
     /* Size of bytes received */
-    int32_t bytes_received = 0, sleep_return;
+    int32_t bytes_received = 0, wait_return, queued = -1;
 
-    /* The amount of data to received */
-    uint32_t to_read;
+    /* The amount of data to received, where and how much is read from the port */
+    uint32_t to_read, available, request;
+    uint8_t *p_target;
+
+    /* Deadline of this call, the port is waited in poll() until then */
+    uint64_t deadline = salt_io_time_us() / 1000 + (uint64_t) p_ctx->read_timeout;
+    int32_t remaining = -1;
+
+    /* A blocking (batched) read must not start on a port without data */
+    int readable = !p_ctx->read_batching;
+
+    /* The answer can not come before the staged frames leave */
+    if (salt_io_flush(p_ctx) != 0)
+    {
+        p_rchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+        return SALT_ERROR;
+    }
 
 /**
- * Gets characters from the cport_nr. &p_rchannel->p_data[p_rchannel->size]
- * is a pointer to a buffer and to_read is the size of the buffer in bytes.
+ * The request is served from the read-ahead buffer p_ctx->rx_buffer 
+ * first. When the buffer is empty, everything the port has is read into
+ * it with one read, the rest stays there for the next call (e.g. the 
+ * package after the 4 size bytes or the next frame).
  *
- * Returns the amount of received characters into the buffer. 
- * This can be less than size or zero!
+ * The recv() of the transport (RS232_PortPoll() for the port) returns 
+ * the amount of received characters into the buffer. This can be less 
+ * than size or zero!
  * 
- * It does not block or wait, it returns immediately, 
- * no matter if any characters have been received or not
- * therefore, this cycle: while (p_rchannel->size < p_rchannel->size_expected){}
- * is needed !!!
+ * Without the batching it does not block or wait, it returns immediately.
+ * With the batching (salt_io_open_port()) the kernel collects the bytes
+ * and the read returns after min(VMIN, request) bytes or VTIME, so only 
+ * the bytes which are in the input queue or are needed are requested.
+ *
+ * If nothing has been received, the process sleeps in the wait() of the
+ * transport (poll() for the port and the sockets) or returns SALT_PENDING 
+ * in the non-blocking mode until the port is readable or the deadline expires. After 
+ * the deadline SALT_PENDING is returned and the read continues 
+ * with the next call.
  */
-   while (p_rchannel->size < p_rchannel->size_expected)
+    while (p_rchannel->size < p_rchannel->size_expected)
     { 
         to_read = p_rchannel->size_expected - p_rchannel->size;
-       
-        bytes_received = RS232_PollComport(cport_nr, 
-                                           &p_rchannel->p_data[p_rchannel->size],
-                                           to_read);
-        if (bytes_received >= 4000)
+
+        /* Bytes read ahead by the previous reads */
+        available = p_ctx->rx_end - p_ctx->rx_begin;
+        if (available > 0)
+        {
+            if (available > to_read) available = to_read;
+
+            memcpy(&p_rchannel->p_data[p_rchannel->size], 
+                   &p_ctx->rx_buffer[p_ctx->rx_begin], 
+                   available);
+            p_ctx->rx_begin += available;
+            p_rchannel->size += available;
+            continue;
+        }
+        p_ctx->rx_begin = p_ctx->rx_end = 0;
+
+        if (p_ctx->read_batching)
         {
-            if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS)) == 0)
+            queued = p_link->in_queue(p_ctx);
+            if (queued >= 0) readable = (queued > 0);
+        }
+
+        if (!readable)
+        {
+            if (p_ctx->non_blocking) return SALT_PENDING;
+
+            /* Nothing in the driver buffer, wait for readiness of the port */
+            if (p_ctx->read_timeout >= 0)
+            {
+                uint64_t now = salt_io_time_us() / 1000;
+
+                if (now >= deadline) return SALT_PENDING;
+                remaining = (int32_t) (deadline - now);
+            }
+
+            wait_return = p_link->wait(p_ctx, 0, remaining);
+            if (wait_return < 0)
             {
-                printf("Problem during sleep I/O");
+                p_rchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+                printf("Problem during waiting for the port, the connection is closed\n");
+
                 return SALT_ERROR;
             }
-        }
+            if (wait_return == 0) return SALT_PENDING;
 
-        SALT_HEXDUMP_DEBUG(&p_rchannel->p_data[p_rchannel->size], bytes_received);
+            readable = 1;
+            if (p_ctx->read_batching) continue;
+        }
 
-        /* Addition size of bytes */
-        p_rchannel->size += bytes_received;
+        if (to_read >= SALT_IO_RX_BUFFER_SIZE)
+        {
+            /* Large package, the copy through the buffer is not worth it */
+            p_target = &p_rchannel->p_data[p_rchannel->size];
+            request = to_read;
+        }
+        else
+        {
+            p_target = p_ctx->rx_buffer;
+            request = SALT_IO_RX_BUFFER_SIZE;
 
-        if (bytes_received != 0) 
-            printf("Received %d bytes\n", bytes_received);
+            /* A blocking read would wait for the whole buffer */
+            if (p_ctx->read_batching)
+            {
+                request = (queued > (int32_t) to_read) ? (uint32_t) queued : to_read;
+                if (request > SALT_IO_RX_BUFFER_SIZE) request = SALT_IO_RX_BUFFER_SIZE;
+            }
+        }
 
+        /* Without waiting only the bytes which are in the driver are read */
+        if (p_ctx->non_blocking && p_ctx->read_batching && queued >= 0 && (uint32_t) queued < request)
+        {
+            request = (uint32_t) queued;
+        }
+       
+        bytes_received = p_link->recv(p_ctx, p_target, request);
         if (bytes_received < 0) 
         {
             p_rchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
@@ -160,19 +728,263 @@ salt_ret_t my_read(salt_io_channel_t *p_rchannel)
 
             return SALT_ERROR;
         }
+
+        /* Without the batching a next read can follow immediately */
+        readable = (bytes_received > 0) && !p_ctx->read_batching;
+
+        if (bytes_received == 0) continue;
+
+        SALT_HEXDUMP_DEBUG(p_target, bytes_received);
+
+        /* Addition size of bytes */
+        if (p_target == p_ctx->rx_buffer) p_ctx->rx_end = bytes_received;
+        else p_rchannel->size += bytes_received;
+
+        printf("Received %d bytes\n", bytes_received);
     } /* End of  while (p_rchannel->size < p_rchannel->size_expected) {....} */
 
-   // SALT_HEXDUMP_DEBUG(&p_rchannel->p_data[p_rchannel->size], bytes_received);
+    return (p_rchannel->size == p_rchannel->size_expected) ? SALT_SUCCESS : SALT_PENDING;
+}
+
+static salt_ret_t salt_io_read_cobs(salt_io_ctx_t *p_ctx, salt_io_channel_t *p_rchannel)
+{
+    salt_io_channel_t raw;
+    salt_ret_t ret;
+    uint32_t available;
+    uint8_t byte;
 
-    if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS)) == 0)
+/**
+ * The size bytes and the package are served from the complete frame in
+ * p_ctx->rx_frame. The frame is decoded from the read-ahead buffer, when 
+ * it is empty one byte is read by salt_io_read_raw(), which waits like 
+ * my_read() without the framing and reads the rest of the driver buffer
+ * ahead. A frame which was damaged never reaches salt.
+ */
+    while (p_rchannel->size < p_rchannel->size_expected)
     {
-        printf("Problem during sleep I/O");
-        return SALT_ERROR;
+        if (p_ctx->rx_frame_ready)
+        {
+            available = p_ctx->rx_cobs.len - p_ctx->rx_frame_begin;
+            if (available > p_rchannel->size_expected - p_rchannel->size)
+            {
+                available = p_rchannel->size_expected - p_rchannel->size;
+            }
+
+            memcpy(&p_rchannel->p_data[p_rchannel->size], 
+                   &p_ctx->rx_frame[p_ctx->rx_frame_begin], 
+                   available);
+            p_ctx->rx_frame_begin += available;
+            p_rchannel->size += available;
+
+            /* The next frame is decoded into the same buffer */
+            if (p_ctx->rx_frame_begin == p_ctx->rx_cobs.len)
+            {
+                p_ctx->rx_frame_ready = 0;
+                p_ctx->rx_frame_begin = 0;
+                p_ctx->rx_cobs.len = 0;
+            }
+            continue;
+        }
+
+        if (p_ctx->rx_begin == p_ctx->rx_end)
+        {
+            raw = *p_rchannel;
+            raw.p_data = &byte;
+            raw.size = 0;
+            raw.size_expected = 1;
+
+            ret = salt_io_read_raw(p_ctx, &raw);
+            if (ret != SALT_SUCCESS)
+            {
+                p_rchannel->err_code = raw.err_code;
+                return ret;
+            }
+
+            salt_io_frame_decode(p_ctx, byte);
+            continue;
+        }
+
+        while (p_ctx->rx_begin < p_ctx->rx_end && !p_ctx->rx_frame_ready)
+        {
+            salt_io_frame_decode(p_ctx, p_ctx->rx_buffer[p_ctx->rx_begin++]);
+        }
     }
 
-    return (p_rchannel->size == p_rchannel->size_expected) ? SALT_SUCCESS : SALT_PENDING;
+    return SALT_SUCCESS;
+}
+
+static void salt_io_frame_decode(salt_io_ctx_t *p_ctx, uint8_t byte)
+{
+    int ret = salt_io_cobs_decode(&p_ctx->rx_cobs, p_ctx->rx_frame, sizeof(p_ctx->rx_frame), byte);
+
+    if (ret == 0) return;
+
+    /* The size bytes of a complete frame must match its length */
+    if (ret == 1 && p_ctx->rx_cobs.len >= SALT_LENGTH_SIZE &&
+        salti_bytes_to_u32(p_ctx->rx_frame) == p_ctx->rx_cobs.len - SALT_LENGTH_SIZE)
+    {
+        p_ctx->rx_frame_ready = 1;
+        return;
+    }
+
+    if (ret < 0 || p_ctx->rx_cobs.len > 0) p_ctx->frames_dropped++;
+    p_ctx->rx_cobs.len = 0;
+}
+
+static uint64_t salt_io_time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t) tv.tv_sec * 1000000 + (uint64_t) tv.tv_usec;
+}
+
+static int32_t salt_io_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, int *p_sizes, int count, int may_wait)
+{
+    /* The port, socket or ring of the context */
+    const salt_io_transport_t *p_link = p_ctx->p_transport;
+
+    /* Size of bytes sent by one write and by all of them */
+    int32_t bytes_sent = 0, total_sent = 0;
+
+    /* The amount of data to send and how much the driver takes now */
+    uint32_t to_write = 0, budget, left;
+
+    /* Parts of the buffers passed to one write */
+    uint8_t *p_parts[RS232_MAX_IOV];
+    int part_sizes[RS232_MAX_IOV], parts, i;
+
+    for (i = 0; i < count; i++) to_write += p_sizes[i];
+
+/**
+ * Sends the buffers via the send() of the transport (RS232_PortSendBuf() / 
+ * RS232_PortSendBufv() for the port), it returns -1 in case of an error, 
+ * otherwise the amount of bytes sent.
+ *
+ * Only as many bytes are written as the TX queue of the driver can take
+ * (see salt_io_tx_budget()), a small frame is written without any delay, 
+ * a large frame is written in parts as the UART drains the queue.
+ * Without may_wait the sending stops when the queue is full.
+ */ 
+    while (to_write > 0)
+    {
+        budget = salt_io_tx_budget(p_ctx);
+        if (budget < to_write && budget < p_ctx->tx_queue_limit / 2)
+        {
+            /* Without waiting only the budget is sent */
+            if (!may_wait && budget == 0) break;
+
+            if (may_wait)
+            {
+                /* Wait until the queue has room for the frame or half of the queue */
+                if (salt_io_tx_wait(p_ctx, (to_write < p_ctx->tx_queue_limit / 2) ? 
+                                    to_write : p_ctx->tx_queue_limit / 2, budget) != 0)
+                {
+                    printf("Problem during waiting for the port, the connection is closed\n");
+                    return -1;
+                }
+                continue;
+            }
+        }
+
+        /* The unsent parts of the buffers which fit into the budget */
+        left = (budget < to_write) ? budget : to_write;
+        for (i = 0, parts = 0; i < count && left > 0; i++)
+        {
+            if (p_sizes[i] == 0) continue;
+
+            p_parts[parts] = pp_bufs[i];
+            part_sizes[parts] = ((uint32_t) p_sizes[i] < left) ? p_sizes[i] : (int) left;
+            left -= part_sizes[parts];
+            parts++;
+        }
+
+        bytes_sent = p_link->send(p_ctx, p_parts, part_sizes, parts);
+
+        if (bytes_sent < 0) 
+        {
+            printf("-1 bytes were sent, the connection is closed\n");
+            return -1;
+        }
+
+        if (bytes_sent == 0)
+        {
+            /* EAGAIN, the driver is full */
+            if (!may_wait) break;
+
+            if (p_link->wait(p_ctx, 1, -1) < 0)
+            {
+                printf("Problem during waiting for the port, the connection is closed\n");
+                return -1;
+            }
+            continue;
+        }
+
+        printf("Sent %d bytes.\n", bytes_sent);
+
+        p_ctx->tx_tokens -= bytes_sent;
+        to_write -= bytes_sent;
+        total_sent += bytes_sent;
+
+        /* Skip the sent bytes in the buffers */
+        left = (uint32_t) bytes_sent;
+        for (i = 0; i < count && left > 0; i++)
+        {
+            uint32_t done = ((uint32_t) p_sizes[i] < left) ? (uint32_t) p_sizes[i] : left;
+
+            SALT_HEXDUMP_DEBUG(pp_bufs[i], done);
+
+            pp_bufs[i] += done;
+            p_sizes[i] -= done;
+            left -= done;
+        }
+    }
+
+    return total_sent;
+}
+
+static uint32_t salt_io_tx_budget(salt_io_ctx_t *p_ctx)
+{
+    int32_t queued = p_ctx->p_transport->out_queue(p_ctx);
+    uint64_t now = salt_io_time_us();
+    double budget;
+
+    /* Refill the bucket with characters which left the UART meanwhile */
+    if (p_ctx->line_rate > 0)
+    {
+        p_ctx->tx_tokens += (double) (now - p_ctx->tx_refill_us) * p_ctx->line_rate / 1000000.0;
+    }
+    else
+    {
+        p_ctx->tx_tokens = p_ctx->tx_queue_limit;
+    }
+    if (p_ctx->tx_tokens > p_ctx->tx_queue_limit) p_ctx->tx_tokens = p_ctx->tx_queue_limit;
+    p_ctx->tx_refill_us = now;
+
+    budget = p_ctx->tx_tokens;
+
+    /* The real depth of the queue, if the driver knows it (not on com0com) */
+    if (queued >= 0 && (double) p_ctx->tx_queue_limit - queued < budget)
+    {
+        budget = ((uint32_t) queued < p_ctx->tx_queue_limit) ? 
+                  p_ctx->tx_queue_limit - queued : 0;
+    }
+
+    return (budget > 0) ? (uint32_t) budget : 0;
 }
 
+static int salt_io_tx_wait(salt_io_ctx_t *p_ctx, uint32_t needed, uint32_t budget)
+{
+    uint32_t wait_ms;
+
+    /* Without the line rate the time can not be estimated, wait for an empty queue */
+    if (p_ctx->line_rate == 0) return p_ctx->p_transport->drain(p_ctx);
+
+    wait_ms = (uint32_t) ((uint64_t) (needed - budget) * 1000 / p_ctx->line_rate) + 1;
+
+    return (sleep_miliseconds_win_linux(wait_ms) == 1) ? 0 : -1;
+}
 
 /* A function to create a timestamp that is included in sent/receivd messages */
 static salt_ret_t get_time(salt_time_t *p_time, uint32_t *time)
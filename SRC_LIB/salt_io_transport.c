@@ -0,0 +1,2642 @@
+/*
+ * salt_io_transport.c    v.0.1
+ *
+ * Transports of the salt I/O
+ *
+ * RS-232 port (rs232 library), AF_UNIX / TCP loopback sockets
+ * and the shared-memory ring used by my_write() and my_read().
+ *
+ * Windows/Linux (the sockets only on Linux)
+ *
+ * KEMT FEI TUKE, Diploma thesis
+ * ===============================================
+ */
+
+/* ==== Basic libraries for working in C ==== */
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+/* ======= Salt-channel libraries ======= */
+#include "salt_io.h"
+
+/* ======= RS-232 library ======= */
+#include "rs232.h"
+
+/* Sleep of the shared-memory ring while it waits for the other end */
+#define SALT_IO_RING_POLL_US        100
+
+/* Free / used bytes of the ring */
+static uint32_t salt_io_ring_free(salt_io_ring_t *p_ring);
+static uint32_t salt_io_ring_used(salt_io_ring_t *p_ring);
+
+/* ====== Serial transport (RS-232 port or pseudo terminal) ======= */
+
+/* Bytes of one write with the emulated noise, see salt_io_set_error_rate() */
+#define SALT_IO_NOISE_CHUNK         1024
+
+/* Copies the first bytes of the buffers, flips the bits hit by the noise and writes them */
+static int serial_send_noisy(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    uint8_t bytes[SALT_IO_NOISE_CHUNK];
+    uint32_t x = p_ctx->error_seed;
+    int len = 0, i, n;
+
+    for (i = 0; i < count && len < (int) sizeof(bytes); i++)
+    {
+        n = p_sizes[i];
+        if (n > (int) sizeof(bytes) - len) n = (int) sizeof(bytes) - len;
+
+        memcpy(&bytes[len], pp_bufs[i], n);
+        len += n;
+    }
+
+    /* xorshift32, one number for each bit */
+    for (i = 0; i < len * 8; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        if (x < p_ctx->error_threshold) bytes[i / 8] ^= (uint8_t) (1 << (i % 8));
+    }
+    p_ctx->error_seed = x;
+
+    return RS232_PortSendBuf(p_ctx->p_port, bytes, len);
+}
+
+static int serial_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    if (p_ctx->error_threshold > 0) return serial_send_noisy(p_ctx, pp_bufs, p_sizes, count);
+
+    if (count == 1) return RS232_PortSendBuf(p_ctx->p_port, pp_bufs[0], p_sizes[0]);
+
+    return RS232_PortSendBufv(p_ctx->p_port, pp_bufs, p_sizes, count);
+}
+
+static int serial_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    return RS232_PortPoll(p_ctx->p_port, p_buf, size);
+}
+
+static int serial_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    if (writable) return RS232_PortWaitWritable(p_ctx->p_port, timeout_ms);
+
+    return RS232_PortWait(p_ctx->p_port, timeout_ms);
+}
+
+static int serial_out_queue(salt_io_ctx_t *p_ctx)
+{
+    return RS232_PortGetOutQueue(p_ctx->p_port);
+}
+
+static int serial_in_queue(salt_io_ctx_t *p_ctx)
+{
+    return RS232_PortGetInQueue(p_ctx->p_port);
+}
+
+static int serial_drain(salt_io_ctx_t *p_ctx)
+{
+    return RS232_PortDrain(p_ctx->p_port);
+}
+
+static void serial_close(salt_io_ctx_t *p_ctx)
+{
+    RS232_PortClose(p_ctx->p_port);
+}
+
+static int serial_fd(salt_io_ctx_t *p_ctx)
+{
+#if defined(_WIN32)
+    (void) p_ctx;
+
+    /* A comm handle can not be polled */
+    return -1;
+#else
+    return p_ctx->p_port->fd;
+#endif
+}
+
+const salt_io_transport_t salt_io_serial_transport = {
+    "serial",
+    serial_send,
+    serial_recv,
+    serial_wait,
+    serial_out_queue,
+    serial_in_queue,
+    serial_drain,
+    serial_close,
+    serial_fd
+};
+
+/* ====== Socket transport (AF_UNIX, TCP loopback) ======= */
+
+#if !defined(_WIN32)
+
+static int socket_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    struct iovec iov[RS232_MAX_IOV];
+    struct msghdr msg;
+    ssize_t n;
+    int i;
+
+    if (count < 1 || count > RS232_MAX_IOV) return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        iov[i].iov_base = pp_bufs[i];
+        iov[i].iov_len = p_sizes[i];
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    /* The closed peer is reported by -1, not by SIGPIPE */
+    n = sendmsg(p_ctx->fd, &msg, MSG_NOSIGNAL);
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+
+    return (int) n;
+}
+
+static int socket_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    ssize_t n = recv(p_ctx->fd, p_buf, size, 0);
+
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+
+    /* End of the stream, the peer closed the link */
+    if (n == 0) return -1;
+
+    return (int) n;
+}
+
+static int socket_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd = p_ctx->fd;
+    pfd.events = writable ? POLLOUT : POLLIN;
+    pfd.revents = 0;
+
+    n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) return (errno == EINTR) ? 0 : -1;
+    if (n == 0) return 0;
+
+    /* POLLHUP with the data still readable is reported by recv() */
+    if (pfd.revents & (POLLERR | POLLNVAL)) return -1;
+
+    return 1;
+}
+
+static int socket_out_queue(salt_io_ctx_t *p_ctx)
+{
+    (void) p_ctx;
+
+    /* The socket buffers are large, my_write() is not paced */
+    return -1;
+}
+
+static int socket_in_queue(salt_io_ctx_t *p_ctx)
+{
+    int n;
+
+    if (ioctl(p_ctx->fd, FIONREAD, &n) == -1) return -1;
+
+    return n;
+}
+
+static int socket_drain(salt_io_ctx_t *p_ctx)
+{
+    (void) p_ctx;
+
+    /* The kernel delivers the queued bytes also after close() */
+    return 0;
+}
+
+static void socket_close(salt_io_ctx_t *p_ctx)
+{
+    if (p_ctx->fd >= 0) close(p_ctx->fd);
+    p_ctx->fd = -1;
+}
+
+static int socket_fd(salt_io_ctx_t *p_ctx)
+{
+    return p_ctx->fd;
+}
+
+const salt_io_transport_t salt_io_socket_transport = {
+    "socket",
+    socket_send,
+    socket_recv,
+    socket_wait,
+    socket_out_queue,
+    socket_in_queue,
+    socket_drain,
+    socket_close,
+    socket_fd
+};
+
+/* Opened socket is set up as the link of the context */
+static int salt_io_socket_setup(salt_io_ctx_t *p_ctx, int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        perror("unable to adjust socket flags ");
+        close(fd);
+        return 1;
+    }
+
+    salt_io_ctx_init(p_ctx, NULL);
+    p_ctx->p_transport = &salt_io_socket_transport;
+    p_ctx->fd = fd;
+    p_ctx->tx_coalesce_bytes = SALT_IO_TX_COALESCE_BYTES;
+    p_ctx->tx_coalesce_us = SALT_IO_TX_COALESCE_LATENCY;
+
+    return 0;
+}
+
+/* Accepts one client on the listening socket, which is closed then */
+static int salt_io_accept(int listen_fd)
+{
+    int fd = accept(listen_fd, NULL, NULL);
+
+    if (fd == -1) perror("unable to accept the client ");
+    close(listen_fd);
+
+    return fd;
+}
+
+int salt_io_open_unix(salt_io_ctx_t *p_ctx, const char *p_path, int listen_flag)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(p_path) >= sizeof(addr.sun_path))
+    {
+        printf("too long path of the socket \"%s\"\n", p_path);
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, p_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+    {
+        perror("unable to create socket ");
+        return 1;
+    }
+
+    if (listen_flag)
+    {
+        unlink(p_path);
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(fd, 1) == -1)
+        {
+            perror("unable to listen on socket ");
+            close(fd);
+            return 1;
+        }
+
+        fd = salt_io_accept(fd);
+        unlink(p_path);
+        if (fd == -1) return 1;
+    }
+    else if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+    {
+        perror("unable to connect socket ");
+        close(fd);
+        return 1;
+    }
+
+    return salt_io_socket_setup(p_ctx, fd);
+}
+
+int salt_io_open_tcp(salt_io_ctx_t *p_ctx, uint16_t port, int listen_flag)
+{
+    struct sockaddr_in addr;
+    int fd, one = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+    {
+        perror("unable to create socket ");
+        return 1;
+    }
+
+    if (listen_flag)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(fd, 1) == -1)
+        {
+            perror("unable to listen on socket ");
+            close(fd);
+            return 1;
+        }
+
+        fd = salt_io_accept(fd);
+        if (fd == -1) return 1;
+    }
+    else if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+    {
+        perror("unable to connect socket ");
+        close(fd);
+        return 1;
+    }
+
+    /* The frames are coalesced by my_write(), the kernel must not delay them */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return salt_io_socket_setup(p_ctx, fd);
+}
+
+#else /* _WIN32 */
+
+int salt_io_open_unix(salt_io_ctx_t *p_ctx, const char *p_path, int listen_flag)
+{
+    (void) p_ctx; (void) p_path; (void) listen_flag;
+    printf("sockets are not supported on windows\n");
+
+    return 1;
+}
+
+int salt_io_open_tcp(salt_io_ctx_t *p_ctx, uint16_t port, int listen_flag)
+{
+    (void) p_ctx; (void) port; (void) listen_flag;
+    printf("sockets are not supported on windows\n");
+
+    return 1;
+}
+
+#endif /* _WIN32 */
+
+/* ====== Rings (shared-memory transport and I/O thread) ======= */
+
+static uint32_t salt_io_ring_used(salt_io_ring_t *p_ring)
+{
+    return __atomic_load_n(&p_ring->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&p_ring->tail, __ATOMIC_ACQUIRE);
+}
+
+static uint32_t salt_io_ring_free(salt_io_ring_t *p_ring)
+{
+    return SALT_IO_RING_SIZE - salt_io_ring_used(p_ring);
+}
+
+static int salt_io_ring_write(salt_io_ring_t *p_ring, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    uint32_t head, space, part, offset;
+    int sent = 0, i;
+
+    if (__atomic_load_n(&p_ring->closed, __ATOMIC_ACQUIRE)) return -1;
+
+    /* Only the producer moves the head */
+    head = p_ring->head;
+    space = salt_io_ring_free(p_ring);
+
+    for (i = 0; i < count && space > 0; i++)
+    {
+        uint32_t size = ((uint32_t) p_sizes[i] < space) ? (uint32_t) p_sizes[i] : space;
+
+        /* The part up to the end of the buffer and the wrapped rest */
+        offset = head & (SALT_IO_RING_SIZE - 1);
+        part = (size < SALT_IO_RING_SIZE - offset) ? size : SALT_IO_RING_SIZE - offset;
+        memcpy(&p_ring->buffer[offset], pp_bufs[i], part);
+        memcpy(p_ring->buffer, pp_bufs[i] + part, size - part);
+
+        head += size;
+        space -= size;
+        sent += size;
+    }
+
+    /* The bytes are visible to the consumer before the head */
+    __atomic_store_n(&p_ring->head, head, __ATOMIC_RELEASE);
+
+    return sent;
+}
+
+static int salt_io_ring_read(salt_io_ring_t *p_ring, uint8_t *p_buf, int size)
+{
+    uint32_t tail, used, part, offset;
+
+    /* Only the consumer moves the tail */
+    tail = p_ring->tail;
+    used = salt_io_ring_used(p_ring);
+    if (used == 0)
+    {
+        return __atomic_load_n(&p_ring->closed, __ATOMIC_ACQUIRE) ? -1 : 0;
+    }
+
+    if ((uint32_t) size > used) size = (int) used;
+
+    offset = tail & (SALT_IO_RING_SIZE - 1);
+    part = ((uint32_t) size < SALT_IO_RING_SIZE - offset) ? (uint32_t) size : SALT_IO_RING_SIZE - offset;
+    memcpy(p_buf, &p_ring->buffer[offset], part);
+    memcpy(p_buf + part, p_ring->buffer, size - part);
+
+    /* The bytes are copied before the producer can overwrite them */
+    __atomic_store_n(&p_ring->tail, tail + size, __ATOMIC_RELEASE);
+
+    return size;
+}
+
+static int salt_io_ring_wait(salt_io_ring_t *p_ring, int writable, int timeout_ms)
+{
+    struct timeval start, now;
+
+    gettimeofday(&start, NULL);
+
+    /* The other end runs in the same process, it is polled */
+    for (;;)
+    {
+        if (writable ? salt_io_ring_free(p_ring) > 0 : salt_io_ring_used(p_ring) > 0) return 1;
+        if (__atomic_load_n(&p_ring->closed, __ATOMIC_ACQUIRE)) return writable ? -1 : 1;
+
+        gettimeofday(&now, NULL);
+        if (timeout_ms >= 0 &&
+            (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000 >= timeout_ms)
+        {
+            return 0;
+        }
+
+        usleep(SALT_IO_RING_POLL_US);
+    }
+}
+
+static void salt_io_ring_drain(salt_io_ring_t *p_ring)
+{
+    while (salt_io_ring_used(p_ring) > 0 && !__atomic_load_n(&p_ring->closed, __ATOMIC_ACQUIRE))
+    {
+        usleep(SALT_IO_RING_POLL_US);
+    }
+}
+
+/* ====== Shared-memory transport (two threads of one process) ======= */
+
+static int shm_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    return salt_io_ring_write(p_ctx->p_tx_ring, pp_bufs, p_sizes, count);
+}
+
+static int shm_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    return salt_io_ring_read(p_ctx->p_rx_ring, p_buf, size);
+}
+
+static int shm_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    return salt_io_ring_wait(writable ? p_ctx->p_tx_ring : p_ctx->p_rx_ring, writable, timeout_ms);
+}
+
+static int shm_out_queue(salt_io_ctx_t *p_ctx)
+{
+    (void) p_ctx;
+
+    /* A full ring is reported by send(), my_write() is not paced */
+    return -1;
+}
+
+static int shm_in_queue(salt_io_ctx_t *p_ctx)
+{
+    return (int) salt_io_ring_used(p_ctx->p_rx_ring);
+}
+
+static int shm_drain(salt_io_ctx_t *p_ctx)
+{
+    salt_io_ring_drain(p_ctx->p_tx_ring);
+
+    return 0;
+}
+
+static void shm_close(salt_io_ctx_t *p_ctx)
+{
+    /* The other end reads the rest and gets -1 then */
+    __atomic_store_n(&p_ctx->p_tx_ring->closed, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&p_ctx->p_rx_ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+static int shm_fd(salt_io_ctx_t *p_ctx)
+{
+    (void) p_ctx;
+
+    /* The ring is polled by shm_wait() only */
+    return -1;
+}
+
+const salt_io_transport_t salt_io_shm_transport = {
+    "shm",
+    shm_send,
+    shm_recv,
+    shm_wait,
+    shm_out_queue,
+    shm_in_queue,
+    shm_drain,
+    shm_close,
+    shm_fd
+};
+
+void salt_io_open_shm_pair(salt_io_ctx_t *p_ctx_a,
+                           salt_io_ctx_t *p_ctx_b,
+                           salt_io_shm_t *p_shm)
+{
+    memset(p_shm, 0, sizeof(salt_io_shm_t));
+
+    salt_io_ctx_init(p_ctx_a, NULL);
+    p_ctx_a->p_transport = &salt_io_shm_transport;
+    p_ctx_a->p_tx_ring = &p_shm->ring_ab;
+    p_ctx_a->p_rx_ring = &p_shm->ring_ba;
+
+    salt_io_ctx_init(p_ctx_b, NULL);
+    p_ctx_b->p_transport = &salt_io_shm_transport;
+    p_ctx_b->p_tx_ring = &p_shm->ring_ba;
+    p_ctx_b->p_rx_ring = &p_shm->ring_ab;
+
+    /* The ring is faster than the protocol, nothing to coalesce */
+}
+
+/* ====== I/O thread (owns the link, the protocol uses the rings) ======= */
+
+#if !defined(_WIN32)
+
+/* One byte into the pipe, a full pipe already wakes the reader */
+static void salt_io_wake(int fd)
+{
+    uint8_t one = 1;
+
+    if (write(fd, &one, 1) < 0) { /* EAGAIN */ }
+}
+
+/* Empties the pipe of the wakeups which were seen */
+static void salt_io_unwake(int fd)
+{
+    uint8_t bytes[64];
+
+    while (read(fd, bytes, sizeof(bytes)) > 0) { }
+}
+
+/*
+ * Sends the bytes of ring_tx, the ring is released after the link took 
+ * them, so salt_io_drain() sees an empty ring only after the send().
+ * With the line rate (pseudo terminal) only the bytes which would have 
+ * left the UART meanwhile are sent, as the pacing of my_write() does.
+ */
+static int salt_io_thread_send(salt_io_ctx_t *p_ctx, salt_io_thread_t *p_thread)
+{
+    salt_io_ring_t *p_ring = &p_thread->ring_tx;
+    uint32_t tail = p_ring->tail, used = salt_io_ring_used(p_ring), offset;
+    uint8_t *p_parts[2];
+    int sizes[2], parts = 1, n;
+    struct timeval tv;
+    uint64_t now;
+    uint32_t line_rate;
+
+    if (used == 0) return 0;
+
+    /* salt_io_set_baudrate() changes the rate from the thread of the session */
+    line_rate = __atomic_load_n(&p_thread->line_rate, __ATOMIC_RELAXED);
+    if (line_rate > 0)
+    {
+        gettimeofday(&tv, NULL);
+        now = (uint64_t) tv.tv_sec * 1000000 + (uint64_t) tv.tv_usec;
+
+        p_thread->tx_tokens += (double) (now - p_thread->tx_refill_us) * line_rate / 1000000.0;
+        if (p_thread->tx_tokens > SALT_IO_TX_QUEUE_LIMIT) p_thread->tx_tokens = SALT_IO_TX_QUEUE_LIMIT;
+        p_thread->tx_refill_us = now;
+
+        if ((double) used > p_thread->tx_tokens) used = (uint32_t) p_thread->tx_tokens;
+        if (used == 0) return 0;
+    }
+
+    offset = tail & (SALT_IO_RING_SIZE - 1);
+    p_parts[0] = &p_ring->buffer[offset];
+    sizes[0] = (int) ((used < SALT_IO_RING_SIZE - offset) ? used : SALT_IO_RING_SIZE - offset);
+    if ((uint32_t) sizes[0] < used)
+    {
+        /* The wrapped rest at the beginning of the buffer */
+        p_parts[1] = p_ring->buffer;
+        sizes[1] = (int) (used - sizes[0]);
+        parts = 2;
+    }
+
+    n = p_thread->p_link->send(p_ctx, p_parts, sizes, parts);
+    if (n > 0)
+    {
+        p_thread->tx_tokens -= n;
+        __atomic_store_n(&p_ring->tail, tail + n, __ATOMIC_RELEASE);
+    }
+
+    return n;
+}
+
+/*
+ * Receives what is in the input queue of the link into ring_rx. 
+ * Only the queued bytes are requested, a port with VMIN > 0 would
+ * block the thread in read() otherwise. An empty queue is read only
+ * when poll() reported the link readable (the end of the stream).
+ */
+static int salt_io_thread_recv(salt_io_ctx_t *p_ctx, salt_io_thread_t *p_thread, int readable)
+{
+    salt_io_ring_t *p_ring = &p_thread->ring_rx;
+    uint32_t head = p_ring->head, space = salt_io_ring_free(p_ring), offset;
+    int queued, n;
+
+    if (space == 0) return 0;
+
+    queued = p_thread->p_link->in_queue(p_ctx);
+    if (queued == 0 && !readable) return 0;
+    if (queued == 0) queued = 1;
+
+    /* Directly into the ring, up to its end */
+    offset = head & (SALT_IO_RING_SIZE - 1);
+    if (space > SALT_IO_RING_SIZE - offset) space = SALT_IO_RING_SIZE - offset;
+    if (queued > 0 && (uint32_t) queued < space) space = (uint32_t) queued;
+
+    n = p_thread->p_link->recv(p_ctx, &p_ring->buffer[offset], (int) space);
+    if (n > 0)
+    {
+        __atomic_store_n(&p_ring->head, head + n, __ATOMIC_RELEASE);
+        salt_io_wake(p_thread->wake_rx[1]);
+    }
+
+    return n;
+}
+
+static void *salt_io_thread_main(void *p_arg)
+{
+    salt_io_ctx_t *p_ctx = (salt_io_ctx_t *) p_arg;
+    salt_io_thread_t *p_thread = p_ctx->p_thread;
+    int link_fd = p_thread->p_link->fd(p_ctx);
+    struct pollfd pfd[2];
+    int sent, received, readable = 0, paced, timeout_ms;
+
+    for (;;)
+    {
+        sent = salt_io_thread_send(p_ctx, p_thread);
+        received = salt_io_thread_recv(p_ctx, p_thread, readable);
+        readable = 0;
+
+        if (sent < 0 || received < 0) break;
+
+        /* The rest of the frames is sent before the thread ends */
+        if (__atomic_load_n(&p_thread->stop, __ATOMIC_ACQUIRE) && 
+            salt_io_ring_used(&p_thread->ring_tx) == 0)
+        {
+            break;
+        }
+
+        if (sent > 0 || received > 0) continue;
+
+        /* Sleep until the link or the protocol thread has something */
+        pfd[0].fd = p_thread->wake_tx[0];
+        pfd[0].events = POLLIN;
+        pfd[1].fd = link_fd;
+        pfd[1].events = (salt_io_ring_free(&p_thread->ring_rx) > 0) ? POLLIN : 0;
+
+        /* Bytes without the tokens wait for the refill, not for the link */
+        paced = (salt_io_ring_used(&p_thread->ring_tx) > 0) && 
+                (__atomic_load_n(&p_thread->line_rate, __ATOMIC_RELAXED) > 0);
+        if (salt_io_ring_used(&p_thread->ring_tx) > 0 && !paced) pfd[1].events |= POLLOUT;
+
+        /* A link without a descriptor, the refill and the space freed by my_read() are polled */
+        timeout_ms = (link_fd >= 0 && (pfd[1].events & POLLIN) && !paced) ? -1 : 1;
+        if (poll(pfd, (link_fd >= 0) ? 2 : 1, timeout_ms) < 0 && errno != EINTR) break;
+        if (link_fd >= 0 && (pfd[1].revents & (POLLERR | POLLNVAL))) break;
+        readable = (link_fd >= 0) && (pfd[1].revents & (POLLIN | POLLHUP));
+
+        salt_io_unwake(p_thread->wake_tx[0]);
+    }
+
+    /* The link failed or is stopped, both ends of the rings see it */
+    __atomic_store_n(&p_thread->ring_tx.closed, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&p_thread->ring_rx.closed, 1, __ATOMIC_RELEASE);
+    salt_io_wake(p_thread->wake_rx[1]);
+
+    return NULL;
+}
+
+static int thread_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    int n = salt_io_ring_write(&p_ctx->p_thread->ring_tx, pp_bufs, p_sizes, count);
+
+    if (n > 0) salt_io_wake(p_ctx->p_thread->wake_tx[1]);
+
+    return n;
+}
+
+static int thread_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    /* Wakeups before the read, a later one belongs to new bytes */
+    salt_io_unwake(p_ctx->p_thread->wake_rx[0]);
+
+    return salt_io_ring_read(&p_ctx->p_thread->ring_rx, p_buf, size);
+}
+
+static int thread_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    salt_io_thread_t *p_thread = p_ctx->p_thread;
+    struct pollfd pfd;
+    struct timeval start, now;
+    int remaining = timeout_ms, n;
+
+    /* The thread does not report free space, ring_tx is polled */
+    if (writable) return salt_io_ring_wait(&p_thread->ring_tx, 1, timeout_ms);
+
+    gettimeofday(&start, NULL);
+
+    for (;;)
+    {
+        n = salt_io_ring_wait(&p_thread->ring_rx, 0, 0);
+        if (n != 0) return n;
+
+        pfd.fd = p_thread->wake_rx[0];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        n = poll(&pfd, 1, remaining);
+        if (n < 0 && errno != EINTR) return -1;
+
+        salt_io_unwake(p_thread->wake_rx[0]);
+
+        if (timeout_ms >= 0)
+        {
+            gettimeofday(&now, NULL);
+            remaining = timeout_ms - (int) ((now.tv_sec - start.tv_sec) * 1000 + 
+                                            (now.tv_usec - start.tv_usec) / 1000);
+            if (remaining <= 0) return salt_io_ring_wait(&p_thread->ring_rx, 0, 0);
+        }
+    }
+}
+
+static int thread_out_queue(salt_io_ctx_t *p_ctx)
+{
+    (void) p_ctx;
+
+    /* A full ring is reported by send(), the thread waits for the link */
+    return -1;
+}
+
+static int thread_in_queue(salt_io_ctx_t *p_ctx)
+{
+    return (int) salt_io_ring_used(&p_ctx->p_thread->ring_rx);
+}
+
+static int thread_drain(salt_io_ctx_t *p_ctx)
+{
+    salt_io_ring_drain(&p_ctx->p_thread->ring_tx);
+
+    if (__atomic_load_n(&p_ctx->p_thread->ring_tx.closed, __ATOMIC_ACQUIRE)) return -1;
+
+    return p_ctx->p_thread->p_link->drain(p_ctx);
+}
+
+static void thread_close(salt_io_ctx_t *p_ctx)
+{
+    salt_io_thread_t *p_thread = p_ctx->p_thread;
+
+    __atomic_store_n(&p_thread->stop, 1, __ATOMIC_RELEASE);
+    salt_io_wake(p_thread->wake_tx[1]);
+    pthread_join(p_thread->thread, NULL);
+
+    close(p_thread->wake_tx[0]);
+    close(p_thread->wake_tx[1]);
+    close(p_thread->wake_rx[0]);
+    close(p_thread->wake_rx[1]);
+
+    /* The link is closed by its own transport again */
+    p_ctx->p_transport = p_thread->p_link;
+    p_ctx->p_thread = NULL;
+    p_ctx->p_transport->close(p_ctx);
+}
+
+static int thread_fd(salt_io_ctx_t *p_ctx)
+{
+    /* Readable when the thread received new bytes */
+    return p_ctx->p_thread->wake_rx[0];
+}
+
+const salt_io_transport_t salt_io_thread_transport = {
+    "thread",
+    thread_send,
+    thread_recv,
+    thread_wait,
+    thread_out_queue,
+    thread_in_queue,
+    thread_drain,
+    thread_close,
+    thread_fd
+};
+
+/* Pipe with the non-blocking ends */
+static int salt_io_wake_pipe(int fds[2])
+{
+    if (pipe(fds) == -1) return -1;
+
+    if (fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(fds[1], F_SETFL, O_NONBLOCK) == -1)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    return 0;
+}
+
+int salt_io_start_thread(salt_io_ctx_t *p_ctx, salt_io_thread_t *p_thread)
+{
+    /* The ARQ, the FEC and the bond run in the calls of the protocol, they can be started above the thread only */
+    if (p_ctx->p_transport == &salt_io_thread_transport || p_ctx->p_arq != NULL || 
+        p_ctx->p_fec != NULL || p_ctx->p_bond != NULL || p_ctx->p_uring != NULL || 
+        salt_io_drain(p_ctx) != 0)
+    {
+        return 1;
+    }
+
+    memset(p_thread, 0, sizeof(salt_io_thread_t));
+    p_thread->p_link = p_ctx->p_transport;
+
+    if (salt_io_wake_pipe(p_thread->wake_tx) != 0)
+    {
+        perror("unable to create pipe ");
+        return 1;
+    }
+    if (salt_io_wake_pipe(p_thread->wake_rx) != 0)
+    {
+        perror("unable to create pipe ");
+        close(p_thread->wake_tx[0]);
+        close(p_thread->wake_tx[1]);
+        return 1;
+    }
+
+    /* The thread paces the line instead of my_write() */
+    p_thread->line_rate = p_ctx->line_rate;
+    p_thread->tx_tokens = SALT_IO_TX_QUEUE_LIMIT;
+    p_thread->tx_refill_us = p_ctx->tx_refill_us;
+
+    p_ctx->p_thread = p_thread;
+    p_ctx->p_transport = &salt_io_thread_transport;
+
+    if (pthread_create(&p_thread->thread, NULL, salt_io_thread_main, p_ctx) != 0)
+    {
+        printf("unable to create the I/O thread\n");
+        p_ctx->p_transport = p_thread->p_link;
+        p_ctx->p_thread = NULL;
+        close(p_thread->wake_tx[0]);
+        close(p_thread->wake_tx[1]);
+        close(p_thread->wake_rx[0]);
+        close(p_thread->wake_rx[1]);
+        return 1;
+    }
+
+    /* The ring takes the frames at once, the thread waits for the line */
+    p_ctx->line_rate = 0;
+    p_ctx->tx_coalesce_bytes = 0;
+    p_ctx->read_batching = 1;
+
+    return 0;
+}
+
+#else /* _WIN32 */
+
+int salt_io_start_thread(salt_io_ctx_t *p_ctx, salt_io_thread_t *p_thread)
+{
+    (void) p_ctx; (void) p_thread;
+    printf("the I/O thread is not supported on windows\n");
+
+    return 1;
+}
+
+#endif /* _WIN32 */
+
+/* ====== COBS framing and CRC32C (framing of my_write() / my_read() and the ARQ) ======= */
+
+/*
+ * COBS: each block starts with the distance to the next zero of the frame
+ * (at most 254 bytes), the zeros are dropped, so a zero ends the frame.
+ */
+uint32_t salt_io_cobs_encode(const uint8_t *p_src, uint32_t size, uint8_t *p_dst)
+{
+    uint32_t code_at = 0, out = 1, i;
+    uint8_t code = 1;
+
+    for (i = 0; i < size; i++)
+    {
+        if (p_src[i] != 0)
+        {
+            p_dst[out++] = p_src[i];
+            code++;
+        }
+
+        if (p_src[i] == 0 || code == 0xFF)
+        {
+            p_dst[code_at] = code;
+            code_at = out++;
+            code = 1;
+        }
+    }
+
+    p_dst[code_at] = code;
+    p_dst[out++] = 0;
+
+    return out;
+}
+
+int salt_io_cobs_decode(salt_io_cobs_t *p_cobs, uint8_t *p_frame, uint32_t max_size, uint8_t byte)
+{
+    uint8_t zero;
+
+    if (byte == 0)
+    {
+        /* End of the frame, a block cut short is damaged too */
+        zero = p_cobs->drop || p_cobs->code != 0;
+
+        p_cobs->code = p_cobs->zero = p_cobs->drop = 0;
+
+        return zero ? -1 : 1;
+    }
+
+    if (p_cobs->drop) return 0;
+
+    if (p_cobs->code == 0)
+    {
+        /* Code of the next block, the previous short block ended with a zero */
+        zero = p_cobs->zero;
+        p_cobs->zero = (byte < 0xFF);
+        p_cobs->code = byte - 1;
+
+        if (!zero) return 0;
+        byte = 0;
+    }
+    else
+    {
+        p_cobs->code--;
+    }
+
+    if (p_cobs->len == max_size)
+    {
+        /* Longer than any frame of the writer, a delimiter was lost */
+        p_cobs->drop = 1;
+        return 0;
+    }
+
+    p_frame[p_cobs->len++] = byte;
+
+    return 0;
+}
+
+/* 
+ * Slicing-by-8 tables of the reflected polynomial 0x82F63B78, built once 
+ * by the first call (the writer thread and the I/O thread may be first)
+ */
+static uint32_t salt_io_crc32c_table[8][256];
+static pthread_once_t salt_io_crc32c_once = PTHREAD_ONCE_INIT;
+
+static void salt_io_crc32c_init(void)
+{
+    uint32_t crc;
+    int i, j;
+
+    for (i = 0; i < 256; i++)
+    {
+        crc = (uint32_t) i;
+        for (j = 0; j < 8; j++) crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78U : 0);
+        salt_io_crc32c_table[0][i] = crc;
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        for (j = 1; j < 8; j++)
+        {
+            crc = salt_io_crc32c_table[j - 1][i];
+            salt_io_crc32c_table[j][i] = (crc >> 8) ^ salt_io_crc32c_table[0][crc & 0xFF];
+        }
+    }
+}
+
+uint32_t salt_io_crc32c(uint32_t crc, const uint8_t *p_data, uint32_t size)
+{
+    const uint32_t (*t)[256] = salt_io_crc32c_table;
+    uint32_t lo, hi;
+
+    pthread_once(&salt_io_crc32c_once, salt_io_crc32c_init);
+
+    crc = ~crc;
+
+    /* 8 bytes by 8 lookups instead of 8 dependent steps */
+    while (size >= 8)
+    {
+        lo = crc ^ ((uint32_t) p_data[0] | (uint32_t) p_data[1] << 8 | 
+                    (uint32_t) p_data[2] << 16 | (uint32_t) p_data[3] << 24);
+        hi = (uint32_t) p_data[4] | (uint32_t) p_data[5] << 8 | 
+             (uint32_t) p_data[6] << 16 | (uint32_t) p_data[7] << 24;
+
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+
+        p_data += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0) crc = (crc >> 8) ^ t[0][(crc ^ *p_data++) & 0xFF];
+
+    return ~crc;
+}
+
+/* ====== Selective-repeat ARQ (owns the link, runs in my_write() / my_read()) ======= */
+
+/* Types of the chunks, an acknowledgement carries rx_next and the SACK bitmap */
+#define SALT_IO_ARQ_DATA            1
+#define SALT_IO_ARQ_ACK             2
+#define SALT_IO_ARQ_SACK_SIZE       4
+
+/* Encoded length of a frame of size bytes */
+#define SALT_IO_ARQ_ENCODED(size)   ((size) + (size) / 254 + 2)
+
+static uint64_t salt_io_arq_time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t) tv.tv_sec * 1000000 + (uint64_t) tv.tv_usec;
+}
+
+/* Encodes one chunk or acknowledgement into the wire buffer, 0 if it has no room */
+static int salt_io_arq_put(salt_io_arq_t *p_arq, uint8_t type, uint16_t seq, 
+                           const uint8_t *p_data, uint32_t size)
+{
+    uint8_t frame[SALT_IO_ARQ_FRAME_SIZE];
+    uint32_t len = SALT_IO_ARQ_HEADER_SIZE + size, crc;
+
+    if (SALT_IO_ARQ_WIRE_SIZE - p_arq->wire_len < SALT_IO_ARQ_ENCODED(len + SALT_IO_ARQ_CRC_SIZE))
+    {
+        return 0;
+    }
+
+    frame[0] = type;
+    frame[1] = (uint8_t) seq;
+    frame[2] = (uint8_t) (seq >> 8);
+    memcpy(&frame[SALT_IO_ARQ_HEADER_SIZE], p_data, size);
+
+    crc = salt_io_crc32c(0, frame, len);
+    frame[len++] = (uint8_t) crc;
+    frame[len++] = (uint8_t) (crc >> 8);
+    frame[len++] = (uint8_t) (crc >> 16);
+    frame[len++] = (uint8_t) (crc >> 24);
+
+    p_arq->wire_len += salt_io_cobs_encode(frame, len, &p_arq->wire[p_arq->wire_len]);
+
+    return 1;
+}
+
+/* 1 if a new chunk fits into the window and its encoding into the wire buffer */
+static int salt_io_arq_room(salt_io_arq_t *p_arq)
+{
+    return (uint16_t) (p_arq->tx_next - p_arq->tx_base) < SALT_IO_ARQ_WINDOW &&
+           SALT_IO_ARQ_WIRE_SIZE - p_arq->wire_len >= SALT_IO_ARQ_ENCODED(SALT_IO_ARQ_FRAME_SIZE);
+}
+
+/* Timeout of the chunk in microseconds, each repetition doubles it up to SALT_IO_ARQ_RTO_MAX */
+static double salt_io_arq_timeout(salt_io_arq_t *p_arq, salt_io_arq_chunk_t *p_chunk)
+{
+    double timeout = p_arq->rto_us * (1 << ((p_chunk->retries < 3) ? p_chunk->retries : 3));
+
+    return (timeout < SALT_IO_ARQ_RTO_MAX * 1000.0) ? timeout : SALT_IO_ARQ_RTO_MAX * 1000.0;
+}
+
+/* Bytes which the link did not send yet, the ring of the I/O thread is not in its out_queue() */
+static int salt_io_arq_link_queue(salt_io_ctx_t *p_ctx)
+{
+    const salt_io_transport_t *p_link = p_ctx->p_arq->p_link;
+    int queued = 0, n;
+
+    if (p_link == &salt_io_thread_transport)
+    {
+        queued = (int) salt_io_ring_used(&p_ctx->p_thread->ring_tx);
+        p_link = p_ctx->p_thread->p_link;
+    }
+
+    n = p_link->out_queue(p_ctx);
+
+    return (n > 0) ? queued + n : queued;
+}
+
+/* Sends the chunk seq again */
+static void salt_io_arq_resend(salt_io_arq_t *p_arq, uint16_t seq, uint64_t now)
+{
+    salt_io_arq_chunk_t *p_chunk = &p_arq->tx[seq % SALT_IO_ARQ_WINDOW];
+
+    /* A full wire buffer, the next call tries again */
+    if (!salt_io_arq_put(p_arq, SALT_IO_ARQ_DATA, seq, p_chunk->data, p_chunk->size)) return;
+
+    p_chunk->sent_us = now;
+    p_chunk->timer_us = now;
+    if (p_chunk->retries < 255) p_chunk->retries++;
+    p_arq->retransmits++;
+}
+
+/* The chunk seq arrived, the round trip of a chunk sent once updates the timeout */
+static void salt_io_arq_acked(salt_io_arq_t *p_arq, uint16_t seq, uint64_t now)
+{
+    salt_io_arq_chunk_t *p_chunk = &p_arq->tx[seq % SALT_IO_ARQ_WINDOW];
+    double rtt;
+
+    if (!p_chunk->used) return;
+    p_chunk->used = 0;
+
+    /* Karn: the round trip of a repeated chunk is ambiguous */
+    if (p_chunk->retries > 0) return;
+
+    rtt = (double) (now - p_chunk->sent_us);
+    if (p_arq->srtt_us == 0)
+    {
+        p_arq->srtt_us = rtt;
+        p_arq->rttvar_us = rtt / 2;
+    }
+    else
+    {
+        p_arq->rttvar_us = 0.75 * p_arq->rttvar_us + 0.25 * ((p_arq->srtt_us > rtt) ? 
+                                                             p_arq->srtt_us - rtt : rtt - p_arq->srtt_us);
+        p_arq->srtt_us = 0.875 * p_arq->srtt_us + 0.125 * rtt;
+    }
+
+    p_arq->rto_us = p_arq->srtt_us + 4 * p_arq->rttvar_us;
+    if (p_arq->rto_us < SALT_IO_ARQ_RTO_MIN * 1000.0) p_arq->rto_us = SALT_IO_ARQ_RTO_MIN * 1000.0;
+    if (p_arq->rto_us > SALT_IO_ARQ_RTO_MAX * 1000.0) p_arq->rto_us = SALT_IO_ARQ_RTO_MAX * 1000.0;
+}
+
+/* Acknowledgement: the chunks before next and the ones in the SACK bitmap arrived */
+static void salt_io_arq_ack(salt_io_arq_t *p_arq, uint16_t next, const uint8_t *p_sack, uint64_t now)
+{
+    uint16_t in_flight = (uint16_t) (p_arq->tx_next - p_arq->tx_base), seq, highest = next;
+    int i;
+
+    /* An older acknowledgement (reordered) or one of chunks which were never sent */
+    if ((uint16_t) (next - p_arq->tx_base) > in_flight) return;
+
+    for (seq = p_arq->tx_base; seq != next; seq++) salt_io_arq_acked(p_arq, seq, now);
+
+    for (i = 0; i < SALT_IO_ARQ_WINDOW - 1; i++)
+    {
+        seq = (uint16_t) (next + 1 + i);
+        if ((uint16_t) (seq - p_arq->tx_base) >= in_flight) break;
+
+        if (p_sack[i / 8] & (1 << (i % 8)))
+        {
+            salt_io_arq_acked(p_arq, seq, now);
+            highest = seq;
+        }
+    }
+
+    /* The chunks before a later one which arrived were lost, they do not wait for the timeout */
+    for (seq = next; seq != highest; seq++)
+    {
+        if (p_arq->tx[seq % SALT_IO_ARQ_WINDOW].used && 
+            (double) (now - p_arq->tx[seq % SALT_IO_ARQ_WINDOW].sent_us) > p_arq->srtt_us)
+        {
+            salt_io_arq_resend(p_arq, seq, now);
+        }
+    }
+
+    while (p_arq->tx_base != p_arq->tx_next && !p_arq->tx[p_arq->tx_base % SALT_IO_ARQ_WINDOW].used)
+    {
+        p_arq->tx_base++;
+    }
+}
+
+/* Data chunk: kept in the window of the receiver, a repeated one is acknowledged again */
+static void salt_io_arq_data(salt_io_arq_t *p_arq, uint16_t seq, const uint8_t *p_data, uint32_t size)
+{
+    salt_io_arq_chunk_t *p_chunk = &p_arq->rx[seq % SALT_IO_ARQ_WINDOW];
+
+    p_arq->ack_pending = 1;
+    p_arq->data_us = salt_io_arq_time_us();
+
+    if ((uint16_t) (seq - p_arq->rx_next) >= SALT_IO_ARQ_WINDOW || p_chunk->used) return;
+
+    memcpy(p_chunk->data, p_data, size);
+    p_chunk->size = (uint16_t) size;
+    p_chunk->used = 1;
+}
+
+/* One decoded frame of the link, a wrong CRC32C drops it */
+static void salt_io_arq_input(salt_io_arq_t *p_arq, uint32_t len, uint64_t now)
+{
+    uint8_t *p_frame = p_arq->in_frame;
+    uint32_t size, crc;
+    uint16_t seq;
+
+    if (len < SALT_IO_ARQ_HEADER_SIZE + SALT_IO_ARQ_CRC_SIZE)
+    {
+        p_arq->damaged++;
+        return;
+    }
+
+    size = len - SALT_IO_ARQ_HEADER_SIZE - SALT_IO_ARQ_CRC_SIZE;
+    crc = (uint32_t) p_frame[len - 4] | (uint32_t) p_frame[len - 3] << 8 | 
+          (uint32_t) p_frame[len - 2] << 16 | (uint32_t) p_frame[len - 1] << 24;
+
+    if (crc != salt_io_crc32c(0, p_frame, len - SALT_IO_ARQ_CRC_SIZE))
+    {
+        p_arq->damaged++;
+        return;
+    }
+
+    seq = (uint16_t) (p_frame[1] | p_frame[2] << 8);
+
+    if (p_frame[0] == SALT_IO_ARQ_DATA) 
+    {
+        salt_io_arq_data(p_arq, seq, &p_frame[SALT_IO_ARQ_HEADER_SIZE], size);
+    }
+    else if (p_frame[0] == SALT_IO_ARQ_ACK && size == SALT_IO_ARQ_SACK_SIZE)
+    {
+        salt_io_arq_ack(p_arq, seq, &p_frame[SALT_IO_ARQ_HEADER_SIZE], now);
+    }
+    else
+    {
+        p_arq->damaged++;
+    }
+}
+
+/* Moves the chunks in order into the ready bytes while they fit */
+static void salt_io_arq_deliver(salt_io_arq_t *p_arq)
+{
+    salt_io_arq_chunk_t *p_chunk;
+
+    while ((p_chunk = &p_arq->rx[p_arq->rx_next % SALT_IO_ARQ_WINDOW])->used)
+    {
+        if (sizeof(p_arq->ready) - p_arq->ready_end < p_chunk->size && p_arq->ready_begin > 0)
+        {
+            memmove(p_arq->ready, &p_arq->ready[p_arq->ready_begin], 
+                    p_arq->ready_end - p_arq->ready_begin);
+            p_arq->ready_end -= p_arq->ready_begin;
+            p_arq->ready_begin = 0;
+        }
+
+        /* my_read() makes room, the chunk stays unacknowledged until then */
+        if (sizeof(p_arq->ready) - p_arq->ready_end < p_chunk->size) break;
+
+        memcpy(&p_arq->ready[p_arq->ready_end], p_chunk->data, p_chunk->size);
+        p_arq->ready_end += p_chunk->size;
+        p_chunk->used = 0;
+        p_arq->rx_next++;
+        p_arq->ack_pending = 1;
+    }
+}
+
+/* Writes the wire buffer, the rest waits for the next call */
+static int salt_io_arq_flush(salt_io_ctx_t *p_ctx)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+    uint8_t *p_buf = p_arq->wire;
+    int size = (int) p_arq->wire_len, n;
+
+    if (size == 0) return 0;
+
+    n = p_arq->p_link->send(p_ctx, &p_buf, &size, 1);
+    if (n < 0)
+    {
+        p_arq->failed = 1;
+        return -1;
+    }
+
+    p_arq->wire_len -= (uint32_t) n;
+    memmove(p_arq->wire, &p_arq->wire[n], p_arq->wire_len);
+
+    return 0;
+}
+
+/*
+ * One step of the ARQ: decodes what is in the input queue of the link, 
+ * moves the chunks in order to the ready bytes, repeats the chunks whose 
+ * timeout expired, acknowledges and writes the wire buffer.
+ */
+static int salt_io_arq_pump(salt_io_ctx_t *p_ctx)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+    uint8_t bytes[512];
+    uint64_t now = salt_io_arq_time_us();
+    int queued, n, i, ret, busy;
+    uint16_t seq;
+
+    if (p_arq->failed) return -1;
+
+    /* An empty queue is read only when the wait saw the link readable (the end of the stream) */
+    for (;;)
+    {
+        queued = p_arq->p_link->in_queue(p_ctx);
+        if (queued <= 0 && !p_arq->readable) break;
+        p_arq->readable = 0;
+
+        if (queued <= 0) queued = 1;
+        if (queued > (int) sizeof(bytes)) queued = sizeof(bytes);
+
+        n = p_arq->p_link->recv(p_ctx, bytes, queued);
+        if (n < 0)
+        {
+            p_arq->failed = 1;
+            return -1;
+        }
+        if (n == 0) break;
+
+        for (i = 0; i < n; i++)
+        {
+            ret = salt_io_cobs_decode(&p_arq->in_cobs, p_arq->in_frame, sizeof(p_arq->in_frame), bytes[i]);
+            if (ret == 0) continue;
+
+            if (ret > 0 && p_arq->in_cobs.len > 0) salt_io_arq_input(p_arq, p_arq->in_cobs.len, now);
+            else if (ret < 0) p_arq->damaged++;
+            p_arq->in_cobs.len = 0;
+        }
+    }
+
+    salt_io_arq_deliver(p_arq);
+
+    /* While the link sends older bytes the chunks can not be late, their timeouts start again */
+    busy = (p_arq->wire_len > 0 || salt_io_arq_link_queue(p_ctx) > 0);
+
+    for (seq = p_arq->tx_base; seq != p_arq->tx_next; seq++)
+    {
+        salt_io_arq_chunk_t *p_chunk = &p_arq->tx[seq % SALT_IO_ARQ_WINDOW];
+
+        if (!p_chunk->used) continue;
+
+        if (now - p_chunk->first_us >= (uint64_t) SALT_IO_ARQ_DEAD_MS * 1000)
+        {
+            p_arq->failed = 1;
+            return -1;
+        }
+
+        if (busy) p_chunk->timer_us = now;
+        else if ((double) (now - p_chunk->timer_us) >= salt_io_arq_timeout(p_arq, p_chunk))
+        {
+            salt_io_arq_resend(p_arq, seq, now);
+        }
+    }
+
+    /* The last acknowledgement could be lost, it is repeated while the sender may wait for it */
+    if (p_arq->data_us != 0 && now - p_arq->data_us < (uint64_t) SALT_IO_ARQ_RTO_MAX * 1000 &&
+        now - p_arq->ack_us >= (uint64_t) SALT_IO_ARQ_ACK_REPEAT * 1000)
+    {
+        p_arq->ack_pending = 1;
+    }
+
+    if (p_arq->ack_pending)
+    {
+        uint8_t sack[SALT_IO_ARQ_SACK_SIZE] = { 0 };
+
+        for (i = 0; i < SALT_IO_ARQ_WINDOW - 1; i++)
+        {
+            if (p_arq->rx[(uint16_t) (p_arq->rx_next + 1 + i) % SALT_IO_ARQ_WINDOW].used)
+            {
+                sack[i / 8] |= (uint8_t) (1 << (i % 8));
+            }
+        }
+
+        if (salt_io_arq_put(p_arq, SALT_IO_ARQ_ACK, p_arq->rx_next, sack, sizeof(sack)))
+        {
+            p_arq->ack_pending = 0;
+            p_arq->ack_us = now;
+        }
+    }
+
+    return salt_io_arq_flush(p_ctx);
+}
+
+/* 
+ * Sleeps until the link is ready, the first timeout of a chunk, the next
+ * repetition of the acknowledgement or timeout_ms (< 0 forever). 
+ */
+static int salt_io_arq_idle(salt_io_ctx_t *p_ctx, int timeout_ms)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+    uint64_t now = salt_io_arq_time_us();
+    double left, first = -1;
+    uint16_t seq;
+    int n;
+
+    for (seq = p_arq->tx_base; seq != p_arq->tx_next; seq++)
+    {
+        salt_io_arq_chunk_t *p_chunk = &p_arq->tx[seq % SALT_IO_ARQ_WINDOW];
+
+        if (!p_chunk->used) continue;
+
+        left = salt_io_arq_timeout(p_arq, p_chunk) - (double) (now - p_chunk->timer_us);
+        if (first < 0 || left < first) first = (left > 0) ? left : 0;
+    }
+
+    if (p_arq->data_us != 0 && now - p_arq->data_us < (uint64_t) SALT_IO_ARQ_RTO_MAX * 1000)
+    {
+        left = SALT_IO_ARQ_ACK_REPEAT * 1000.0 - (double) (now - p_arq->ack_us);
+        if (first < 0 || left < first) first = (left > 0) ? left : 0;
+    }
+
+    if (first >= 0 && (timeout_ms < 0 || first / 1000 < timeout_ms)) timeout_ms = (int) (first / 1000) + 1;
+
+    /* The bytes in the wire buffer wait for the link first */
+    if (p_arq->wire_len > 0) 
+    {
+        n = p_arq->p_link->wait(p_ctx, 1, timeout_ms);
+    }
+    else 
+    {
+        n = p_arq->p_link->wait(p_ctx, 0, timeout_ms);
+        if (n > 0) p_arq->readable = 1;
+    }
+
+    if (n < 0) p_arq->failed = 1;
+
+    return n;
+}
+
+static int arq_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+    salt_io_arq_chunk_t *p_chunk;
+    uint64_t now = salt_io_arq_time_us();
+    int total = 0, i = 0, offset = 0, n;
+
+    if (salt_io_arq_pump(p_ctx) < 0) return -1;
+
+    /* The buffers are cut into chunks, each one is sent at once */
+    while (i < count && salt_io_arq_room(p_arq))
+    {
+        p_chunk = &p_arq->tx[p_arq->tx_next % SALT_IO_ARQ_WINDOW];
+        p_chunk->size = 0;
+
+        while (i < count && p_chunk->size < SALT_IO_ARQ_CHUNK)
+        {
+            n = p_sizes[i] - offset;
+            if (n > SALT_IO_ARQ_CHUNK - p_chunk->size) n = SALT_IO_ARQ_CHUNK - p_chunk->size;
+
+            memcpy(&p_chunk->data[p_chunk->size], &pp_bufs[i][offset], n);
+            p_chunk->size += n;
+            offset += n;
+
+            if (offset == p_sizes[i])
+            {
+                i++;
+                offset = 0;
+            }
+        }
+        if (p_chunk->size == 0) break;
+
+        salt_io_arq_put(p_arq, SALT_IO_ARQ_DATA, p_arq->tx_next, p_chunk->data, p_chunk->size);
+        p_chunk->used = 1;
+        p_chunk->retries = 0;
+        p_chunk->sent_us = now;
+        p_chunk->timer_us = now;
+        p_chunk->first_us = now;
+        p_arq->tx_next++;
+        total += p_chunk->size;
+    }
+
+    if (salt_io_arq_flush(p_ctx) < 0) return -1;
+
+    return total;
+}
+
+static int arq_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+    uint32_t available;
+
+    if (salt_io_arq_pump(p_ctx) < 0) return -1;
+
+    available = p_arq->ready_end - p_arq->ready_begin;
+    if (available > (uint32_t) size) available = (uint32_t) size;
+
+    memcpy(p_buf, &p_arq->ready[p_arq->ready_begin], available);
+    p_arq->ready_begin += available;
+    if (p_arq->ready_begin == p_arq->ready_end) p_arq->ready_begin = p_arq->ready_end = 0;
+
+    /* The chunks which waited for the room are acknowledged now */
+    if (p_arq->rx[p_arq->rx_next % SALT_IO_ARQ_WINDOW].used && salt_io_arq_pump(p_ctx) < 0) return -1;
+
+    return (int) available;
+}
+
+static int arq_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+    uint64_t deadline = salt_io_arq_time_us() + (uint64_t) timeout_ms * 1000, now;
+    int remaining = timeout_ms;
+
+    for (;;)
+    {
+        if (salt_io_arq_pump(p_ctx) < 0) return -1;
+
+        if (writable ? salt_io_arq_room(p_arq) : (p_arq->ready_end > p_arq->ready_begin)) return 1;
+
+        if (timeout_ms >= 0)
+        {
+            now = salt_io_arq_time_us();
+            if (now >= deadline) return 0;
+            remaining = (int) ((deadline - now + 999) / 1000);
+        }
+
+        if (salt_io_arq_idle(p_ctx, remaining) < 0) return -1;
+    }
+}
+
+static int arq_out_queue(salt_io_ctx_t *p_ctx)
+{
+    int queued;
+
+    /* my_write() waits by a sleep, the acknowledgements and the timeouts are handled here */
+    if (salt_io_arq_pump(p_ctx) < 0) return -1;
+
+    queued = p_ctx->p_arq->p_link->out_queue(p_ctx);
+
+    /* The encoded bytes which the link did not take yet are queued too */
+    return (queued < 0) ? -1 : queued + (int) p_ctx->p_arq->wire_len;
+}
+
+static int arq_in_queue(salt_io_ctx_t *p_ctx)
+{
+    if (salt_io_arq_pump(p_ctx) < 0) return -1;
+
+    return (int) (p_ctx->p_arq->ready_end - p_ctx->p_arq->ready_begin);
+}
+
+static int arq_drain(salt_io_ctx_t *p_ctx)
+{
+    salt_io_arq_t *p_arq = p_ctx->p_arq;
+
+    /* Until the peer acknowledged every chunk */
+    for (;;)
+    {
+        if (salt_io_arq_pump(p_ctx) < 0) return -1;
+
+        if (p_arq->tx_base == p_arq->tx_next && p_arq->wire_len == 0) break;
+
+        if (salt_io_arq_idle(p_ctx, -1) < 0) return -1;
+    }
+
+    return p_arq->p_link->drain(p_ctx);
+}
+
+static void arq_close(salt_io_ctx_t *p_ctx)
+{
+    /* The last chunks are delivered, a dead peer ends it after SALT_IO_ARQ_DEAD_MS */
+    arq_drain(p_ctx);
+
+    p_ctx->p_transport = p_ctx->p_arq->p_link;
+    p_ctx->p_arq = NULL;
+    p_ctx->p_transport->close(p_ctx);
+}
+
+static int arq_fd(salt_io_ctx_t *p_ctx)
+{
+    return p_ctx->p_arq->p_link->fd(p_ctx);
+}
+
+const salt_io_transport_t salt_io_arq_transport = {
+    "arq",
+    arq_send,
+    arq_recv,
+    arq_wait,
+    arq_out_queue,
+    arq_in_queue,
+    arq_drain,
+    arq_close,
+    arq_fd
+};
+
+int salt_io_start_arq(salt_io_ctx_t *p_ctx, salt_io_arq_t *p_arq)
+{
+    if (p_ctx->p_arq != NULL || salt_io_drain(p_ctx) != 0) return 1;
+
+    memset(p_arq, 0, sizeof(salt_io_arq_t));
+    p_arq->p_link = p_ctx->p_transport;
+    p_arq->rto_us = SALT_IO_ARQ_RTO_INIT * 1000.0;
+
+    p_ctx->p_arq = p_arq;
+    p_ctx->p_transport = &salt_io_arq_transport;
+
+    return 0;
+}
+
+/* ====== Reed-Solomon FEC (owns the link, runs in my_write() / my_read()) ======= */
+
+/* 
+ * Log / antilog tables of GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1, 
+ * built once by the first start (contexts may be started by several threads)
+ */
+static uint8_t salt_io_gf_exp[512];
+static uint8_t salt_io_gf_log[256];
+static pthread_once_t salt_io_gf_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Pseudo-random mask of the codewords on the wire. A shifted codeword of 
+ * RS(255) is a codeword too, the window across two equal codewords (e.g.
+ * repeated acknowledgements) would be decoded by the search of the start.
+ */
+static uint8_t salt_io_fec_mask[SALT_IO_FEC_N];
+
+static void salt_io_gf_init(void)
+{
+    uint32_t x = 1;
+    int i;
+
+    for (i = 0; i < 255; i++)
+    {
+        salt_io_gf_exp[i] = (uint8_t) x;
+        salt_io_gf_log[x] = (uint8_t) i;
+
+        x <<= 1;
+        if (x & 0x100) x ^= 0x11D;
+    }
+
+    /* The sum of two logarithms needs no modulo */
+    for (i = 255; i < 512; i++) salt_io_gf_exp[i] = salt_io_gf_exp[i - 255];
+
+    /* xorshift32 from a fixed seed, both peers have the same mask */
+    x = 0x5A17C0DEU;
+    for (i = 0; i < SALT_IO_FEC_N; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        salt_io_fec_mask[i] = (uint8_t) x;
+    }
+}
+
+static uint8_t salt_io_gf_mul(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0) return 0;
+
+    return salt_io_gf_exp[salt_io_gf_log[a] + salt_io_gf_log[b]];
+}
+
+static uint8_t salt_io_gf_div(uint8_t a, uint8_t b)
+{
+    if (a == 0) return 0;
+
+    return salt_io_gf_exp[salt_io_gf_log[a] + 255 - salt_io_gf_log[b]];
+}
+
+/* Parity of the codeword, the remainder of data * x^parity divided by the generator */
+static void salt_io_fec_encode(salt_io_fec_t *p_fec, uint8_t *p_word)
+{
+    uint32_t k = SALT_IO_FEC_N - p_fec->parity, p = p_fec->parity, i, j;
+    uint8_t *p_parity = &p_word[k], feedback;
+
+    memset(p_parity, 0, p);
+
+    for (i = 0; i < k; i++)
+    {
+        feedback = p_word[i] ^ p_parity[0];
+
+        for (j = 0; j < p - 1; j++) p_parity[j] = p_parity[j + 1] ^ p_fec->gen_mul[j][feedback];
+        p_parity[p - 1] = p_fec->gen_mul[p - 1][feedback];
+    }
+}
+
+/*
+ * Corrects the received codeword in place: syndromes, Berlekamp-Massey, 
+ * Chien search and Forney. Returns the corrected bytes, -1 if there are
+ * more than parity / 2 of them (the codeword is not changed then).
+ */
+static int salt_io_fec_correct(salt_io_fec_t *p_fec, uint8_t *p_word)
+{
+    uint8_t syndrome[SALT_IO_FEC_PARITY_MAX], omega[SALT_IO_FEC_PARITY_MAX];
+    uint8_t lambda[SALT_IO_FEC_PARITY_MAX + 1], prev[SALT_IO_FEC_PARITY_MAX + 1];
+    uint8_t saved[SALT_IO_FEC_PARITY_MAX + 1], position[SALT_IO_FEC_PARITY_MAX / 2];
+    uint8_t value[SALT_IO_FEC_PARITY_MAX / 2], s, d, b = 1, x, num, den;
+    int p = (int) p_fec->parity, i, j, r, len = 0, m = 1, found = 0, errors = 0;
+
+    /* S_i = c(a^i), all of them are zero for a valid codeword */
+    for (i = 0; i < p; i++)
+    {
+        s = 0;
+        for (j = 0; j < SALT_IO_FEC_N; j++)
+        {
+            s = (s == 0) ? p_word[j] : (salt_io_gf_exp[salt_io_gf_log[s] + i] ^ p_word[j]);
+        }
+        syndrome[i] = s;
+        errors |= s;
+    }
+    if (errors == 0) return 0;
+
+    /* Error locator polynomial, the lowest coefficient first */
+    memset(lambda, 0, sizeof(lambda));
+    memset(prev, 0, sizeof(prev));
+    lambda[0] = prev[0] = 1;
+
+    for (r = 0; r < p; r++)
+    {
+        d = syndrome[r];
+        for (i = 1; i <= len; i++) d ^= salt_io_gf_mul(lambda[i], syndrome[r - i]);
+
+        if (d == 0)
+        {
+            m++;
+            continue;
+        }
+
+        memcpy(saved, lambda, sizeof(lambda));
+        x = salt_io_gf_div(d, b);
+        for (i = 0; i + m <= p; i++) lambda[i + m] ^= salt_io_gf_mul(x, prev[i]);
+
+        if (2 * len <= r)
+        {
+            len = r + 1 - len;
+            memcpy(prev, saved, sizeof(saved));
+            b = d;
+            m = 1;
+        }
+        else
+        {
+            m++;
+        }
+    }
+    if (2 * len > p) return -1;
+
+    /* Error evaluator polynomial, S(x) * lambda(x) mod x^parity */
+    for (i = 0; i < p; i++)
+    {
+        omega[i] = 0;
+        for (j = 0; j <= i && j <= len; j++) omega[i] ^= salt_io_gf_mul(syndrome[i - j], lambda[j]);
+    }
+
+    /* The byte j is damaged if lambda(X^-1) = 0 with X = a^(254 - j) */
+    for (j = 0; j < SALT_IO_FEC_N && found <= len; j++)
+    {
+        int inverse = (j + 1) % 255, power;
+
+        s = 0;
+        for (i = 0, power = 0; i <= len; i++, power += inverse)
+        {
+            s ^= salt_io_gf_mul(lambda[i], salt_io_gf_exp[power % 255]);
+        }
+        if (s != 0) continue;
+
+        /* Forney: e = X * omega(X^-1) / lambda'(X^-1) */
+        num = den = 0;
+        for (i = 0; i < p; i++) num ^= salt_io_gf_mul(omega[i], salt_io_gf_exp[(i * inverse) % 255]);
+        for (i = 1; i <= len; i += 2) den ^= salt_io_gf_mul(lambda[i], salt_io_gf_exp[((i - 1) * inverse) % 255]);
+        if (den == 0 || found == len) return -1;
+
+        position[found] = (uint8_t) j;
+        value[found++] = salt_io_gf_mul(salt_io_gf_exp[SALT_IO_FEC_N - 1 - j], salt_io_gf_div(num, den));
+    }
+    if (found != len) return -1;
+
+    for (i = 0; i < found; i++) p_word[position[i]] ^= value[i];
+
+    return found;
+}
+
+/* One received codeword, the decoded bytes go to the ready bytes */
+static void salt_io_fec_input(salt_io_fec_t *p_fec)
+{
+    uint32_t k = SALT_IO_FEC_N - p_fec->parity, count, i;
+    uint8_t word[SALT_IO_FEC_N];
+    int n;
+
+    /* A copy, the search of the start shifts the received bytes */
+    for (i = 0; i < SALT_IO_FEC_N; i++) word[i] = p_fec->in[i] ^ salt_io_fec_mask[i];
+    n = salt_io_fec_correct(p_fec, word);
+
+    /* The padding behind the bytes of a valid codeword is zero */
+    count = word[0];
+    if (n >= 0 && count < k)
+    {
+        for (i = 1 + count; i < k && word[i] == 0; i++);
+        if (i == k)
+        {
+            memcpy(&p_fec->ready[p_fec->ready_end], &word[1], count);
+            p_fec->ready_end += count;
+            p_fec->corrected += (uint32_t) n;
+            p_fec->in_failed = 0;
+            p_fec->in_len = 0;
+            return;
+        }
+    }
+
+    /* Two damaged codewords in a row, the stream is probably shifted */
+    if (p_fec->in_failed)
+    {
+        memmove(p_fec->in, &p_fec->in[1], SALT_IO_FEC_N - 1);
+        p_fec->in_len = SALT_IO_FEC_N - 1;
+        return;
+    }
+
+    p_fec->uncorrectable++;
+    p_fec->in_failed = 1;
+    p_fec->in_len = 0;
+}
+
+/* Writes the wire buffer, the rest waits for the next call */
+static int salt_io_fec_flush(salt_io_ctx_t *p_ctx)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+    uint8_t *p_buf = p_fec->wire;
+    int size = (int) p_fec->wire_len, n;
+
+    if (size == 0) return 0;
+
+    n = p_fec->p_link->send(p_ctx, &p_buf, &size, 1);
+    if (n < 0)
+    {
+        p_fec->failed = 1;
+        return -1;
+    }
+
+    p_fec->wire_len -= (uint32_t) n;
+    memmove(p_fec->wire, &p_fec->wire[n], p_fec->wire_len);
+
+    return 0;
+}
+
+/* Decodes the codewords in the input queue of the link while the ready bytes have room, writes the wire buffer */
+static int salt_io_fec_pump(salt_io_ctx_t *p_ctx)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+    uint32_t k = SALT_IO_FEC_N - p_fec->parity;
+    int queued, n;
+
+    if (p_fec->failed) return -1;
+
+    for (;;)
+    {
+        if (SALT_IO_FEC_READY_SIZE - p_fec->ready_end < k - 1 && p_fec->ready_begin > 0)
+        {
+            memmove(p_fec->ready, &p_fec->ready[p_fec->ready_begin], 
+                    p_fec->ready_end - p_fec->ready_begin);
+            p_fec->ready_end -= p_fec->ready_begin;
+            p_fec->ready_begin = 0;
+        }
+
+        /* my_read() makes room, the codewords wait in the link until then */
+        if (SALT_IO_FEC_READY_SIZE - p_fec->ready_end < k - 1) break;
+
+        /* An empty queue is read only when the wait saw the link readable (the end of the stream) */
+        queued = p_fec->p_link->in_queue(p_ctx);
+        if (queued <= 0 && !p_fec->readable) break;
+        p_fec->readable = 0;
+
+        if (queued <= 0) queued = 1;
+        if (queued > (int) (SALT_IO_FEC_N - p_fec->in_len)) queued = (int) (SALT_IO_FEC_N - p_fec->in_len);
+
+        n = p_fec->p_link->recv(p_ctx, &p_fec->in[p_fec->in_len], queued);
+        if (n < 0)
+        {
+            p_fec->failed = 1;
+            return -1;
+        }
+        if (n == 0) break;
+
+        p_fec->in_len += (uint32_t) n;
+        if (p_fec->in_len == SALT_IO_FEC_N) salt_io_fec_input(p_fec);
+    }
+
+    return salt_io_fec_flush(p_ctx);
+}
+
+/* Waits until the link takes the wire buffer or, if it is empty, until the link is readable */
+static int salt_io_fec_idle(salt_io_ctx_t *p_ctx, int timeout_ms)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+    int n;
+
+    if (p_fec->wire_len > 0)
+    {
+        n = p_fec->p_link->wait(p_ctx, 1, timeout_ms);
+    }
+    else
+    {
+        n = p_fec->p_link->wait(p_ctx, 0, timeout_ms);
+        if (n > 0) p_fec->readable = 1;
+    }
+    if (n < 0) p_fec->failed = 1;
+
+    return n;
+}
+
+static int fec_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+    int payload = SALT_IO_FEC_N - (int) p_fec->parity - 1;
+    int total = 0, i = 0, offset = 0, len, n;
+    uint8_t *p_word;
+
+    if (salt_io_fec_pump(p_ctx) < 0) return -1;
+
+    /* The buffers are cut into codewords, the last one is padded with zeros */
+    while (i < count && SALT_IO_FEC_WIRE_SIZE - p_fec->wire_len >= SALT_IO_FEC_N)
+    {
+        p_word = &p_fec->wire[p_fec->wire_len];
+        len = 0;
+
+        while (i < count && len < payload)
+        {
+            n = p_sizes[i] - offset;
+            if (n > payload - len) n = payload - len;
+
+            memcpy(&p_word[1 + len], &pp_bufs[i][offset], n);
+            len += n;
+            offset += n;
+
+            if (offset == p_sizes[i])
+            {
+                i++;
+                offset = 0;
+            }
+        }
+        if (len == 0) break;
+
+        p_word[0] = (uint8_t) len;
+        memset(&p_word[1 + len], 0, payload - len);
+        salt_io_fec_encode(p_fec, p_word);
+        for (n = 0; n < SALT_IO_FEC_N; n++) p_word[n] ^= salt_io_fec_mask[n];
+
+        p_fec->wire_len += SALT_IO_FEC_N;
+        total += len;
+    }
+
+    if (salt_io_fec_flush(p_ctx) < 0) return -1;
+
+    return total;
+}
+
+static int fec_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+    uint32_t available;
+
+    if (salt_io_fec_pump(p_ctx) < 0) return -1;
+
+    available = p_fec->ready_end - p_fec->ready_begin;
+    if (available > (uint32_t) size) available = (uint32_t) size;
+
+    memcpy(p_buf, &p_fec->ready[p_fec->ready_begin], available);
+    p_fec->ready_begin += available;
+    if (p_fec->ready_begin == p_fec->ready_end) p_fec->ready_begin = p_fec->ready_end = 0;
+
+    return (int) available;
+}
+
+static int fec_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+    uint64_t deadline = salt_io_arq_time_us() + (uint64_t) timeout_ms * 1000, now;
+    int remaining = timeout_ms;
+
+    for (;;)
+    {
+        if (salt_io_fec_pump(p_ctx) < 0) return -1;
+
+        if (writable ? (SALT_IO_FEC_WIRE_SIZE - p_fec->wire_len >= SALT_IO_FEC_N) : 
+                       (p_fec->ready_end > p_fec->ready_begin)) 
+        {
+            return 1;
+        }
+
+        if (timeout_ms >= 0)
+        {
+            now = salt_io_arq_time_us();
+            if (now >= deadline) return 0;
+            remaining = (int) ((deadline - now + 999) / 1000);
+        }
+
+        if (salt_io_fec_idle(p_ctx, remaining) < 0) return -1;
+    }
+}
+
+static int fec_out_queue(salt_io_ctx_t *p_ctx)
+{
+    int queued = p_ctx->p_fec->p_link->out_queue(p_ctx);
+
+    /* The codewords which the link did not take yet are queued too */
+    return (queued < 0) ? -1 : queued + (int) p_ctx->p_fec->wire_len;
+}
+
+static int fec_in_queue(salt_io_ctx_t *p_ctx)
+{
+    if (salt_io_fec_pump(p_ctx) < 0) return -1;
+
+    return (int) (p_ctx->p_fec->ready_end - p_ctx->p_fec->ready_begin);
+}
+
+static int fec_drain(salt_io_ctx_t *p_ctx)
+{
+    salt_io_fec_t *p_fec = p_ctx->p_fec;
+
+    while (p_fec->wire_len > 0)
+    {
+        if (salt_io_fec_flush(p_ctx) < 0) return -1;
+
+        if (p_fec->wire_len > 0 && p_fec->p_link->wait(p_ctx, 1, -1) < 0) return -1;
+    }
+
+    return p_fec->p_link->drain(p_ctx);
+}
+
+static void fec_close(salt_io_ctx_t *p_ctx)
+{
+    fec_drain(p_ctx);
+
+    p_ctx->p_transport = p_ctx->p_fec->p_link;
+    p_ctx->p_fec = NULL;
+    p_ctx->p_transport->close(p_ctx);
+}
+
+static int fec_fd(salt_io_ctx_t *p_ctx)
+{
+    return p_ctx->p_fec->p_link->fd(p_ctx);
+}
+
+const salt_io_transport_t salt_io_fec_transport = {
+    "fec",
+    fec_send,
+    fec_recv,
+    fec_wait,
+    fec_out_queue,
+    fec_in_queue,
+    fec_drain,
+    fec_close,
+    fec_fd
+};
+
+int salt_io_start_fec(salt_io_ctx_t *p_ctx, salt_io_fec_t *p_fec, uint32_t parity)
+{
+    uint8_t generator[SALT_IO_FEC_PARITY_MAX + 1], root;
+    uint32_t i, j;
+
+    /* The ARQ repeats what the FEC could not correct, it is started above it */
+    if (parity < SALT_IO_FEC_PARITY_MIN || parity > SALT_IO_FEC_PARITY_MAX || (parity & 1) ||
+        p_ctx->p_fec != NULL || p_ctx->p_arq != NULL || salt_io_drain(p_ctx) != 0)
+    {
+        return 1;
+    }
+
+    pthread_once(&salt_io_gf_once, salt_io_gf_init);
+
+    memset(p_fec, 0, sizeof(salt_io_fec_t));
+    p_fec->p_link = p_ctx->p_transport;
+    p_fec->parity = parity;
+
+    /* g(x) = (x - a^0)(x - a^1)...(x - a^(parity - 1)), the highest coefficient first */
+    memset(generator, 0, sizeof(generator));
+    generator[0] = 1;
+    for (i = 0; i < parity; i++)
+    {
+        root = salt_io_gf_exp[i];
+        for (j = i + 1; j > 0; j--) generator[j] ^= salt_io_gf_mul(generator[j - 1], root);
+    }
+
+    for (i = 0; i < parity; i++)
+    {
+        for (j = 0; j < 256; j++) p_fec->gen_mul[i][j] = salt_io_gf_mul(generator[i + 1], (uint8_t) j);
+    }
+
+    p_ctx->p_fec = p_fec;
+    p_ctx->p_transport = &salt_io_fec_transport;
+
+    return 0;
+}
+
+/* ====== Bonding of several ports (runs in my_write() / my_read()) ======= */
+
+/* Leaves the port out, its stripes are lost */
+static void salt_io_bond_fail(salt_io_bond_t *p_bond, salt_io_bond_port_t *p_port)
+{
+    if (p_port->dead) return;
+
+    p_port->dead = 1;
+    p_port->wire_len = 0;
+    p_port->in_len = 0;
+    p_port->pending = 0;
+    p_bond->alive--;
+
+    printf("Port %d of the bond failed, %d ports left\n", (int) (p_port - p_bond->ports), p_bond->alive);
+}
+
+/* Writes the wire buffer of the port, the rest waits for the next call */
+static void salt_io_bond_flush(salt_io_bond_t *p_bond, salt_io_bond_port_t *p_port)
+{
+    salt_io_ctx_t *p_link = p_port->p_ctx;
+    uint8_t *p_buf = p_port->wire;
+    int size = (int) p_port->wire_len, n;
+
+    if (p_port->dead || size == 0) return;
+
+    n = p_link->p_transport->send(p_link, &p_buf, &size, 1);
+    if (n < 0)
+    {
+        salt_io_bond_fail(p_bond, p_port);
+        return;
+    }
+
+    p_port->wire_len -= (uint32_t) n;
+    memmove(p_port->wire, &p_port->wire[n], p_port->wire_len);
+}
+
+/* Reads the input queue of the port into its stripe, 1 if the stripe is whole */
+static int salt_io_bond_read(salt_io_bond_t *p_bond, salt_io_bond_port_t *p_port)
+{
+    salt_io_ctx_t *p_link = p_port->p_ctx;
+    uint32_t size, need;
+    int queued, n;
+
+    while (!p_port->dead && !p_port->pending)
+    {
+        size = (uint32_t) (p_port->in[2] | p_port->in[3] << 8);
+        need = (p_port->in_len < SALT_IO_BOND_HEADER_SIZE) ? 
+               SALT_IO_BOND_HEADER_SIZE - p_port->in_len : SALT_IO_BOND_HEADER_SIZE + size - p_port->in_len;
+
+        /* An empty queue is read only when the wait saw the port readable (the end of the stream) */
+        queued = p_link->p_transport->in_queue(p_link);
+        if (queued <= 0 && !p_port->readable) return 0;
+        p_port->readable = 0;
+
+        if (queued <= 0) queued = 1;
+        if ((uint32_t) queued > need) queued = (int) need;
+
+        n = p_link->p_transport->recv(p_link, &p_port->in[p_port->in_len], queued);
+        if (n < 0) salt_io_bond_fail(p_bond, p_port);
+        if (n <= 0) return 0;
+
+        p_port->in_len += (uint32_t) n;
+        if (p_port->in_len < SALT_IO_BOND_HEADER_SIZE) continue;
+
+        /* A wrong size desynchronized the port, nothing of it can be trusted */
+        size = (uint32_t) (p_port->in[2] | p_port->in[3] << 8);
+        if (size == 0 || size > SALT_IO_BOND_STRIPE)
+        {
+            salt_io_bond_fail(p_bond, p_port);
+            return 0;
+        }
+
+        if (p_port->in_len == SALT_IO_BOND_HEADER_SIZE + size)
+        {
+            p_port->last_seq = (uint16_t) (p_port->in[0] | p_port->in[1] << 8);
+            p_port->has_last = 1;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Puts the whole stripe of the port into the window, 0 if it is beyond the window */
+static int salt_io_bond_place(salt_io_bond_t *p_bond, salt_io_bond_port_t *p_port)
+{
+    uint16_t seq = (uint16_t) (p_port->in[0] | p_port->in[1] << 8);
+    uint16_t ahead = (uint16_t) (seq - p_bond->rx_next);
+    salt_io_bond_slot_t *p_slot = &p_bond->rx[seq % SALT_IO_BOND_WINDOW];
+
+    /* The port waits until my_read() moves the window */
+    if (ahead >= SALT_IO_BOND_WINDOW && ahead < 0x8000)
+    {
+        p_port->pending = 1;
+        return 0;
+    }
+
+    /* An older stripe was skipped already */
+    if (ahead < SALT_IO_BOND_WINDOW && !p_slot->used)
+    {
+        p_slot->size = (uint16_t) (p_port->in_len - SALT_IO_BOND_HEADER_SIZE);
+        memcpy(p_slot->data, &p_port->in[SALT_IO_BOND_HEADER_SIZE], p_slot->size);
+        p_slot->used = 1;
+    }
+
+    p_port->in_len = 0;
+    p_port->pending = 0;
+
+    return 1;
+}
+
+/* 
+ * 1 if the stripe rx_next can not come any more: a port failed and each
+ * other one delivered a later stripe (a port keeps the order of its stripes).
+ */
+static int salt_io_bond_gone(salt_io_bond_t *p_bond)
+{
+    salt_io_bond_port_t *p_port;
+    uint16_t ahead;
+    int i;
+
+    if (p_bond->alive == p_bond->count || p_bond->alive == 0) return 0;
+
+    for (i = 0; i < p_bond->count; i++)
+    {
+        p_port = &p_bond->ports[i];
+        if (p_port->dead) continue;
+
+        ahead = (uint16_t) (p_port->last_seq - p_bond->rx_next);
+        if (!p_port->has_last || ahead == 0 || ahead >= 0x8000) return 0;
+    }
+
+    return 1;
+}
+
+/* Moves the stripes in order into the ready bytes while they fit */
+static void salt_io_bond_deliver(salt_io_bond_t *p_bond)
+{
+    salt_io_bond_slot_t *p_slot;
+
+    for (;;)
+    {
+        p_slot = &p_bond->rx[p_bond->rx_next % SALT_IO_BOND_WINDOW];
+
+        if (p_slot->used)
+        {
+            if (sizeof(p_bond->ready) - p_bond->ready_end < p_slot->size && p_bond->ready_begin > 0)
+            {
+                memmove(p_bond->ready, &p_bond->ready[p_bond->ready_begin], 
+                        p_bond->ready_end - p_bond->ready_begin);
+                p_bond->ready_end -= p_bond->ready_begin;
+                p_bond->ready_begin = 0;
+            }
+
+            /* my_read() makes room */
+            if (sizeof(p_bond->ready) - p_bond->ready_end < p_slot->size) break;
+
+            memcpy(&p_bond->ready[p_bond->ready_end], p_slot->data, p_slot->size);
+            p_bond->ready_end += p_slot->size;
+            p_slot->used = 0;
+        }
+        else if (salt_io_bond_gone(p_bond))
+        {
+            p_bond->lost++;
+        }
+        else
+        {
+            break;
+        }
+
+        p_bond->rx_next++;
+    }
+}
+
+/* Reads the ports, puts the stripes in order and writes the wire buffers */
+static int salt_io_bond_pump(salt_io_ctx_t *p_ctx)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    salt_io_bond_port_t *p_port;
+    uint16_t rx_next;
+    int i, progress;
+
+    do
+    {
+        progress = 0;
+
+        for (i = 0; i < p_bond->count; i++)
+        {
+            p_port = &p_bond->ports[i];
+            if (p_port->dead) continue;
+
+            if (p_port->pending || salt_io_bond_read(p_bond, p_port)) 
+            {
+                progress |= salt_io_bond_place(p_bond, p_port);
+            }
+        }
+
+        rx_next = p_bond->rx_next;
+        salt_io_bond_deliver(p_bond);
+        if (rx_next != p_bond->rx_next) progress = 1;
+    } while (progress);
+
+    for (i = 0; i < p_bond->count; i++) salt_io_bond_flush(p_bond, &p_bond->ports[i]);
+
+    return (p_bond->alive > 0) ? 0 : -1;
+}
+
+/* Port of the next stripe, -1 if it has no room (round robin) or no port has room */
+static int salt_io_bond_pick(salt_io_bond_t *p_bond)
+{
+    salt_io_bond_port_t *p_port;
+    int i, k, queued, depth, best = -1, best_depth = 0;
+
+    for (k = 0; k < p_bond->count; k++)
+    {
+        i = (p_bond->next + k) % p_bond->count;
+        p_port = &p_bond->ports[i];
+        if (p_port->dead) continue;
+
+        if (SALT_IO_BOND_WIRE_SIZE - p_port->wire_len < SALT_IO_BOND_HEADER_SIZE + SALT_IO_BOND_STRIPE)
+        {
+            if (p_bond->mode == SALT_IO_BOND_ROUND_ROBIN) return -1;
+            continue;
+        }
+
+        if (p_bond->mode == SALT_IO_BOND_ROUND_ROBIN) return i;
+
+        /* Bytes queued in the driver and in the wire buffer, the first one wins a tie */
+        queued = p_port->p_ctx->p_transport->out_queue(p_port->p_ctx);
+        depth = (int) p_port->wire_len + ((queued > 0) ? queued : 0);
+        if (best < 0 || depth < best_depth)
+        {
+            best = i;
+            best_depth = depth;
+        }
+    }
+
+    return best;
+}
+
+/* Waits until a port takes its wire buffer or a port is readable */
+static int salt_io_bond_idle(salt_io_ctx_t *p_ctx, int timeout_ms)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    salt_io_bond_port_t *p_port;
+    int i, n = 0;
+#if !defined(_WIN32)
+    struct pollfd fds[SALT_IO_BOND_MAX];
+    int index[SALT_IO_BOND_MAX], polled = 0;
+
+    for (i = 0; i < p_bond->count; i++)
+    {
+        p_port = &p_bond->ports[i];
+        if (p_port->dead) continue;
+
+        fds[polled].fd = p_port->p_ctx->p_transport->fd(p_port->p_ctx);
+        if (fds[polled].fd < 0) break;
+
+        /* A pending stripe waits for my_read(), not for the port */
+        fds[polled].events = (p_port->pending ? 0 : POLLIN) | ((p_port->wire_len > 0) ? POLLOUT : 0);
+        fds[polled].revents = 0;
+        index[polled++] = i;
+    }
+
+    if (i == p_bond->count)
+    {
+        n = poll(fds, polled, timeout_ms);
+        if (n < 0) return (errno == EINTR) ? 0 : -1;
+
+        for (i = 0; i < polled; i++)
+        {
+            p_port = &p_bond->ports[index[i]];
+            if (fds[i].revents & POLLNVAL) salt_io_bond_fail(p_bond, p_port);
+            else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) p_port->readable = 1;
+        }
+
+        return (p_bond->alive > 0) ? n : -1;
+    }
+#endif
+
+    /* A port without a descriptor (shared memory, windows), the ports are asked in turn */
+    for (i = 0; i < p_bond->count; i++)
+    {
+        p_port = &p_bond->ports[i];
+        if (p_port->dead) continue;
+
+        n = p_port->p_ctx->p_transport->wait(p_port->p_ctx, p_port->wire_len > 0, 0);
+        if (n < 0) salt_io_bond_fail(p_bond, p_port);
+        if (n > 0)
+        {
+            if (p_port->wire_len == 0) p_port->readable = 1;
+            return 1;
+        }
+    }
+    if (timeout_ms != 0) usleep(SALT_IO_RING_POLL_US);
+
+    return (p_bond->alive > 0) ? 0 : -1;
+}
+
+static int bond_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    salt_io_bond_port_t *p_port;
+    int total = 0, i = 0, offset = 0, port, len, n;
+    uint8_t *p_stripe;
+
+    if (salt_io_bond_pump(p_ctx) < 0) return -1;
+
+    /* The buffers are cut into stripes, each one goes to the wire buffer of one port */
+    while (i < count && (port = salt_io_bond_pick(p_bond)) >= 0)
+    {
+        p_port = &p_bond->ports[port];
+        p_stripe = &p_port->wire[p_port->wire_len];
+        len = 0;
+
+        while (i < count && len < SALT_IO_BOND_STRIPE)
+        {
+            n = p_sizes[i] - offset;
+            if (n > SALT_IO_BOND_STRIPE - len) n = SALT_IO_BOND_STRIPE - len;
+
+            memcpy(&p_stripe[SALT_IO_BOND_HEADER_SIZE + len], &pp_bufs[i][offset], n);
+            len += n;
+            offset += n;
+
+            if (offset == p_sizes[i])
+            {
+                i++;
+                offset = 0;
+            }
+        }
+        if (len == 0) break;
+
+        p_stripe[0] = (uint8_t) p_bond->tx_seq;
+        p_stripe[1] = (uint8_t) (p_bond->tx_seq >> 8);
+        p_stripe[2] = (uint8_t) len;
+        p_stripe[3] = (uint8_t) (len >> 8);
+
+        p_port->wire_len += SALT_IO_BOND_HEADER_SIZE + (uint32_t) len;
+        p_bond->tx_seq++;
+        p_bond->next = (port + 1) % p_bond->count;
+        total += len;
+    }
+
+    for (i = 0; i < p_bond->count; i++) salt_io_bond_flush(p_bond, &p_bond->ports[i]);
+
+    return (p_bond->alive > 0) ? total : -1;
+}
+
+static int bond_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    uint32_t available;
+
+    if (salt_io_bond_pump(p_ctx) < 0) return -1;
+
+    available = p_bond->ready_end - p_bond->ready_begin;
+    if (available > (uint32_t) size) available = (uint32_t) size;
+
+    memcpy(p_buf, &p_bond->ready[p_bond->ready_begin], available);
+    p_bond->ready_begin += available;
+    if (p_bond->ready_begin == p_bond->ready_end) p_bond->ready_begin = p_bond->ready_end = 0;
+
+    return (int) available;
+}
+
+static int bond_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    uint64_t deadline = salt_io_arq_time_us() + (uint64_t) timeout_ms * 1000, now;
+    int remaining = timeout_ms;
+
+    for (;;)
+    {
+        if (salt_io_bond_pump(p_ctx) < 0) return -1;
+
+        if (writable ? (salt_io_bond_pick(p_bond) >= 0) : (p_bond->ready_end > p_bond->ready_begin)) return 1;
+
+        if (timeout_ms >= 0)
+        {
+            now = salt_io_arq_time_us();
+            if (now >= deadline) return 0;
+            remaining = (int) ((deadline - now + 999) / 1000);
+        }
+
+        if (salt_io_bond_idle(p_ctx, remaining) < 0) return -1;
+    }
+}
+
+static int bond_out_queue(salt_io_ctx_t *p_ctx)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    salt_io_bond_port_t *p_port;
+    int i, queued, total = 0;
+
+    /* The driver queues and the wire buffers of all ports */
+    for (i = 0; i < p_bond->count; i++)
+    {
+        p_port = &p_bond->ports[i];
+        if (p_port->dead) continue;
+
+        queued = p_port->p_ctx->p_transport->out_queue(p_port->p_ctx);
+        if (queued < 0) return -1;
+
+        total += queued + (int) p_port->wire_len;
+    }
+
+    return total;
+}
+
+static int bond_in_queue(salt_io_ctx_t *p_ctx)
+{
+    if (salt_io_bond_pump(p_ctx) < 0) return -1;
+
+    return (int) (p_ctx->p_bond->ready_end - p_ctx->p_bond->ready_begin);
+}
+
+static int bond_drain(salt_io_ctx_t *p_ctx)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    salt_io_bond_port_t *p_port;
+    int i, waiting;
+
+    for (;;)
+    {
+        if (salt_io_bond_pump(p_ctx) < 0) return -1;
+
+        for (i = 0, waiting = 0; i < p_bond->count; i++) waiting |= (p_bond->ports[i].wire_len > 0);
+        if (!waiting) break;
+
+        if (salt_io_bond_idle(p_ctx, -1) < 0) return -1;
+    }
+
+    for (i = 0; i < p_bond->count; i++)
+    {
+        p_port = &p_bond->ports[i];
+        if (!p_port->dead && p_port->p_ctx->p_transport->drain(p_port->p_ctx) != 0) salt_io_bond_fail(p_bond, p_port);
+    }
+
+    return (p_bond->alive > 0) ? 0 : -1;
+}
+
+static void bond_close(salt_io_ctx_t *p_ctx)
+{
+    salt_io_bond_t *p_bond = p_ctx->p_bond;
+    int i;
+
+    bond_drain(p_ctx);
+
+    /* Also the failed ports, their descriptors are released */
+    for (i = 0; i < p_bond->count; i++) salt_io_close(p_bond->ports[i].p_ctx);
+
+    p_ctx->p_bond = NULL;
+}
+
+static int bond_fd(salt_io_ctx_t *p_ctx)
+{
+    (void) p_ctx;
+
+    /* Several descriptors, see salt_io_wait_channel() */
+    return -1;
+}
+
+const salt_io_transport_t salt_io_bond_transport = {
+    "bond",
+    bond_send,
+    bond_recv,
+    bond_wait,
+    bond_out_queue,
+    bond_in_queue,
+    bond_drain,
+    bond_close,
+    bond_fd
+};
+
+int salt_io_open_bond(salt_io_ctx_t *p_ctx, 
+                      salt_io_bond_t *p_bond, 
+                      salt_io_ctx_t *p_ports, 
+                      int count, 
+                      int mode)
+{
+    uint32_t line_rate = 0, queue_limit = 0;
+    int i, paced = 1;
+
+    if (count < 1 || count > SALT_IO_BOND_MAX || 
+        (mode != SALT_IO_BOND_ROUND_ROBIN && mode != SALT_IO_BOND_QUEUE_DEPTH))
+    {
+        return 1;
+    }
+
+    memset(p_bond, 0, sizeof(salt_io_bond_t));
+    p_bond->count = p_bond->alive = count;
+    p_bond->mode = mode;
+
+    for (i = 0; i < count; i++)
+    {
+        p_bond->ports[i].p_ctx = &p_ports[i];
+
+        /* One port without the line rate makes the sum unknown */
+        if (p_ports[i].line_rate == 0) paced = 0;
+        line_rate += p_ports[i].line_rate;
+        queue_limit += p_ports[i].tx_queue_limit;
+    }
+
+    salt_io_ctx_init(p_ctx, NULL);
+    p_ctx->p_transport = &salt_io_bond_transport;
+    p_ctx->p_bond = p_bond;
+    p_ctx->line_rate = paced ? line_rate : 0;
+    p_ctx->tx_queue_limit = queue_limit;
+    p_ctx->tx_tokens = queue_limit;
+
+    /* The stripes go out at once, nothing to coalesce */
+
+    return 0;
+}
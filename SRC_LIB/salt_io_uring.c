@@ -0,0 +1,759 @@
+/*
+ * salt_io_uring.c    v.0.1
+ *
+ * io_uring engine of the salt I/O
+ *
+ * One ring for the whole transfer: the reads of the file of the sender,
+ * the reads and writes of the link (port, pseudo terminal, socket) and
+ * the writes of the file of the receiver. The ring is set up by the
+ * system calls (no liburing), the submissions are passed to the kernel
+ * and the completions are reaped by one io_uring_enter().
+ *
+ * Linux (other systems get the functions which return an error)
+ *
+ * KEMT FEI TUKE, Diploma thesis
+ * ===============================================
+ */
+
+/* ==== Basic libraries for working in C ==== */
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+/* ======= Salt-channel libraries ======= */
+#include "salt_io.h"
+
+#if defined(__linux__)
+
+/* Kind of the submission in the upper half of its user_data, the lower half is the index */
+#define SALT_IO_URING_RX_POLL       1
+#define SALT_IO_URING_RX            2
+#define SALT_IO_URING_TX_POLL       3
+#define SALT_IO_URING_TX            4
+#define SALT_IO_URING_FILE          5
+#define SALT_IO_URING_TIMEOUT       6
+
+#define SALT_IO_URING_TAG(kind, index)  (((uint64_t) (kind) << 32) | (uint32_t) (index))
+
+static uint64_t salt_io_uring_time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t) tv.tv_sec * 1000000 + (uint64_t) tv.tv_usec;
+}
+
+/* ====== Ring ======= */
+
+int salt_io_uring_init(salt_io_uring_t *p_uring)
+{
+    struct io_uring_params params;
+    uint8_t *p_sq, *p_cq;
+
+    memset(p_uring, 0, sizeof(salt_io_uring_t));
+    memset(&params, 0, sizeof(params));
+    p_uring->link_fd = -1;
+
+    p_uring->ring_fd = (int) syscall(__NR_io_uring_setup, SALT_IO_URING_ENTRIES, &params);
+    if (p_uring->ring_fd < 0)
+    {
+        perror("unable to create io_uring ");
+        return 1;
+    }
+
+    p_uring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    p_uring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    p_uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    p_uring->p_sq_map = mmap(NULL, p_uring->sq_map_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, p_uring->ring_fd, IORING_OFF_SQ_RING);
+    p_uring->p_cq_map = mmap(NULL, p_uring->cq_map_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, p_uring->ring_fd, IORING_OFF_CQ_RING);
+    p_uring->p_sqes = mmap(NULL, p_uring->sqes_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, p_uring->ring_fd, IORING_OFF_SQES);
+
+    if (p_uring->p_sq_map == MAP_FAILED || p_uring->p_cq_map == MAP_FAILED ||
+        p_uring->p_sqes == MAP_FAILED)
+    {
+        perror("unable to map io_uring ");
+        salt_io_uring_exit(p_uring);
+        return 1;
+    }
+
+    p_sq = (uint8_t *) p_uring->p_sq_map;
+    p_cq = (uint8_t *) p_uring->p_cq_map;
+    p_uring->p_sq_head = (uint32_t *) (p_sq + params.sq_off.head);
+    p_uring->p_sq_tail = (uint32_t *) (p_sq + params.sq_off.tail);
+    p_uring->p_sq_mask = (uint32_t *) (p_sq + params.sq_off.ring_mask);
+    p_uring->p_sq_array = (uint32_t *) (p_sq + params.sq_off.array);
+    p_uring->p_cq_head = (uint32_t *) (p_cq + params.cq_off.head);
+    p_uring->p_cq_tail = (uint32_t *) (p_cq + params.cq_off.tail);
+    p_uring->p_cq_mask = (uint32_t *) (p_cq + params.cq_off.ring_mask);
+    p_uring->p_cqes = p_cq + params.cq_off.cqes;
+
+    /* The read / write of a blocking descriptor waits in the ring without a worker (5.7) */
+    p_uring->fast_poll = (params.features & IORING_FEAT_FAST_POLL) != 0;
+
+    return 0;
+}
+
+void salt_io_uring_exit(salt_io_uring_t *p_uring)
+{
+    /* Closing the ring cancels the operations in flight */
+    if (p_uring->p_sqes != NULL && p_uring->p_sqes != MAP_FAILED)
+        munmap(p_uring->p_sqes, p_uring->sqes_size);
+    if (p_uring->p_cq_map != NULL && p_uring->p_cq_map != MAP_FAILED)
+        munmap(p_uring->p_cq_map, p_uring->cq_map_size);
+    if (p_uring->p_sq_map != NULL && p_uring->p_sq_map != MAP_FAILED)
+        munmap(p_uring->p_sq_map, p_uring->sq_map_size);
+    if (p_uring->ring_fd >= 0) close(p_uring->ring_fd);
+
+    p_uring->p_sqes = p_uring->p_cq_map = p_uring->p_sq_map = NULL;
+    p_uring->ring_fd = -1;
+}
+
+/* Passes the queued submissions, with min_complete > 0 it waits for the completions */
+static int salt_io_uring_enter(salt_io_uring_t *p_uring, uint32_t min_complete)
+{
+    int submitted;
+
+    p_uring->calls++;
+    submitted = (int) syscall(__NR_io_uring_enter, p_uring->ring_fd, p_uring->sq_queued, min_complete,
+                              (min_complete > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (submitted < 0) return (errno == EINTR || errno == EAGAIN || errno == EBUSY) ? 0 : -1;
+
+    p_uring->sq_queued -= (uint32_t) submitted;
+
+    return 0;
+}
+
+/* Next free submission, a full queue is passed to the kernel first */
+static struct io_uring_sqe *salt_io_uring_sqe(salt_io_uring_t *p_uring, uint64_t user_data)
+{
+    struct io_uring_sqe *p_sqe;
+    uint32_t tail = *p_uring->p_sq_tail, index;
+
+    while (tail - __atomic_load_n(p_uring->p_sq_head, __ATOMIC_ACQUIRE) >= SALT_IO_URING_ENTRIES)
+    {
+        if (salt_io_uring_enter(p_uring, 0) < 0) return NULL;
+    }
+
+    index = tail & *p_uring->p_sq_mask;
+    p_sqe = &((struct io_uring_sqe *) p_uring->p_sqes)[index];
+    memset(p_sqe, 0, sizeof(struct io_uring_sqe));
+    p_sqe->user_data = user_data;
+    p_uring->p_sq_array[index] = index;
+
+    return p_sqe;
+}
+
+/* Makes the filled submission visible to the kernel */
+static void salt_io_uring_queue(salt_io_uring_t *p_uring)
+{
+    __atomic_store_n(p_uring->p_sq_tail, *p_uring->p_sq_tail + 1, __ATOMIC_RELEASE);
+    p_uring->sq_queued++;
+}
+
+/*
+ * Read or write of the link. Without the fast poll of the kernel it is
+ * linked behind a poll of the non-blocking descriptor, a failed poll 
+ * (e.g. two polls of one tty) cancels it and it is queued again.
+ */
+static int salt_io_uring_queue_link(salt_io_uring_t *p_uring, int write, uint8_t *p_data, uint32_t size)
+{
+    struct io_uring_sqe *p_sqe;
+
+    if (!p_uring->fast_poll)
+    {
+        p_sqe = salt_io_uring_sqe(p_uring, SALT_IO_URING_TAG(write ? SALT_IO_URING_TX_POLL : SALT_IO_URING_RX_POLL, 0));
+        if (p_sqe == NULL) return -1;
+        p_sqe->opcode = IORING_OP_POLL_ADD;
+        p_sqe->fd = p_uring->link_fd;
+        p_sqe->poll_events = write ? POLLOUT : POLLIN;
+        p_sqe->flags = IOSQE_IO_LINK;
+        salt_io_uring_queue(p_uring);
+    }
+
+    p_sqe = salt_io_uring_sqe(p_uring, SALT_IO_URING_TAG(write ? SALT_IO_URING_TX : SALT_IO_URING_RX, 0));
+    if (p_sqe == NULL) return -1;
+    p_sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    p_sqe->fd = p_uring->link_fd;
+    p_sqe->addr = (uint64_t) (uintptr_t) p_data;
+    p_sqe->len = size;
+    p_sqe->off = (uint64_t) -1;
+    salt_io_uring_queue(p_uring);
+
+    return 0;
+}
+
+static int salt_io_uring_queue_file(salt_io_uring_t *p_uring, int index)
+{
+    salt_io_uring_op_t *p_op = &p_uring->ops[index];
+    struct io_uring_sqe *p_sqe = salt_io_uring_sqe(p_uring, SALT_IO_URING_TAG(SALT_IO_URING_FILE, index));
+
+    if (p_sqe == NULL) return -1;
+    p_sqe->opcode = p_op->write ? IORING_OP_WRITE : IORING_OP_READ;
+    p_sqe->fd = p_op->fd;
+    p_sqe->addr = (uint64_t) (uintptr_t) p_op->p_data;
+    p_sqe->len = p_op->size;
+    p_sqe->off = p_op->offset;
+    salt_io_uring_queue(p_uring);
+
+    return 0;
+}
+
+/* Completion of a read or write of a file */
+static void salt_io_uring_file_complete(salt_io_uring_t *p_uring, int index, int32_t res)
+{
+    salt_io_uring_op_t *p_op = &p_uring->ops[index];
+
+    if (res == -EAGAIN || res == -EINTR)
+    {
+        if (salt_io_uring_queue_file(p_uring, index) == 0) return;
+        res = -EIO;
+    }
+
+    /* A short transfer continues with the rest, a read at the end of the file failed */
+    if (res > 0 && (uint32_t) res < p_op->size)
+    {
+        p_op->p_data += res;
+        p_op->size -= (uint32_t) res;
+        p_op->offset += (uint64_t) res;
+        if (salt_io_uring_queue_file(p_uring, index) == 0) return;
+    }
+    if (res <= 0 || (uint32_t) res < p_op->size) p_uring->file_failed = 1;
+
+    p_op->used = 0;
+    if (p_op->write) p_uring->writes_busy--;
+    else p_uring->reads_busy--;
+
+    /* The owner is done after the last of its reads / writes, see salt_io_uring_file_done() */
+    if (p_op->owner >= 0) p_uring->owners[p_op->owner].busy--;
+}
+
+static void salt_io_uring_complete(salt_io_uring_t *p_uring, uint64_t user_data, int32_t res)
+{
+    uint32_t kind = (uint32_t) (user_data >> 32);
+
+    p_uring->completions++;
+
+    switch (kind)
+    {
+    case SALT_IO_URING_RX:
+        /* The read waited for the link, nothing to read is a hangup */
+        p_uring->rx_busy = 0;
+        if (res > 0) p_uring->rx_end = (uint32_t) res;
+        else if (res == 0 || (res != -EAGAIN && res != -EINTR && res != -ECANCELED))
+        {
+            p_uring->failed = 1;
+        }
+        break;
+
+    case SALT_IO_URING_TX:
+        p_uring->wire_busy = 0;
+        if (res > 0)
+        {
+            memmove(p_uring->wire, &p_uring->wire[res], p_uring->wire_len - (uint32_t) res);
+            p_uring->wire_len -= (uint32_t) res;
+        }
+        else if (res < 0 && res != -EAGAIN && res != -EINTR && res != -ECANCELED)
+        {
+            p_uring->failed = 1;
+        }
+        break;
+
+    case SALT_IO_URING_FILE:
+        salt_io_uring_file_complete(p_uring, (int) (uint32_t) user_data, res);
+        break;
+
+    default:
+        /* Polls of the link, timeout of the wait */
+        break;
+    }
+}
+
+/* Reaps every completion in the ring, no system call */
+static void salt_io_uring_reap(salt_io_uring_t *p_uring)
+{
+    struct io_uring_cqe *p_cqe;
+    uint32_t head = *p_uring->p_cq_head;
+    uint64_t user_data;
+    int32_t res;
+
+    while (head != __atomic_load_n(p_uring->p_cq_tail, __ATOMIC_ACQUIRE))
+    {
+        /* The entry is copied before the kernel may reuse it */
+        p_cqe = &((struct io_uring_cqe *) p_uring->p_cqes)[head & *p_uring->p_cq_mask];
+        user_data = p_cqe->user_data;
+        res = p_cqe->res;
+        head++;
+        __atomic_store_n(p_uring->p_cq_head, head, __ATOMIC_RELEASE);
+
+        salt_io_uring_complete(p_uring, user_data, res);
+    }
+}
+
+/* Queues the read of the link if its buffer is empty and the write of the link if bytes wait */
+static int salt_io_uring_prepare(salt_io_uring_t *p_uring)
+{
+    if (p_uring->link_fd < 0 || p_uring->failed) return 0;
+
+    if (!p_uring->rx_busy && p_uring->rx_begin == p_uring->rx_end)
+    {
+        p_uring->rx_begin = p_uring->rx_end = 0;
+        if (salt_io_uring_queue_link(p_uring, 0, p_uring->rx, SALT_IO_URING_RX_SIZE) < 0) return -1;
+        p_uring->rx_busy = 1;
+    }
+    if (p_uring->wire_busy == 0 && p_uring->wire_len > 0)
+    {
+        if (salt_io_uring_queue_link(p_uring, 1, p_uring->wire, p_uring->wire_len) < 0) return -1;
+        p_uring->wire_busy = p_uring->wire_len;
+    }
+
+    return 0;
+}
+
+/*
+ * One pass of the event loop: queues the read of the link if its buffer
+ * is empty and the write of the link if bytes wait, passes the queue to
+ * the kernel, waits up to timeout_ms (< 0 forever, 0 not at all) for
+ * a completion and reaps all completions. A failed link is reported by
+ * p_uring->failed, -1 is returned only if the ring failed.
+ */
+static int salt_io_uring_pump(salt_io_uring_t *p_uring, int timeout_ms)
+{
+    struct io_uring_sqe *p_sqe;
+
+    salt_io_uring_reap(p_uring);
+
+    if (salt_io_uring_prepare(p_uring) < 0) return -1;
+
+    if (timeout_ms > 0)
+    {
+        /* Ends the wait after the timeout or after one other completion */
+        p_uring->timeout[0] = timeout_ms / 1000;
+        p_uring->timeout[1] = (int64_t) (timeout_ms % 1000) * 1000000;
+
+        p_sqe = salt_io_uring_sqe(p_uring, SALT_IO_URING_TAG(SALT_IO_URING_TIMEOUT, 0));
+        if (p_sqe == NULL) return -1;
+        p_sqe->opcode = IORING_OP_TIMEOUT;
+        p_sqe->addr = (uint64_t) (uintptr_t) p_uring->timeout;
+        p_sqe->len = 1;
+        p_sqe->off = 1;
+        salt_io_uring_queue(p_uring);
+    }
+
+    if (timeout_ms != 0 || p_uring->sq_queued > 0)
+    {
+        if (salt_io_uring_enter(p_uring, (timeout_ms != 0) ? 1 : 0) < 0) return -1;
+    }
+
+    salt_io_uring_reap(p_uring);
+
+    return 0;
+}
+
+/* ====== Files ======= */
+
+/* 
+ * Opens the entry of the owner for its operations, -1 without an owner.
+ * An owner submitted again before it was returned keeps its entry.
+ */
+static int salt_io_uring_owner_open(salt_io_uring_t *p_uring, void *p_owner)
+{
+    int i, free_entry = -1;
+
+    if (p_owner == NULL) return -1;
+
+    for (i = 0; i < SALT_IO_URING_FILE_OPS; i++)
+    {
+        if (p_uring->owners[i].p_owner == p_owner) break;
+        if (p_uring->owners[i].p_owner == NULL && free_entry < 0) free_entry = i;
+    }
+    if (i == SALT_IO_URING_FILE_OPS)
+    {
+        /* More owners than entries, the caller does not take its owners back */
+        if (free_entry < 0) return -2;
+        i = free_entry;
+        p_uring->owners[i].p_owner = p_owner;
+        p_uring->owners[i].busy = 0;
+    }
+    p_uring->owners[i].open = 1;
+
+    return i;
+}
+
+/* Takes a free operation, waits for one if all are in flight */
+static int salt_io_uring_op(salt_io_uring_t *p_uring, int fd, uint8_t *p_data, uint32_t size,
+                            uint64_t offset, int owner, int write)
+{
+    int i;
+
+    for (;;)
+    {
+        for (i = 0; i < SALT_IO_URING_FILE_OPS; i++)
+        {
+            if (!p_uring->ops[i].used) break;
+        }
+        if (i < SALT_IO_URING_FILE_OPS) break;
+
+        if (salt_io_uring_pump(p_uring, -1) < 0) return -1;
+    }
+
+    p_uring->ops[i].p_data = p_data;
+    p_uring->ops[i].size = size;
+    p_uring->ops[i].offset = offset;
+    p_uring->ops[i].owner = owner;
+    p_uring->ops[i].fd = fd;
+    p_uring->ops[i].write = (uint8_t) write;
+    p_uring->ops[i].used = 1;
+
+    if (write) p_uring->writes_busy++;
+    else p_uring->reads_busy++;
+    if (owner >= 0) p_uring->owners[owner].busy++;
+
+    return salt_io_uring_queue_file(p_uring, i);
+}
+
+int salt_io_uring_read_file(salt_io_uring_t *p_uring, int fd, uint8_t *p_buffer, uint32_t size,
+                            uint64_t offset, void *p_owner)
+{
+    uint32_t done, chunk;
+    int owner = salt_io_uring_owner_open(p_uring, p_owner);
+
+    if (owner < -1) return -1;
+
+    /* The owner is not returned before its last read is submitted */
+    for (done = 0; done < size; done += chunk)
+    {
+        chunk = (size - done < SALT_IO_URING_FILE_CHUNK) ? size - done : SALT_IO_URING_FILE_CHUNK;
+
+        if (salt_io_uring_op(p_uring, fd, &p_buffer[done], chunk, offset + done, owner, 0) < 0) break;
+    }
+
+    /* Read ahead, submitted together with the next operation of the link */
+    if (owner >= 0)
+    {
+        p_uring->owners[owner].open = 0;
+        if (done < size) return -1;
+        if (p_uring->link_fd < 0 && salt_io_uring_pump(p_uring, 0) < 0) return -1;
+
+        return p_uring->file_failed ? -1 : 0;
+    }
+
+    while (p_uring->reads_busy > 0)
+    {
+        if (salt_io_uring_pump(p_uring, -1) < 0) return -1;
+    }
+
+    return (done < size || p_uring->file_failed) ? -1 : 0;
+}
+
+int salt_io_uring_write_file(salt_io_uring_t *p_uring, int fd, uint8_t **pp_data,
+                             const uint32_t *p_sizes, int count, uint64_t offset, void *p_owner, int last)
+{
+    int i, owner = salt_io_uring_owner_open(p_uring, p_owner);
+
+    if (owner < -1) return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        if (salt_io_uring_op(p_uring, fd, pp_data[i], p_sizes[i], offset, owner, 1) < 0) break;
+        offset += p_sizes[i];
+    }
+
+    /* The owner is returned after the writes of its last call */
+    if (owner >= 0 && (last || i < count)) p_uring->owners[owner].open = 0;
+    if (i < count) return -1;
+
+    /* Submitted together with the next read of the link */
+    if (p_uring->link_fd < 0 && salt_io_uring_pump(p_uring, 0) < 0) return -1;
+
+    return p_uring->file_failed ? -1 : 0;
+}
+
+/* Takes an owner whose operations finished, NULL if there is none */
+static void *salt_io_uring_owner_done(salt_io_uring_t *p_uring)
+{
+    salt_io_uring_owner_t *p_entry;
+    void *p_owner;
+    int i;
+
+    for (i = 0; i < SALT_IO_URING_FILE_OPS; i++)
+    {
+        p_entry = &p_uring->owners[i];
+        if (p_entry->p_owner == NULL || p_entry->open || p_entry->busy > 0) continue;
+
+        p_owner = p_entry->p_owner;
+        p_entry->p_owner = NULL;
+
+        return p_owner;
+    }
+
+    return NULL;
+}
+
+void *salt_io_uring_file_done(salt_io_uring_t *p_uring, int wait)
+{
+    void *p_owner;
+
+    salt_io_uring_reap(p_uring);
+
+    while ((p_owner = salt_io_uring_owner_done(p_uring)) == NULL && 
+           wait && p_uring->writes_busy + p_uring->reads_busy > 0)
+    {
+        if (salt_io_uring_pump(p_uring, -1) < 0) return NULL;
+    }
+
+    return p_owner;
+}
+
+/* ====== io_uring transport ======= */
+
+static int uring_send(salt_io_ctx_t *p_ctx, uint8_t **pp_bufs, const int *p_sizes, int count)
+{
+    salt_io_uring_t *p_uring = p_ctx->p_uring;
+    uint32_t n;
+    int written = 0, i;
+
+    if (salt_io_uring_pump(p_uring, 0) < 0 || p_uring->failed) return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        n = SALT_IO_URING_WIRE_SIZE - p_uring->wire_len;
+        if (n > (uint32_t) p_sizes[i]) n = (uint32_t) p_sizes[i];
+
+        memcpy(&p_uring->wire[p_uring->wire_len], pp_bufs[i], n);
+        p_uring->wire_len += n;
+        written += (int) n;
+
+        if (n < (uint32_t) p_sizes[i]) break;
+    }
+
+    /* The write is submitted at once if the link is idle */
+    if (written > 0 && p_uring->wire_busy == 0 && salt_io_uring_pump(p_uring, 0) < 0) return -1;
+
+    return written;
+}
+
+static int uring_recv(salt_io_ctx_t *p_ctx, uint8_t *p_buf, int size)
+{
+    salt_io_uring_t *p_uring = p_ctx->p_uring;
+    uint32_t n;
+
+    salt_io_uring_reap(p_uring);
+
+    n = p_uring->rx_end - p_uring->rx_begin;
+    if (n == 0)
+    {
+        /* A new read is submitted by the next wait together with its sleep, a second call submits it itself */
+        if (p_uring->sq_queued > 0) return (salt_io_uring_pump(p_uring, 0) < 0 || p_uring->failed) ? -1 : 0;
+
+        return (salt_io_uring_prepare(p_uring) < 0 || p_uring->failed) ? -1 : 0;
+    }
+
+    if (n > (uint32_t) size) n = (uint32_t) size;
+    memcpy(p_buf, &p_uring->rx[p_uring->rx_begin], n);
+    p_uring->rx_begin += n;
+
+    return (int) n;
+}
+
+static int uring_wait(salt_io_ctx_t *p_ctx, int writable, int timeout_ms)
+{
+    salt_io_uring_t *p_uring = p_ctx->p_uring;
+    uint64_t deadline = salt_io_uring_time_us() + (uint64_t) timeout_ms * 1000, now;
+    int remaining = timeout_ms;
+
+    for (;;)
+    {
+        salt_io_uring_reap(p_uring);
+        if (p_uring->failed) return -1;
+
+        if (writable ? (p_uring->wire_len < SALT_IO_URING_WIRE_SIZE) :
+                       (p_uring->rx_end > p_uring->rx_begin))
+        {
+            return 1;
+        }
+
+        if (timeout_ms >= 0)
+        {
+            now = salt_io_uring_time_us();
+            if (now >= deadline) return 0;
+            remaining = (int) ((deadline - now + 999) / 1000);
+        }
+
+        if (salt_io_uring_pump(p_uring, remaining) < 0) return -1;
+    }
+}
+
+static int uring_out_queue(salt_io_ctx_t *p_ctx)
+{
+    salt_io_uring_t *p_uring = p_ctx->p_uring;
+    int queued;
+
+    /* my_write() waits by a sleep, the finished write is reaped and the next one submitted here */
+    salt_io_uring_reap(p_uring);
+    if (p_uring->wire_busy == 0 && p_uring->wire_len > 0 && salt_io_uring_pump(p_uring, 0) < 0) return -1;
+
+    queued = p_uring->p_link->out_queue(p_ctx);
+
+    return (int) p_uring->wire_len + ((queued > 0) ? queued : 0);
+}
+
+static int uring_in_queue(salt_io_ctx_t *p_ctx)
+{
+    salt_io_uring_reap(p_ctx->p_uring);
+
+    return (int) (p_ctx->p_uring->rx_end - p_ctx->p_uring->rx_begin);
+}
+
+static int uring_drain(salt_io_ctx_t *p_ctx)
+{
+    salt_io_uring_t *p_uring = p_ctx->p_uring;
+
+    while (p_uring->wire_len > 0)
+    {
+        if (salt_io_uring_pump(p_uring, -1) < 0 || p_uring->failed) return -1;
+    }
+
+    return p_uring->p_link->drain(p_ctx);
+}
+
+static void uring_close(salt_io_ctx_t *p_ctx)
+{
+    salt_io_uring_t *p_uring = p_ctx->p_uring;
+
+    uring_drain(p_ctx);
+
+    /* The reads and writes of the files in flight finish before the ring is closed */
+    while (p_uring->writes_busy + p_uring->reads_busy > 0 && salt_io_uring_file_done(p_uring, 1) != NULL);
+
+    salt_io_uring_exit(p_uring);
+    if (p_uring->link_batching)
+        RS232_PortSetReadBatching(p_ctx->p_port, SALT_IO_READ_VMIN, SALT_IO_READ_VTIME);
+    if (p_uring->fast_poll) fcntl(p_uring->link_fd, F_SETFL, p_uring->link_flags);
+    p_ctx->read_batching = p_uring->link_batching;
+
+    p_ctx->p_transport = p_uring->p_link;
+    p_ctx->p_uring = NULL;
+    p_ctx->p_transport->close(p_ctx);
+}
+
+static int uring_fd(salt_io_ctx_t *p_ctx)
+{
+    /* Readable when completions wait in the ring */
+    return p_ctx->p_uring->ring_fd;
+}
+
+const salt_io_transport_t salt_io_uring_transport = {
+    "io_uring",
+    uring_send,
+    uring_recv,
+    uring_wait,
+    uring_out_queue,
+    uring_in_queue,
+    uring_drain,
+    uring_close,
+    uring_fd
+};
+
+int salt_io_start_uring(salt_io_ctx_t *p_ctx, salt_io_uring_t *p_uring)
+{
+    const salt_io_transport_t *p_link = p_ctx->p_transport;
+
+    if (p_uring->ring_fd < 0 || p_ctx->p_uring != NULL || p_ctx->p_thread != NULL ||
+        p_ctx->p_arq != NULL || p_ctx->p_fec != NULL || p_ctx->p_bond != NULL ||
+        p_link->fd(p_ctx) < 0 || salt_io_drain(p_ctx) != 0)
+    {
+        return 1;
+    }
+
+    p_uring->p_link = p_link;
+    p_uring->link_fd = p_link->fd(p_ctx);
+
+    /* 
+     * A read of the port waiting for VMIN bytes would hold short messages
+     * VTIME back, in the ring it returns after the first byte.
+     */
+    p_uring->link_batching = p_ctx->read_batching;
+    if (p_uring->link_batching && p_link == &salt_io_serial_transport &&
+        RS232_PortSetReadBatching(p_ctx->p_port, 1, 0) != 0)
+    {
+        return 1;
+    }
+
+    /* The kernel waits for a blocking descriptor in the ring, a non-blocking one would fail with EAGAIN */
+    p_uring->link_flags = fcntl(p_uring->link_fd, F_GETFL);
+    if (p_uring->fast_poll && p_uring->link_flags >= 0) 
+        fcntl(p_uring->link_fd, F_SETFL, p_uring->link_flags & ~O_NONBLOCK);
+    p_uring->rx_begin = p_uring->rx_end = 0;
+    p_uring->wire_len = p_uring->wire_busy = 0;
+
+    p_ctx->p_uring = p_uring;
+    p_ctx->p_transport = &salt_io_uring_transport;
+
+    /* The ring holds the read of the link, my_read() never blocks in it */
+    p_ctx->read_batching = 0;
+
+    return 0;
+}
+
+#else /* __linux__ */
+
+int salt_io_uring_init(salt_io_uring_t *p_uring)
+{
+    p_uring->ring_fd = -1;
+    printf("io_uring is supported only on linux\n");
+
+    return 1;
+}
+
+void salt_io_uring_exit(salt_io_uring_t *p_uring)
+{
+    p_uring->ring_fd = -1;
+}
+
+int salt_io_start_uring(salt_io_ctx_t *p_ctx, salt_io_uring_t *p_uring)
+{
+    (void) p_ctx; (void) p_uring;
+
+    return 1;
+}
+
+int salt_io_uring_read_file(salt_io_uring_t *p_uring, int fd, uint8_t *p_buffer, uint32_t size,
+                            uint64_t offset, void *p_owner)
+{
+    (void) p_uring; (void) fd; (void) p_buffer; (void) size; (void) offset; (void) p_owner;
+
+    return -1;
+}
+
+int salt_io_uring_write_file(salt_io_uring_t *p_uring, int fd, uint8_t **pp_data,
+                             const uint32_t *p_sizes, int count, uint64_t offset, void *p_owner, int last)
+{
+    (void) p_uring; (void) fd; (void) pp_data; (void) p_sizes; (void) count; (void) offset; (void) p_owner;
+    (void) last;
+
+    return -1;
+}
+
+void *salt_io_uring_file_done(salt_io_uring_t *p_uring, int wait)
+{
+    (void) p_uring; (void) wait;
+
+    return NULL;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,234 @@
+/*
+ * salt_lz.c    v.0.1
+ *
+ * LZ compression of the sent blocks
+ *
+ * The compressor finds the matches by a hash table of the 4-byte
+ * sequences (the last position of each hash), a miss moves faster
+ * over the bytes which do not match, so a block of noise costs little.
+ * The decompressor checks every length and offset, a damaged block is
+ * refused instead of writing out of the buffer.
+ *
+ * Windows/Linux
+ *
+ * KEMT FEI TUKE, Diploma thesis
+ * ===============================================
+ */
+
+/* ==== Basic libraries for working in C ==== */
+#include <string.h>
+#include <math.h>
+
+#include "salt_lz.h"
+
+/* 4 bytes of the block, the block may be unaligned */
+static uint32_t salt_lz_read32(const uint8_t *p_data)
+{
+    uint32_t value;
+
+    memcpy(&value, p_data, sizeof(value));
+
+    return value;
+}
+
+/* Multiplicative hash of the sequence, the upper bits are the index */
+static uint32_t salt_lz_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - SALT_LZ_HASH_LOG);
+}
+
+/* Rest of a length over 15 of the token, bytes of 255 and the last one */
+static uint8_t *salt_lz_put_length(uint8_t *p_out, uint32_t length)
+{
+    while (length >= 255)
+    {
+        *p_out++ = 255;
+        length -= 255;
+    }
+    *p_out++ = (uint8_t) length;
+
+    return p_out;
+}
+
+/*
+ * Writes the literals and the match of one sequence, the last one has
+ * no match (match 0).
+ *
+ * @return  end of the sequence, NULL if it does not fit
+ */
+static uint8_t *salt_lz_sequence(uint8_t *p_out,
+                                 const uint8_t *p_end,
+                                 const uint8_t *p_literals,
+                                 uint32_t literals,
+                                 uint32_t offset,
+                                 uint32_t match)
+{
+    uint64_t need = 1 + (uint64_t) literals + literals / 255 + 1;
+    int last = (match == 0);
+    uint8_t token;
+
+    if (!last) need += 2 + (match - SALT_LZ_MIN_MATCH) / 255 + 1;
+    if ((uint64_t) (p_end - p_out) < need) return NULL;
+
+    token = (uint8_t) (((literals < 15) ? literals : 15) << 4);
+    if (!last)
+    {
+        match -= SALT_LZ_MIN_MATCH;
+        token |= (uint8_t) ((match < 15) ? match : 15);
+    }
+    *p_out++ = token;
+
+    if (literals >= 15) p_out = salt_lz_put_length(p_out, literals - 15);
+    memcpy(p_out, p_literals, literals);
+    p_out += literals;
+    if (last) return p_out;
+
+    *p_out++ = (uint8_t) offset;
+    *p_out++ = (uint8_t) (offset >> 8);
+    if (match >= 15) p_out = salt_lz_put_length(p_out, match - 15);
+
+    return p_out;
+}
+
+uint32_t salt_lz_compress(salt_lz_t *p_lz,
+                          const uint8_t *p_src,
+                          uint32_t size,
+                          uint8_t *p_dst,
+                          uint32_t capacity)
+{
+    const uint8_t *p_end = p_dst + capacity;
+    uint8_t *p_out = p_dst;
+    uint32_t pos = 0, anchor = 0, limit, ref, sequence, hash, match;
+
+    memset(p_lz->table, 0, sizeof(p_lz->table));
+
+    if (size > SALT_LZ_MATCH_LIMIT)
+    {
+        limit = size - SALT_LZ_MATCH_LIMIT;
+        while (pos < limit)
+        {
+            sequence = salt_lz_read32(&p_src[pos]);
+            hash = salt_lz_hash(sequence);
+            ref = p_lz->table[hash];
+            p_lz->table[hash] = pos;
+
+            if (ref >= pos || pos - ref > SALT_LZ_MAX_OFFSET || salt_lz_read32(&p_src[ref]) != sequence)
+            {
+                /* The longer nothing matches, the more bytes are skipped */
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            /* The match grows back over the literals and forward to the last literals */
+            while (pos > anchor && ref > 0 && p_src[pos - 1] == p_src[ref - 1])
+            {
+                pos--;
+                ref--;
+            }
+            match = SALT_LZ_MIN_MATCH;
+            while (pos + match < size - SALT_LZ_LAST_LITERALS && p_src[pos + match] == p_src[ref + match])
+            {
+                match++;
+            }
+
+            p_out = salt_lz_sequence(p_out, p_end, &p_src[anchor], pos - anchor, pos - ref, match);
+            if (p_out == NULL) return 0;
+
+            pos += match;
+            anchor = pos;
+            if (pos < limit) p_lz->table[salt_lz_hash(salt_lz_read32(&p_src[pos - 2]))] = pos - 2;
+        }
+    }
+
+    p_out = salt_lz_sequence(p_out, p_end, &p_src[anchor], size - anchor, 0, 0);
+    if (p_out == NULL) return 0;
+
+    return (uint32_t) (p_out - p_dst);
+}
+
+int salt_lz_decompress(const uint8_t *p_src,
+                       uint32_t size,
+                       uint8_t *p_dst,
+                       uint32_t capacity,
+                       uint32_t *p_size)
+{
+    uint32_t in = 0, out = 0, literals, match, offset, i;
+    uint8_t token, byte;
+
+    while (in < size)
+    {
+        token = p_src[in++];
+
+        literals = token >> 4;
+        if (literals == 15)
+        {
+            do
+            {
+                if (in >= size) return -1;
+                byte = p_src[in++];
+                literals += byte;
+                if (literals > size) return -1;
+            } while (byte == 255);
+        }
+        if (literals > size - in || literals > capacity - out) return -1;
+        memcpy(&p_dst[out], &p_src[in], literals);
+        in += literals;
+        out += literals;
+
+        /* The last sequence has no match */
+        if (in == size) break;
+
+        if (size - in < 2) return -1;
+        offset = (uint32_t) p_src[in] | ((uint32_t) p_src[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out) return -1;
+
+        match = token & 0x0F;
+        if (match == 15)
+        {
+            do
+            {
+                if (in >= size) return -1;
+                byte = p_src[in++];
+                match += byte;
+                if (match > capacity) return -1;
+            } while (byte == 255);
+        }
+        match += SALT_LZ_MIN_MATCH;
+        if (match > capacity - out) return -1;
+
+        /* A match closer than its length repeats the bytes it writes */
+        if (offset >= match) memcpy(&p_dst[out], &p_dst[out - offset], match);
+        else for (i = 0; i < match; i++) p_dst[out + i] = p_dst[out - offset + i];
+        out += match;
+    }
+
+    *p_size = out;
+
+    return 0;
+}
+
+double salt_lz_entropy(const uint8_t *p_data, uint32_t size)
+{
+    uint32_t counts[256], step, count = 0, i;
+    double bits = 0, p;
+
+    if (size == 0) return 0;
+
+    memset(counts, 0, sizeof(counts));
+    step = (size > SALT_LZ_SAMPLE) ? size / SALT_LZ_SAMPLE : 1;
+    for (i = 0; i < size && count < SALT_LZ_SAMPLE; i += step)
+    {
+        counts[p_data[i]]++;
+        count++;
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        if (counts[i] == 0) continue;
+        p = (double) counts[i] / count;
+        bits -= p * log2(p);
+    }
+
+    return bits;
+}
@@ -100,7 +100,7 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
     uint8_t *payload = NULL;
 
     /* J.V. */
-    clock_t start;
+    clock_t start = clock();
 
     while (proceed) {
         proceed = 0;
@@ -423,10 +423,12 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
     }
 
     /* End of data transmission measurement  J.V.*/  
-    clock_t stop = clock();
-    double elapsed = (double)(stop - start)  / CLOCKS_PER_SEC;
-    printf("\n******************| Salt Handshake |*********************\n");
-    printf("Server: Salt channelv2 handshake lasted %f second\n", elapsed);
+    if (SALT_SUCCESS == ret_code) {
+        clock_t stop = clock();
+        double elapsed = (double)(stop - start)  / CLOCKS_PER_SEC;
+        printf("\n******************| Salt Handshake |*********************\n");
+        printf("Server: Salt channelv2 handshake lasted %f second\n", elapsed);
+    }
 
     return ret_code;
 }
@@ -0,0 +1,73 @@
+#!/bin/bash
+#
+# Benchmark of the transfer over a pseudo terminal (Linux), once with the
+# reads and writes of the port and of the files by system calls and once
+# through the io_uring (-u). Prints the wall time, the CPU time per MB and
+# the system calls of the client and of the server. Other options of both
+# programs can be given, e.g. the ARQ over a noisy line (make noise).
+#
+# usage: ./bench.sh [approximate size of the test file in bytes] [options ...]
+#        make bench
+#        make noise
+#
+# KEMT FEI TUKE, Diploma thesis
+
+SIZE=${1:-1000000}
+[ $# -gt 0 ] && shift
+HERE=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+
+# One transfer, $1 are the options of both programs
+run()
+{
+    local options="$1" port server
+
+    rm -f "$WORK"/received_data.txt*
+    (cd "$WORK" && exec "$HERE/server" $options pty > server.log 2>&1) &
+    server=$!
+
+    # The server prints the name of the pseudo terminal for the client
+    for i in $(seq 50); do
+        port=$(grep -ao "/dev/pts/[0-9]*" "$WORK/server.log" | head -1)
+        [ -n "$port" ] && break
+        sleep 0.1
+    done
+    if [ -z "$port" ]; then
+        echo "The server did not open a pseudo terminal"
+        kill $server 2> /dev/null
+        return 1
+    fi
+
+    printf "0\nbench.txt\n%s\n1000\n" "$SIZE" |
+        (cd "$WORK" && "$HERE/client" $options $port > client.log 2>&1)
+    wait $server
+
+    if ! cmp -s "$WORK/bench.txt" "$WORK/received_data.txt"; then
+        echo "${options:-(none)}: the received file differs"
+        return 1
+    fi
+
+    for side in client server; do
+        awk -v mode="${options:-(none)}" -v side=$side '
+            /time took seconds/         { wall = $NF }
+            /CPU time per transferred/  { cpu = $(NF - 1) }
+            /Read system calls/         { gsub(",", ""); reads = $4; writes = $8 }
+            /io_uring calls/            { for (i = 1; i < NF; i++) if ($i == "io_uring") uring = $(i + 2) }
+            END { printf "%-16s %-7s %8s s %10s s %10s %10s %10s\n",
+                         mode, side, wall, cpu, reads, writes, uring + 0 }' "$WORK/$side.log"
+    done
+}
+
+[ -x "$HERE/client" ] && [ -x "$HERE/server" ] || { echo "Build the programs first (make)"; exit 1; }
+
+printf "%-16s %-7s %10s %12s %10s %10s %10s\n" "options" "side" "wall" "CPU per MB" "reads" "writes" "io_uring"
+if [ $# -eq 0 ]; then
+    run "" || failed=1
+    run "-u" || failed=1
+fi
+for options in "$@"; do
+    run "$options" || failed=1
+done
+
+rm -rf "$WORK"
+exit ${failed:-0}
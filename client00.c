@@ -43,7 +43,6 @@
 * Macro allows diagnostic information to be written 
 * to the standard error file.
 */
-#include <assert.h>
 
 /* ===== RS-232 local macro definition & library ===== */
 /* RS232 library */
@@ -68,10 +67,27 @@
 /* ====== Public macro definitions ================ */
 /* The max size of one data in one block sent */
 #define BLOCK_SIZE             4067
-/* Sleep milliSeconds  */
-#define MILISECONDS            100
 
-int main(void) 
+/**
+ * Usage:   client              the port CPORT_NR
+ *          client <device>     other device, e.g. the pseudo terminal 
+ *                              printed by "server pty"
+ *          client unix <path>  AF_UNIX socket of "server unix <path>"
+ *          client tcp <port>   TCP port of "server tcp <port>"
+ *          client -t ...       any of the above, the link is owned by an I/O
+ *                              thread (Linux), see salt_io_start_thread()
+ *          client -c / -a / -f COBS framing, ARQ, Reed-Solomon FEC, the server
+ *                              needs the same options
+ *          client -e <ber> ... emulated bit errors of the sent bytes
+ *          client -u ...       the file and the link go through one io_uring
+ *                              (Linux), see salt_io_start_uring()
+ *          client -z ...       the blocks are compressed (LZ), the server
+ *                              learns it from the resume
+ *          client bond <device> <device> ...
+ *                              ports bonded into one link, in the order of
+ *                              the ports of "server bond ..."
+ */
+int main(int argc, char *argv[]) 
 {	
 
 /* ========  Variables & arrays ======== */
@@ -98,21 +114,22 @@ int main(void)
 
     /* The size of the transferred file. */    
  
-    uint32_t file_size, 
+    uint64_t file_size;
 
-    /*  Test return value for sleep()  */
-        sleep_return,
     /* Test return value for sending data */
-        verify_send_data;
+    uint32_t verify_send_data;
 
     /**
     * tx_buffer -> encrypted data
-    * input -> loading input file 
+    * input -> source of the blocks of the input file 
     */     
-    uint8_t  tx_buffer[BLOCK_SIZE + SALT_WRITE_OVRHD_SIZE], *input;               
+    uint8_t  tx_buffer[BLOCK_SIZE + SALT_BLOCK_HEADER_SIZE + SALT_WRITE_OVRHD_SIZE];
+    salt_file_source_t input;
+    char file_id[2 * SALT_DIGEST_SIZE + 1]; /**< Id of the file for a resume. */
 
     /* Time measurement variables */
     clock_t start_t, end_t;
+    double wall_start, wall_end;
 
 /* ======= Variables for working with salt-channel protocol ======== */
 
@@ -125,11 +142,55 @@ int main(void)
     salt_ret_t ret_msg, ret_hndsk;  
 
     salt_msg_t msg_out;    /**< Structure used for easier creating/reading/working with messages. */
+    uint64_t ranges[2 * SALT_RESUME_RANGES]; /**< Byte ranges of the file which the server misses. */
+    int range_count;
+
+    salt_io_ctx_t io_ctx;  /**< Context of the port for my_write() / my_read(). */
+    salt_io_thread_t io_thread;  /**< I/O thread of the link with the option -t. */
+    int use_thread = 0;
+    int use_cobs = 0;      /**< COBS framing with the option -c, the server needs it too. */
+    salt_io_arq_t io_arq;  /**< ARQ of the link with the option -a, the server needs it too. */
+    int use_arq = 0;
+    salt_io_fec_t io_fec;  /**< FEC of the link with the option -f, the server needs it too. */
+    int use_fec = 0;
+    salt_io_uring_t io_uring; /**< io_uring of the file and the link with the option -u (Linux). */
+    int use_uring = 0;
+    salt_compressor_t compressor; /**< Compression of the blocks with the option -z. */
+    int use_lz = 0;
+    double error_rate = 0; /**< Emulated bit errors of the sent bytes with the option -e <ber>. */
+    salt_io_ctx_t bond_ports[SALT_IO_BOND_MAX]; /**< Ports of the bond. */
+    salt_io_bond_t io_bond;
+    int i;
 
 /* ======== Program information ======== */
     printf("\nA simple application that demonstrates the implementation of the Salt channel protocol\n");
     printf("on the RS232 communication channel and the sending of the loaded file.\n");
 
+/* ========  Options  ======== */
+    while (argc > 1 && (strcmp(argv[1], "-t") == 0 || strcmp(argv[1], "-c") == 0 || 
+                        strcmp(argv[1], "-a") == 0 || strcmp(argv[1], "-f") == 0 ||
+                        strcmp(argv[1], "-u") == 0 || strcmp(argv[1], "-z") == 0 ||
+                        (strcmp(argv[1], "-e") == 0 && argc > 2)))
+    {
+        if (argv[1][1] == 't') use_thread = 1;
+        else if (argv[1][1] == 'z') use_lz = 1;
+        else if (argv[1][1] == 'c') use_cobs = 1;
+        else if (argv[1][1] == 'f') use_fec = 1;
+        else if (argv[1][1] == 'u') use_uring = 1;
+        else if (argv[1][1] == 'e')
+        {
+            error_rate = atof(argv[2]);
+            argc--;
+            argv++;
+        }
+        else use_arq = 1;
+        argc--;
+        argv++;
+    }
+
+    /* The file is read and the link is served by one io_uring */
+    if (use_uring && salt_io_uring_init(&io_uring)) return 0;
+
 /* ========  Creating / loading input data  ======== */
     printf("\n\n");
     printf("Do you want to use a random text file to test the application\n"); 
@@ -161,77 +222,166 @@ int main(void)
     }
     printf("\n");
 
-    /* Loading input data (your file)  */
-    if (select_file) input = loading_file(own_file, 
-                                          &file_size, 
-                                          select_file);
+    /* Loading input data (your file) or random generate file and loading input data */
+    if (loading_file(own_file, &file_size, select_file, BLOCK_SIZE, &input, 
+                     use_uring ? &io_uring : NULL) != 0) return -1;
 
-    /* Random generate file and loading input data */
-    else input = loading_file(own_file, 
-                              &file_size, 
-                              select_file);
+    /* The id is taken from the metadata and the edges of the file, not from all of it */
+    if (salt_source_id(&input, file_id) != 0)
+    {
+        printf("Failed to read file %s\n", own_file);
+        return -1;
+    }
+
+    printf("\nFile size is: %llu\n\n", (unsigned long long) file_size);
 
-    printf("\nFile size is: %u\n\n", file_size);
+    /* Text goes compressed, a block which does not compress goes raw */
+    if (use_lz && salt_compressor_init(&compressor, BLOCK_SIZE) != 0)
+    {
+        printf("Can not allocate the compressor\n");
+        return -1;
+    }
     
 /* ===========  Open port on RS2_32  ============ */
 
-    if(RS232_OpenComport(cport_nr, bdrate, mode, 0))
+    if (argc > 2 && strcmp(argv[1], "bond") == 0)
+    {
+        for (i = 0; i < argc - 2 && i < SALT_IO_BOND_MAX; i++)
+        {
+            if (salt_io_open_device(&bond_ports[i], argv[i + 2], bdrate, mode, 0))
+            {
+                printf("Can not open device %s\n", argv[i + 2]);
+                return 0;
+            }
+            if (error_rate > 0) salt_io_set_error_rate(&bond_ports[i], error_rate);
+        }
+
+        /* A slower port gets less stripes */
+        if (salt_io_open_bond(&io_ctx, &io_bond, bond_ports, i, SALT_IO_BOND_QUEUE_DEPTH))
+        {
+            printf("Can not bond the ports\n");
+            return 0;
+        }
+    }
+    else if (argc > 2 && (strcmp(argv[1], "unix") == 0 || strcmp(argv[1], "tcp") == 0))
+    {
+        if ((argv[1][0] == 'u') ? salt_io_open_unix(&io_ctx, argv[2], 0) : 
+                                  salt_io_open_tcp(&io_ctx, (uint16_t) atoi(argv[2]), 0))
+        {
+            printf("Can not connect socket\n");
+            return 0;
+        }
+    }
+    else if (argc > 1)
+    {
+        if (salt_io_open_device(&io_ctx, argv[1], bdrate, mode, 0))
+        {
+            printf("Can not open device %s\n", argv[1]);
+            return 0;
+        }
+    }
+    else if(salt_io_open_port(&io_ctx, cport_nr, bdrate, mode, 0))
   	{
     	printf("Can not open comport\n");
     	return 0;
   	}
 
+    /* Noise of the line for the tests of the FEC and the ARQ */
+    if (error_rate > 0) salt_io_set_error_rate(&io_ctx, error_rate);
+
+    /* A damaged frame is dropped instead of desynchronizing the stream */
+    if (use_cobs) salt_io_set_framing(&io_ctx, SALT_IO_FRAMING_COBS);
+
+    /* The reads and writes of the link are submitted to the ring of the file */
+    if (use_uring && salt_io_start_uring(&io_ctx, &io_uring))
+    {
+        printf("Can not start io_uring on the link\n");
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
+    /* Encryption of the next block overlaps the sending of the previous one */
+    if (use_thread && salt_io_start_thread(&io_ctx, &io_thread))
+    {
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
+    /* The damaged bytes are corrected by the receiver */
+    if (use_fec && salt_io_start_fec(&io_ctx, &io_fec, SALT_IO_FEC_PARITY))
+    {
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
+    /* Damaged chunks are sent again instead of closing the session */
+    if (use_arq && salt_io_start_arq(&io_ctx, &io_arq))
+    {
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
 /* ========  Salt-channel version 2 implementation and Salt handshake ======== */
     ret_hndsk = salt_impl_and_hndshk(&pc_a_channel, 
                                     my_write,
                                     my_read,
-                                    &cport_nr,
+                                    &io_ctx,
                                     &my_time,
                                     TRESHOLD);
     if (ret_hndsk == SALT_SUCCESS) verify++;
     else 
     {
         printf("Salt Handshake failed\n");
+        salt_source_close(&input);
+        if (use_lz) salt_compressor_free(&compressor);
+        salt_io_close(&io_ctx);
         return -1;
     }
-    if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS * 20)) == 0)
-    {
-        printf("Problem during sleep I/O");
-        return SALT_ERROR;
-    }
+
+    /* The highest baudrate of both ports (only on a serial link) */
+    bdrate = salt_baudrate_upshift_client(&pc_a_channel, &io_ctx, bdrate, mode);
 
 /* ========== Sending data and waiting for a confirmation message =========== */
     while (verify)
     {   
         int32_t size_check = salt_convert_size_and_send(&pc_a_channel, file_size);
-        if (size_check != 1) printf("Failed to send size message");
-
-        if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS * 20)) == 0)
+        if (size_check == 1) size_check = salt_convert_size_and_send(&pc_a_channel, BLOCK_SIZE);
+        if (size_check != 1)
         {
-            printf("Problem during sleep I/O");
+            salt_source_close(&input);
+            if (use_lz) salt_compressor_free(&compressor);
+            salt_io_close(&io_ctx);
             return -1;
         }
 
-        size_check = salt_convert_size_and_send(&pc_a_channel, BLOCK_SIZE);
-        if (size_check != 1) printf("Failed to send size message");
-
-        if ((sleep_return = sleep_miliseconds_win_linux(MILISECONDS * 20)) == 0)
+        /* 
+         * After a failure the server keeps the blocks it has, only the rest is sent.
+         * Its answer is the wait for the server, the sizes and the data need none.
+         */
+        range_count = salt_resume_client(&pc_a_channel, file_id, ranges, SALT_RESUME_RANGES, use_lz);
+        if (range_count < 0)
         {
-            printf("Problem during sleep I/O");
+            printf("Failed to read the resume point\n");
+            salt_io_close(&io_ctx);
             return -1;
         }
-       
+
         /* Start of transmission measurement */
         start_t = clock();
+        wall_start = wall_time_seconds();
         verify_send_data = salt_encrypt_and_send(&pc_a_channel,
                                                 tx_buffer,
-                                                BLOCK_SIZE + SALT_WRITE_OVRHD_SIZE,
+                                                sizeof(tx_buffer),
                                                 file_size,
                                                 BLOCK_SIZE,
-                                                input,
-                                                &msg_out);
+                                                &input,
+                                                &msg_out,
+                                                ranges,
+                                                (uint32_t) range_count,
+                                                use_lz ? &compressor : NULL);
         /* End of data transmission measurement */ 
         end_t = clock();
+        wall_end = wall_time_seconds();
         if (verify_send_data == 1) ret_msg = SALT_SUCCESS;
         else ret_msg = SALT_ERROR;
 
@@ -243,8 +393,13 @@ int main(void)
         {
             printf("Error during writing:\r\n");
             printf("Salt error read: 0x%02x\r\n", pc_a_channel.write_channel.err_code);
-            RS232_CloseComport(cport_nr);
-            assert(ret_msg == SALT_ERROR);
+
+            /* The session is lost, a new run of the client resumes from the journal of the server */
+            printf("Run the client again to send the rest of the file\n");
+            salt_source_close(&input);
+            if (use_lz) salt_compressor_free(&compressor);
+            salt_io_close(&io_ctx);
+            return -1;
         } else if (ret_msg == SALT_SUCCESS)
         {
             uint8_t check_data[STATIC_ARRAY];
@@ -261,8 +416,12 @@ int main(void)
                                                                 0);
             if (received_verify != 1) 
             {
+                /* The server has the whole file, the next run of the client only asks for it */
                 printf("Failed to read confirmation transmission transfer message\n");
-                assert(received_verify == 1);
+                salt_source_close(&input);
+                if (use_lz) salt_compressor_free(&compressor);
+                salt_io_close(&io_ctx);
+                return -1;
             }
             /**
              *  Verification of the confirmation message. 
@@ -282,16 +441,19 @@ int main(void)
 
 /* ===================  End of application  ======================== */
 
-    double elapsed = (double)(end_t - start_t)  / CLOCKS_PER_SEC;
-    printf("\n****************** Summary *********************\n");
-    printf("File transfer about size: %u time took seconds: %0.f\n\n", file_size, elapsed);
+    salt_print_transfer_summary(file_size, start_t, end_t, wall_end - wall_start);
+    salt_print_line_stats(&pc_a_channel);
+
+    /* The last staged frames must leave the port before it is closed */
+    salt_io_drain(&io_ctx);
+
+    /* The read ahead of the ring finishes before the ring is closed with the port */
+    salt_source_close(&input);
+    if (use_lz) salt_compressor_free(&compressor);
 
     printf("\nClosing RS-232...\n");
-    RS232_CloseComport(cport_nr);
+    salt_io_close(&io_ctx);
     printf("Finished.\n");
-
-    //Free allocated memory
-    free(input);
     
     return 0;
 }
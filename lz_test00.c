@@ -0,0 +1,224 @@
+/**
+ * ===============================================
+ * lz_test00.c     v.0.1
+ *
+ * KEMT FEI TUKE, Diploma thesis
+ *
+ * Check of the LZ compression of the blocks (salt_lz.c):
+ *      - known answers of the format of the LZ4 blocks
+ *      - round trip of text, runs, noise and of every small size
+ *      - every truncation of a compressed block
+ *      - bad offsets, lengths over the input or the output
+ *      - random damaged blocks
+ *
+ * The decompressor must refuse a damaged block without writing out
+ * of its buffer, the bytes behind the buffer are checked.
+ *
+ * make check
+ * ===============================================
+ */
+
+/* Basic libraries for working in C. */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "salt_lz.h"
+
+/* Largest checked block, the bytes behind the output must stay untouched */
+#define LZ_TEST_SIZE        (3 * 65536)
+#define LZ_TEST_GUARD       64
+#define LZ_TEST_GUARD_BYTE  0xA5
+
+static salt_lz_t lz;
+static uint8_t source[LZ_TEST_SIZE];
+static uint8_t packed[LZ_TEST_SIZE + LZ_TEST_SIZE / 255 + 16];
+static uint8_t output[LZ_TEST_SIZE + LZ_TEST_GUARD];
+static int failures;
+
+#define LZ_CHECK(condition, ...)                        \
+    do {                                                \
+        if (!(condition))                               \
+        {                                               \
+            printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            failures++;                                 \
+        }                                               \
+    } while (0)
+
+/* xorshift32, the same data in every run */
+static uint32_t lz_test_random(void)
+{
+    static uint32_t x = 0x1234567U;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return x;
+}
+
+/* Decompresses into capacity bytes and checks the guard behind them */
+static int lz_test_decompress(const uint8_t *p_src, uint32_t size, uint32_t capacity, uint32_t *p_size)
+{
+    uint32_t i;
+    int ret;
+
+    memset(output, LZ_TEST_GUARD_BYTE, sizeof(output));
+    ret = salt_lz_decompress(p_src, size, output, capacity, p_size);
+
+    for (i = capacity; i < capacity + LZ_TEST_GUARD; i++)
+    {
+        if (output[i] != LZ_TEST_GUARD_BYTE)
+        {
+            LZ_CHECK(0, "write behind the output at %u (capacity %u)", i, capacity);
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/* Compresses and decompresses the first size bytes of source */
+static void lz_test_round_trip(const char *p_name, uint32_t size)
+{
+    uint32_t length, unpacked = 0;
+
+    length = salt_lz_compress(&lz, source, size, packed, sizeof(packed));
+    LZ_CHECK(length > 0, "%s: %u bytes do not compress into %u", p_name, size, (uint32_t) sizeof(packed));
+    if (length == 0) return;
+
+    LZ_CHECK(lz_test_decompress(packed, length, size, &unpacked) == 0, "%s: %u bytes refused", p_name, size);
+    LZ_CHECK(unpacked == size && memcmp(output, source, size) == 0, "%s: %u bytes differ", p_name, size);
+
+    /* One byte less room than the block is refused */
+    if (size > 0)
+    {
+        LZ_CHECK(lz_test_decompress(packed, length, size - 1, &unpacked) != 0,
+                 "%s: %u bytes fit into %u", p_name, size, size - 1);
+    }
+}
+
+static void lz_test_known_answers(void)
+{
+    /* "abcd", a match 4 back of 9 bytes (overlapping), the last literals "efghi" */
+    static const uint8_t block[] = { 0x45, 'a', 'b', 'c', 'd', 0x04, 0x00, 0x50, 'e', 'f', 'g', 'h', 'i' };
+    static const char text[] = "abcdabcdabcdaefghi";
+
+    /* 32 bytes "ab" repeated: "ab", a match 2 back of 25 bytes, the last 5 literals */
+    static const uint8_t runs[] = { 0x2F, 'a', 'b', 0x02, 0x00, 0x06, 0x50, 'b', 'a', 'b', 'a', 'b' };
+    uint32_t unpacked = 0, length, i;
+
+    LZ_CHECK(lz_test_decompress(block, sizeof(block), 64, &unpacked) == 0, "known block refused");
+    LZ_CHECK(unpacked == strlen(text) && memcmp(output, text, unpacked) == 0, "known block decoded wrong");
+
+    for (i = 0; i < 32; i++) source[i] = (uint8_t) ((i & 1) ? 'b' : 'a');
+    length = salt_lz_compress(&lz, source, 32, packed, sizeof(packed));
+    LZ_CHECK(length == sizeof(runs) && memcmp(packed, runs, sizeof(runs)) == 0,
+             "known runs compressed into %u other bytes", length);
+
+    /* An empty block is one token */
+    length = salt_lz_compress(&lz, source, 0, packed, sizeof(packed));
+    LZ_CHECK(length == 1 && packed[0] == 0x00, "empty block compressed into %u bytes", length);
+    LZ_CHECK(lz_test_decompress(packed, 1, 0, &unpacked) == 0 && unpacked == 0, "empty block refused");
+}
+
+static void lz_test_round_trips(void)
+{
+    static const char words[] = "Salt channel over RS-232, the blocks of the file are compressed. ";
+    uint32_t i, size;
+
+    for (i = 0; i < LZ_TEST_SIZE; i++) source[i] = (uint8_t) words[i % (sizeof(words) - 1)];
+    lz_test_round_trip("text", LZ_TEST_SIZE);
+
+    memset(source, 0, LZ_TEST_SIZE);
+    lz_test_round_trip("zeros", LZ_TEST_SIZE);
+
+    for (i = 0; i < LZ_TEST_SIZE; i++) source[i] = (uint8_t) lz_test_random();
+    lz_test_round_trip("noise", LZ_TEST_SIZE);
+
+    /* Matches at the largest offset */
+    for (i = 0; i < 70000; i++) source[i] = (uint8_t) lz_test_random();
+    memcpy(&source[SALT_LZ_MAX_OFFSET + 100], &source[100], 4000);
+    lz_test_round_trip("far match", 70000);
+
+    /* Every small size, around the limits of the last literals and of the match */
+    for (size = 0; size <= 300; size++)
+    {
+        for (i = 0; i < size; i++) source[i] = (uint8_t) ("aab"[lz_test_random() % 3]);
+        lz_test_round_trip("small", size);
+    }
+}
+
+static void lz_test_truncated(void)
+{
+    static const char words[] = "the truncated block must not decode out of its buffer ";
+    uint32_t length, cut, unpacked, i;
+
+    for (i = 0; i < 4096; i++) source[i] = (uint8_t) words[i % (sizeof(words) - 1)];
+    for (i = 0; i < 4096; i += 97) source[i] = (uint8_t) lz_test_random();
+    length = salt_lz_compress(&lz, source, 4096, packed, sizeof(packed));
+    LZ_CHECK(length > 0, "truncated: the block does not compress");
+
+    /* A cut between two sequences decodes a shorter prefix, any other cut is refused */
+    for (cut = 0; cut < length; cut++)
+    {
+        unpacked = 0;
+        if (lz_test_decompress(packed, cut, 4096, &unpacked) == 0)
+        {
+            LZ_CHECK(unpacked < 4096 && memcmp(output, source, unpacked) == 0,
+                     "truncated to %u bytes decoded %u bytes", cut, unpacked);
+        }
+    }
+}
+
+static void lz_test_damaged(void)
+{
+    /* A match 0 back, a match before the start, a match without its offset */
+    static const uint8_t offset_zero[] = { 0x10, 'a', 0x00, 0x00, 0x00 };
+    static const uint8_t offset_far[] = { 0x10, 'a', 0x02, 0x00, 0x00 };
+    static const uint8_t offset_cut[] = { 0x10, 'a', 0x01 };
+
+    /* Lengths over the input: literals, their continuation and the match */
+    static const uint8_t literals_long[] = { 0x50, 'a', 'b' };
+    static const uint8_t literals_cut[] = { 0xF0, 0xFF };
+    static const uint8_t match_cut[] = { 0x1F, 'a', 0x01, 0x00 };
+    static const uint8_t match_huge[] = { 0x1F, 'a', 0x01, 0x00, 0xFF, 0xFF, 0xFF, 0x10, 0x00 };
+    uint8_t random_block[256];
+    uint32_t unpacked, length, i, j;
+
+    LZ_CHECK(lz_test_decompress(offset_zero, sizeof(offset_zero), 64, &unpacked) != 0, "offset 0 accepted");
+    LZ_CHECK(lz_test_decompress(offset_far, sizeof(offset_far), 64, &unpacked) != 0, "offset before the start accepted");
+    LZ_CHECK(lz_test_decompress(offset_cut, sizeof(offset_cut), 64, &unpacked) != 0, "cut offset accepted");
+    LZ_CHECK(lz_test_decompress(literals_long, sizeof(literals_long), 64, &unpacked) != 0, "literals over the input accepted");
+    LZ_CHECK(lz_test_decompress(literals_cut, sizeof(literals_cut), 64, &unpacked) != 0, "cut literal length accepted");
+    LZ_CHECK(lz_test_decompress(match_cut, sizeof(match_cut), 64, &unpacked) != 0, "cut match length accepted");
+    LZ_CHECK(lz_test_decompress(match_huge, sizeof(match_huge), 256, &unpacked) != 0, "match over the output accepted");
+
+    /* Random blocks, nothing may be written behind the output */
+    for (i = 0; i < 100000; i++)
+    {
+        length = 1 + lz_test_random() % sizeof(random_block);
+        for (j = 0; j < length; j++) random_block[j] = (uint8_t) lz_test_random();
+        lz_test_decompress(random_block, length, 1 + lz_test_random() % 1024, &unpacked);
+    }
+}
+
+int main(void)
+{
+    lz_test_known_answers();
+    lz_test_round_trips();
+    lz_test_truncated();
+    lz_test_damaged();
+
+    if (failures > 0)
+    {
+        printf("LZ check: %d failures\n", failures);
+        return 1;
+    }
+    printf("LZ check: passed\n");
+
+    return 0;
+}
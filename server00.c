@@ -41,7 +41,6 @@
 * Macro allows diagnostic information to be written 
 * to the standard error file.
 */
-#include <assert.h>
 
 /* ===== RS-232 local macro definition & libraries ===== */
 /* RS232 library */
@@ -60,7 +59,25 @@
 /* Ready server_sk_key */
 #include "server_sk_key.h"
 
-int main(void) 
+/**
+ * Usage:   server              the port CPORT_NR
+ *          server pty          a pseudo terminal (Linux), the client 
+ *                              is started with the printed name of its port
+ *          server unix <path>  AF_UNIX socket (Linux), client unix <path>
+ *          server tcp <port>   TCP on 127.0.0.1 (Linux), client tcp <port>
+ *          server -c / -a / -f ... COBS framing, ARQ, Reed-Solomon FEC, the client
+ *                              needs the same options
+ *          server -e <ber> ... emulated bit errors of the sent bytes
+ *          server -u ...       the link and the received file go through 
+ *                              one io_uring (Linux), see salt_io_start_uring()
+ *          server -s <bytes> <ms> ... fdatasync() of the received file after 
+ *                              so many bytes or milliseconds, see 
+ *                              salt_journal_set_budget()
+ *          server bond <device | pty> <device | pty> ...
+ *                              ports bonded into one link, "pty" creates
+ *                              a pseudo terminal, client bond <ports>
+ */
+int main(int argc, char *argv[]) 
 { 
 /* ========  Variables & arrays ======== */
     int cport_nr = CPORT_NR,        
@@ -84,11 +101,13 @@ int main(void)
      * decrypt_size:    number of decrypted data
      * check_read:      return check value
      */
-    uint32_t expected_size = 0, block_size = 0,
-        decrypt_size = 0, check_read;
+    uint64_t expected_size = 0, block_size = 0,
+        decrypt_size = 0;
+    uint32_t check_read;
 
     /* Time measurement variables */
     clock_t start_t, end_t;
+    double wall_start, wall_end;
 
 /* ======= Variables for working with salt-channel protocol =========== */
 
@@ -96,6 +115,21 @@ int main(void)
     salt_protocols_t protocols;
     salt_msg_t msg_in;
     salt_ret_t ret_msg, ret_hndshk;
+    salt_io_ctx_t io_ctx;   /**< Context of the port for my_write() / my_read(). */
+    char pty_name[RS232_NAME_SIZE]; /**< Port of the client if a pseudo terminal is used. */
+    int use_cobs = 0;               /**< COBS framing with the option -c, the client needs it too. */
+    salt_io_arq_t io_arq;           /**< ARQ of the link with the option -a, the client needs it too. */
+    int use_arq = 0;
+    salt_io_fec_t io_fec;           /**< FEC of the link with the option -f, the client needs it too. */
+    int use_fec = 0;
+    salt_io_uring_t io_uring;       /**< io_uring of the link and the file with the option -u (Linux). */
+    int use_uring = 0;
+    double error_rate = 0;          /**< Emulated bit errors of the sent bytes with the option -e <ber>. */
+    uint64_t sync_bytes = SALT_SYNC_BYTES; /**< Budget of fdatasync() with the option -s <bytes> <ms>. */
+    uint32_t sync_ms = SALT_SYNC_MS;
+    salt_io_ctx_t bond_ports[SALT_IO_BOND_MAX]; /**< Ports of the bond. */
+    salt_io_bond_t io_bond;
+    int i;
 
 /* ======== Program information ======== */
     printf("\nA simple application that demonstrates the implementation of the Salt channel protocol\n");
@@ -103,20 +137,124 @@ int main(void)
 
 /* ========  Open port (COM number) on RS2_32  ======== */
 
-    if(RS232_OpenComport(cport_nr, bdrate, mode, 0))
+    while (argc > 1 && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "-a") == 0 || 
+                        strcmp(argv[1], "-f") == 0 || strcmp(argv[1], "-u") == 0 ||
+                        (strcmp(argv[1], "-e") == 0 && argc > 2) ||
+                        (strcmp(argv[1], "-s") == 0 && argc > 3)))
+    {
+        if (argv[1][1] == 'c') use_cobs = 1;
+        else if (argv[1][1] == 'f') use_fec = 1;
+        else if (argv[1][1] == 'u') use_uring = 1;
+        else if (argv[1][1] == 'e')
+        {
+            error_rate = atof(argv[2]);
+            argc--;
+            argv++;
+        }
+        else if (argv[1][1] == 's')
+        {
+            sync_bytes = strtoull(argv[2], NULL, 10);
+            sync_ms = (uint32_t) strtoul(argv[3], NULL, 10);
+            argc -= 2;
+            argv += 2;
+        }
+        else use_arq = 1;
+        argc--;
+        argv++;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "bond") == 0)
+    {
+        printf("\nPorts of the bond, start the client: ./client bond");
+        for (i = 0; i < argc - 2 && i < SALT_IO_BOND_MAX; i++)
+        {
+            if ((strcmp(argv[i + 2], "pty") == 0) ? 
+                salt_io_open_pty(&bond_ports[i], bdrate, mode, pty_name, sizeof(pty_name)) :
+                salt_io_open_device(&bond_ports[i], argv[i + 2], bdrate, mode, 0))
+            {
+                printf("\nCan not open port %s\n", argv[i + 2]);
+                return 0;
+            }
+            if (error_rate > 0) salt_io_set_error_rate(&bond_ports[i], error_rate);
+
+            printf(" %s", (strcmp(argv[i + 2], "pty") == 0) ? pty_name : argv[i + 2]);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        /* A slower port gets less stripes */
+        if (salt_io_open_bond(&io_ctx, &io_bond, bond_ports, i, SALT_IO_BOND_QUEUE_DEPTH))
+        {
+            printf("Can not bond the ports\n");
+            return 0;
+        }
+    }
+    else if (argc > 1 && strcmp(argv[1], "pty") == 0)
+    {
+        if(salt_io_open_pty(&io_ctx, bdrate, mode, pty_name, sizeof(pty_name)))
+        {
+            printf("Can not create pseudo terminal\n");
+
+            return 0;
+        }
+        printf("\nPseudo terminal is ready, start the client: ./client %s\n", pty_name);
+        fflush(stdout);
+    } 
+    else if (argc > 2 && (strcmp(argv[1], "unix") == 0 || strcmp(argv[1], "tcp") == 0))
+    {
+        printf("\nWaiting for the client on %s %s\n", argv[1], argv[2]);
+        fflush(stdout);
+
+        if ((argv[1][0] == 'u') ? salt_io_open_unix(&io_ctx, argv[2], 1) : 
+                                  salt_io_open_tcp(&io_ctx, (uint16_t) atoi(argv[2]), 1))
+        {
+            printf("Can not open socket\n");
+
+            return 0;
+        }
+    }
+    else if(salt_io_open_port(&io_ctx, cport_nr, bdrate, mode, 0))
     {
         printf("Can not open comport\n");
 
         return 0;
     }
 
+    /* Noise of the line for the tests of the FEC and the ARQ */
+    if (error_rate > 0) salt_io_set_error_rate(&io_ctx, error_rate);
+
+    /* A damaged frame is dropped instead of desynchronizing the stream */
+    if (use_cobs) salt_io_set_framing(&io_ctx, SALT_IO_FRAMING_COBS);
+
+    /* The link and the writes of the received file are served by one ring */
+    if (use_uring && (salt_io_uring_init(&io_uring) || salt_io_start_uring(&io_ctx, &io_uring)))
+    {
+        printf("Can not start io_uring on the link\n");
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
+    /* The damaged bytes are corrected by the receiver */
+    if (use_fec && salt_io_start_fec(&io_ctx, &io_fec, SALT_IO_FEC_PARITY))
+    {
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
+    /* Damaged chunks are sent again instead of closing the session */
+    if (use_arq && salt_io_start_arq(&io_ctx, &io_arq))
+    {
+        salt_io_close(&io_ctx);
+        return 0;
+    }
+
 /* ========  Salt-channel version 2 implementation and Salt handshake ======== */
     printf("\n");
     ret_hndshk = salt_impl_and_hndshk_server(&pc_b_channel,
                                              &protocols,
                                              my_write,
                                              my_read,
-                                             &cport_nr,
+                                             &io_ctx,
                                              &my_time,
                                              host_sk_sec,
                                              TRESHOLD);
@@ -124,9 +262,13 @@ int main(void)
     else 
     {
         printf("Salt Handshake failed\n");
+        salt_io_close(&io_ctx);
         return -1;
     }
 
+    /* The client offers higher baudrates (only on a serial link) */
+    bdrate = salt_baudrate_upshift_server(&pc_b_channel, &io_ctx, bdrate, mode);
+
 /* ======== Receiving data and sending confirmation message ======== */
     while (verify)
     {   
@@ -144,12 +286,12 @@ int main(void)
         if (check_size_value == 1)
         {
             printf("\nThe expected size of the transferred data has been received\n\n");
-            assert(check_size_value == 1);
         }
         else
         {
             printf("\nThe expected file size could not be accepted\n");
-            assert(check_size_value == 1);
+            salt_io_close(&io_ctx);
+            return -1;
         } 
 
         check_size_value = 0;
@@ -162,101 +304,160 @@ int main(void)
         if (check_size_value == 1)
         {
             printf("\nThe expected size of the block data has been received\n\n");
-            assert(check_size_value == 1);
         }
         else
         {
             printf("\nThe expected block size could not be accepted\n");
-            assert(check_size_value == 1);
+            salt_io_close(&io_ctx);
+            return -1;
         } 
 
+        /* A block is one message of the salt channel */
+        if (block_size == 0 || block_size > 0xFFFFFFFF - SALT_READ_OVRHD_SIZE - SALT_BLOCK_HEADER_SIZE)
+        {
+            printf("\nInvalid block size %llu\n", (unsigned long long) block_size);
+            exit(1);
+        }
+
         /* Opens the file received_data.txt */
-        FILE *fp;
-        fp = fopen("received_data.txt", "wb");
+        int fd_out = salt_open_output("received_data.txt");
 
-        if(fp == NULL)
+        if(fd_out < 0)
         {
             printf("Error opening file\n");
             exit(1);
         }
 
+        /* The journal of the file tells which blocks the client still sends */
+        salt_journal_t journal;
+        uint64_t ranges[2 * SALT_RESUME_RANGES];
+        int range_count, range, compression;
+
+        range_count = salt_resume_server(&pc_b_channel, &journal, "received_data.txt", fd_out,
+                                         expected_size, (uint32_t) block_size, ranges, SALT_RESUME_RANGES,
+                                         &compression);
+        if (range_count < 0)
+        {
+            printf("Can not resume the transfer\n");
+            exit(1);
+        }
+        salt_journal_set_budget(&journal, sync_bytes, sync_ms);
+
+        /* The whole file is allocated before the first block, a full disk fails now */
+        if (salt_preallocate_output(fd_out, expected_size) != 0)
+        {
+            printf("Not enough space for the file\n");
+            exit(1);
+        }
+
 /* =========== Reads encrypted data in blocks ================ */
-        uint8_t rx_buffer[block_size + SALT_READ_OVRHD_SIZE],
-                copy_buffer[block_size];
+        /* The blocks are decrypted in page aligned buffers of the pool (and decompressed) */
+        salt_buffer_pool_t rx_pool;
+
+        if (compression) printf("\nThe blocks are compressed\n");
+        if (salt_buffer_pool_init(&rx_pool, (uint32_t) block_size + SALT_READ_OVRHD_SIZE + 
+                                  (compression ? SALT_BLOCK_HEADER_SIZE : 0), SALT_RX_POOL_COUNT))
+        {
+            printf("Can not allocate the receive buffers\n");
+            exit(1);
+        }
         
-        decrypt_size = 0;
+        /* The blocks are written by the writer, the reception does not wait for the disk */
+        salt_writer_t writer;
+
+        if (salt_writer_start(&writer, fd_out, &rx_pool, &journal, use_uring ? &io_uring : NULL))
+        {
+            printf("Can not start the writer\n");
+            exit(1);
+        }
+
+        /* The blocks are confirmed by the window, not one by one */
+        salt_window_t rx_window;
+
+        salt_window_init(&rx_window);
         /* Start of transmission measurement */
         start_t = clock();
-        do
-        { 
-            check_read = salt_read_and_decrypt_server(&pc_b_channel,
-                                                      rx_buffer,
-                                                      block_size + SALT_READ_OVRHD_SIZE,
-                                                      &msg_in,
-                                                      copy_buffer,
-                                                      &decrypt_size,
-                                                      fp);
-            if (check_read == 1) ret_msg = SALT_SUCCESS;
-            else printf("Failed to process received data\n");
-            
-        } while(decrypt_size < expected_size);
+        wall_start = wall_time_seconds();
+        ret_msg = SALT_SUCCESS;
+        for (range = 0; range < range_count && ret_msg == SALT_SUCCESS; range++)
+        {
+            /* decrypt_size is the offset of the next block of the range */
+            decrypt_size = ranges[2 * range];
+            while (decrypt_size < ranges[2 * range + 1])
+            { 
+                check_read = salt_read_and_decrypt_server(&pc_b_channel,
+                                                          &writer,
+                                                          &msg_in,
+                                                          &decrypt_size,
+                                                          ranges[2 * range_count - 1],
+                                                          &rx_window,
+                                                          compression);
+                if (check_read != 1) 
+                {
+                    printf("Failed to process received data\n");
+                    ret_msg = SALT_ERROR;
+                    break;
+                }
+            }
+        }
         /* End of data transmission measurement */ 
         end_t = clock();
+        wall_end = wall_time_seconds();
+
+        /* The queued blocks are written and synced, the journal of the complete file is removed */
+        if (salt_writer_finish(&writer) != 0)
+        {
+            printf("Failed to write the received data\n");
+            ret_msg = SALT_ERROR;
+        }
+        salt_journal_close(&journal, ret_msg == SALT_SUCCESS);
 
         /* Closed file */
-        fclose(fp);
+        salt_buffer_pool_free(&rx_pool);
+        salt_close_output(fd_out);
 
-        /* Sending message about the proccess -> SUCCESS or FAIL */
+        /* The journal keeps the written blocks, the next run of the client sends only the rest */
+        if (ret_msg != SALT_SUCCESS)
+        {
+            printf("\nThe file is not complete, run the client again to send the rest\n");
+            salt_io_close(&io_ctx);
+            return -1;
+        }
+
+        /* Sending message about the proccess -> SUCCESS, a failure ended the session above */
         uint8_t check_data[STATIC_ARRAY];
         uint32_t check_return_confirm, length_check;
         printf("\n\nConclusion:");
 
-        /* If the data has been successfully received and decrypted */      
-        if (ret_msg == SALT_SUCCESS)
-        {
-            strcpy((char *)check_data, "Sending of data was successful :)\n");
-            printf("\n%s\n", check_data);
-            length_check = strlen((const char*)check_data);
-
-            check_return_confirm = salt_write_small_messages(&pc_b_channel,
-                                                            check_data,
-                                                            length_check,
-                                                            STATIC_ARRAY);
-            if (check_return_confirm != 1)
-            {   
-                printf("Failed to send confirmation message\n");
-                assert(check_return_confirm == 1);
-            } 
-            /* We can end the process of receiving data */
-            break;
-        } else 
-        /* If the data has been unsuccessfully received and decrypted */
-        {
-            strcpy((char *)check_data, "Sending of data was not successful :)\n");
-            printf("\n%sYou must send it again :/\n", check_data);
-            length_check = strlen((const char *)check_data);
-
-            check_return_confirm = salt_write_small_messages(&pc_b_channel,
-                                                            check_data,
-                                                            length_check,
-                                                            STATIC_ARRAY);
-            if (check_return_confirm != 1)
-            {   
-                printf("Failed to send confirmation message\n");
-                assert(check_return_confirm == 1);
-            } 
-            /* We can not end the process of receiving data and WE must send it again */
-        }
+        strcpy((char *)check_data, "Sending of data was successful :)\n");
+        printf("\n%s\n", check_data);
+        length_check = strlen((const char*)check_data);
+
+        check_return_confirm = salt_write_small_messages(&pc_b_channel,
+                                                        check_data,
+                                                        length_check,
+                                                        STATIC_ARRAY);
+        if (check_return_confirm != 1)
+        {   
+            /* The file is complete, only the client does not know it */
+            printf("Failed to send confirmation message\n");
+            salt_io_close(&io_ctx);
+            return -1;
+        } 
+        /* We can end the process of receiving data */
+        break;
     } /* End of receiving data and sending confirmation message */
 
 /* ======================  End of application  ===================== */
 
-    double elapsed = (double)(end_t - start_t)  / CLOCKS_PER_SEC;
-    printf("\n****************** Summary *********************\n");
-    printf("File transfer about size: %u time took seconds: %0.f\n\n", expected_size, elapsed);
+    salt_print_transfer_summary(expected_size, start_t, end_t, wall_end - wall_start);
+    salt_print_line_stats(&pc_b_channel);
+
+    /* The last staged frames must leave the port before it is closed */
+    salt_io_drain(&io_ctx);
 
     printf("\nClosing RS-232...\n");
-    RS232_CloseComport(cport_nr);
+    salt_io_close(&io_ctx);
     printf("Finished.\n");
 
     return 0;